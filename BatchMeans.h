@@ -0,0 +1,204 @@
+//
+// Batch-means estimator for the steady-state mean of an autocorrelated
+// output sequence (e.g. consecutive waiting times of one run)
+//
+// Observations are summed into batches of equal size. Memory is fixed: once
+// 2 * maxBatches batches are complete, adjacent pairs are merged and the
+// batch size doubles. For the estimate the batch size is chosen
+// automatically: batches keep being merged pairwise while the lag-1
+// autocorrelation of the batch means is significant, as long as at least
+// minBatches batches remain. The half-width uses Student's t with
+// (batches - 1) degrees of freedom.
+//
+
+#ifndef __SUPERMARKET_BATCHMEANS_H
+#define __SUPERMARKET_BATCHMEANS_H
+
+#include <vector>
+#include <cmath>
+#include <limits>
+
+class BatchMeans
+{
+  public:
+    struct Estimate {
+        double mean;
+        double halfWidth;    // NaN if fewer than 2 batches
+        int batches;
+        long batchSize;
+        double lag1;         // lag-1 autocorrelation of the batch means used
+        bool independent;    // lag-1 test passed at the chosen batch size
+    };
+
+  private:
+    int maxBatches;
+    long batchSize;
+    std::vector<double> batchSums;
+    double currentSum;
+    long currentCount;
+    double totalSum;
+    long totalCount;
+
+  public:
+    explicit BatchMeans(int maxBatches = 32);
+
+    void record(double value);
+    long getCount() const { return totalCount; }
+    double getMean() const { return totalCount > 0 ? totalSum / totalCount : 0; }
+    Estimate estimate(double confidence = 0.95, int minBatches = 10) const;
+
+    static double lag1Autocorrelation(const std::vector<double>& values);
+    static double normalQuantile(double p);
+    static double studentTQuantile(double p, int degreesOfFreedom);
+    static double confidenceHalfWidth(const std::vector<double>& values, double confidence);
+};
+
+inline BatchMeans::BatchMeans(int maxBatches)
+    : maxBatches(maxBatches < 2 ? 2 : maxBatches), batchSize(1), currentSum(0), currentCount(0),
+      totalSum(0), totalCount(0)
+{
+    batchSums.reserve(2 * this->maxBatches);
+}
+
+inline void BatchMeans::record(double value)
+{
+    totalSum += value;
+    totalCount++;
+    currentSum += value;
+    if (++currentCount < batchSize)
+        return;
+
+    batchSums.push_back(currentSum);
+    currentSum = 0;
+    currentCount = 0;
+
+    // Keep memory fixed: merge adjacent batches, double the batch size
+    if ((int)batchSums.size() >= 2 * maxBatches) {
+        for (int i = 0; i < maxBatches; i++)
+            batchSums[i] = batchSums[2 * i] + batchSums[2 * i + 1];
+        batchSums.resize(maxBatches);
+        batchSize *= 2;
+    }
+}
+
+inline BatchMeans::Estimate BatchMeans::estimate(double confidence, int minBatches) const
+{
+    Estimate result;
+    result.mean = getMean();
+    result.batchSize = batchSize;
+
+    std::vector<double> means;
+    for (double sum : batchSums)
+        means.push_back(sum / batchSize);
+
+    // Grow the batches until the batch means look uncorrelated
+    double threshold = normalQuantile(0.95);
+    while (true) {
+        result.lag1 = lag1Autocorrelation(means);
+        result.independent = result.lag1 <= threshold / std::sqrt((double)means.size());
+        if (result.independent || (int)means.size() / 2 < minBatches)
+            break;
+        for (size_t i = 0; i + 1 < means.size(); i += 2)
+            means[i / 2] = (means[i] + means[i + 1]) / 2;
+        means.resize(means.size() / 2);
+        result.batchSize *= 2;
+    }
+
+    result.batches = (int)means.size();
+    result.halfWidth = confidenceHalfWidth(means, confidence);
+    return result;
+}
+
+inline double BatchMeans::lag1Autocorrelation(const std::vector<double>& values)
+{
+    size_t n = values.size();
+    if (n < 3)
+        return 0;
+
+    double mean = 0;
+    for (double v : values)
+        mean += v;
+    mean /= n;
+
+    double numerator = 0, denominator = 0;
+    for (size_t i = 0; i < n; i++) {
+        denominator += (values[i] - mean) * (values[i] - mean);
+        if (i + 1 < n)
+            numerator += (values[i] - mean) * (values[i + 1] - mean);
+    }
+    return denominator > 0 ? numerator / denominator : 0;
+}
+
+inline double BatchMeans::confidenceHalfWidth(const std::vector<double>& values, double confidence)
+{
+    size_t n = values.size();
+    if (n < 2)
+        return std::numeric_limits<double>::quiet_NaN();
+
+    double mean = 0;
+    for (double v : values)
+        mean += v;
+    mean /= n;
+
+    double variance = 0;
+    for (double v : values)
+        variance += (v - mean) * (v - mean);
+    variance /= (n - 1);
+
+    return studentTQuantile(0.5 + confidence / 2, (int)n - 1) * std::sqrt(variance / n);
+}
+
+// Acklam's rational approximation (relative error below 1.2e-9)
+inline double BatchMeans::normalQuantile(double p)
+{
+    static const double a[] = {-3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+                               1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00};
+    static const double b[] = {-5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+                               6.680131188771972e+01, -1.328068155288572e+01};
+    static const double c[] = {-7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+                               -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00};
+    static const double d[] = {7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+                               3.754408661907416e+00};
+
+    if (p <= 0)
+        return -std::numeric_limits<double>::infinity();
+    if (p >= 1)
+        return std::numeric_limits<double>::infinity();
+
+    if (p < 0.02425) {
+        double q = std::sqrt(-2 * std::log(p));
+        return (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) /
+               ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1);
+    }
+    if (p > 1 - 0.02425)
+        return -normalQuantile(1 - p);
+
+    double q = p - 0.5;
+    double r = q * q;
+    return (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q /
+           (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1);
+}
+
+// Exact for 1 and 2 degrees of freedom, Cornish-Fisher expansion above
+inline double BatchMeans::studentTQuantile(double p, int degreesOfFreedom)
+{
+    const double pi = 3.14159265358979323846;
+    double n = degreesOfFreedom;
+    if (degreesOfFreedom <= 0)
+        return std::numeric_limits<double>::quiet_NaN();
+    if (degreesOfFreedom == 1)
+        return std::tan(pi * (p - 0.5));
+    if (degreesOfFreedom == 2) {
+        double alpha = 4 * p * (1 - p);
+        return 2 * (p - 0.5) * std::sqrt(2 / alpha);
+    }
+
+    double z = normalQuantile(p);
+    double z3 = z * z * z, z5 = z3 * z * z, z7 = z5 * z * z, z9 = z7 * z * z;
+    return z + (z3 + z) / (4 * n)
+             + (5 * z5 + 16 * z3 + 3 * z) / (96 * n * n)
+             + (3 * z7 + 19 * z5 + 17 * z3 - 15 * z) / (384 * n * n * n)
+             + (79 * z9 + 776 * z7 + 1482 * z5 - 1920 * z3 - 945 * z) / (92160 * n * n * n * n);
+}
+
+#endif
@@ -0,0 +1,235 @@
+//
+// Regression-adjusted control-variate estimator over batch means
+//
+// Each observation is a response y (e.g. a waiting time) together with q
+// control deviations c - mu, whose true mean is known to be zero (e.g. an
+// inter-arrival time minus the configured mean). Response and controls are
+// summed into batches like in BatchMeans (fixed memory, adjacent batches are
+// merged pairwise). At the end, batches are merged further while the lag-1
+// autocorrelation of the response batch means is significant (as long as
+// at least minBatches remain), then the batch means of y are regressed on
+// the batch means of the controls; the adjusted mean is
+//
+//     ybar - beta' * cbar
+//
+// and its half-width follows the classical multiple-control result
+// (Lavenberg and Welch) with Student's t on (batches - q - 1) degrees of
+// freedom. The plain batch-means estimate is returned alongside, so the
+// variance reduction can be reported.
+//
+
+#ifndef __SUPERMARKET_CONTROLVARIATES_H
+#define __SUPERMARKET_CONTROLVARIATES_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include "BatchMeans.h"
+
+class ControlVariates
+{
+  public:
+    struct Estimate {
+        double mean;            // control-variate adjusted mean
+        double halfWidth;       // NaN if too few batches or singular controls
+        double plainMean;       // unadjusted mean of all observations
+        double plainHalfWidth;  // batch-means half-width without controls
+        std::vector<double> coefficients;  // beta, one per control
+        int batches;
+        long batchSize;
+    };
+
+  private:
+    int numControls;
+    int maxBatches;
+    long batchSize;
+    std::vector<std::vector<double>> batchSums;  // [batch][0] = y, [batch][1 + j] = control j
+    std::vector<double> currentSums;
+    long currentCount;
+    double totalSum;
+    long totalCount;
+
+  public:
+    explicit ControlVariates(int numControls, int maxBatches = 32);
+
+    void record(double response, const std::vector<double>& controlDeviations);
+    long getCount() const { return totalCount; }
+    int getNumControls() const { return numControls; }
+    Estimate estimate(double confidence = 0.95, int minBatches = 10) const;
+
+  private:
+    static bool solve(std::vector<std::vector<double>> a, std::vector<double> b, std::vector<double>& x);
+};
+
+inline ControlVariates::ControlVariates(int numControls, int maxBatches)
+    : numControls(numControls), maxBatches(maxBatches < 2 ? 2 : maxBatches), batchSize(1),
+      currentSums(numControls + 1, 0.0), currentCount(0), totalSum(0), totalCount(0)
+{
+    if (numControls < 1)
+        throw std::invalid_argument("ControlVariates: need at least one control");
+    batchSums.reserve(2 * this->maxBatches);
+}
+
+inline void ControlVariates::record(double response, const std::vector<double>& controlDeviations)
+{
+    if ((int)controlDeviations.size() != numControls)
+        throw std::invalid_argument("ControlVariates: wrong number of controls");
+
+    totalSum += response;
+    totalCount++;
+    currentSums[0] += response;
+    for (int j = 0; j < numControls; j++)
+        currentSums[1 + j] += controlDeviations[j];
+    if (++currentCount < batchSize)
+        return;
+
+    batchSums.push_back(currentSums);
+    currentSums.assign(numControls + 1, 0.0);
+    currentCount = 0;
+
+    // Keep memory fixed: merge adjacent batches, double the batch size
+    if ((int)batchSums.size() >= 2 * maxBatches) {
+        for (int i = 0; i < maxBatches; i++)
+            for (int k = 0; k <= numControls; k++)
+                batchSums[i][k] = batchSums[2 * i][k] + batchSums[2 * i + 1][k];
+        batchSums.resize(maxBatches);
+        batchSize *= 2;
+    }
+}
+
+inline ControlVariates::Estimate ControlVariates::estimate(double confidence, int minBatches) const
+{
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    int q = numControls;
+
+    Estimate result;
+    result.plainMean = totalCount > 0 ? totalSum / totalCount : 0;
+    result.mean = result.plainMean;
+    result.halfWidth = nan;
+    result.coefficients.assign(q, 0.0);
+    result.batchSize = batchSize;
+
+    // Batch means of response and controls
+    std::vector<std::vector<double>> batchMeans;
+    for (const auto& sums : batchSums) {
+        std::vector<double> means(q + 1);
+        for (int k = 0; k <= q; k++)
+            means[k] = sums[k] / batchSize;
+        batchMeans.push_back(means);
+    }
+
+    // Grow the batches until the response batch means look uncorrelated
+    double threshold = BatchMeans::normalQuantile(0.95);
+    std::vector<double> responseMeans;
+    while (true) {
+        responseMeans.clear();
+        for (const auto& means : batchMeans)
+            responseMeans.push_back(means[0]);
+        double lag1 = BatchMeans::lag1Autocorrelation(responseMeans);
+        if (lag1 <= threshold / std::sqrt((double)batchMeans.size()) || (int)batchMeans.size() / 2 < std::max(minBatches, q + 3))
+            break;
+        for (size_t i = 0; i + 1 < batchMeans.size(); i += 2)
+            for (int k = 0; k <= q; k++)
+                batchMeans[i / 2][k] = (batchMeans[i][k] + batchMeans[i + 1][k]) / 2;
+        batchMeans.resize(batchMeans.size() / 2);
+        result.batchSize *= 2;
+    }
+
+    int n = (int)batchMeans.size();
+    result.batches = n;
+    result.plainHalfWidth = BatchMeans::confidenceHalfWidth(responseMeans, confidence);
+    if (n < q + 3)
+        return result;
+
+    // Grand means over the batches
+    std::vector<double> means(q + 1, 0.0);
+    for (const auto& batch : batchMeans)
+        for (int k = 0; k <= q; k++)
+            means[k] += batch[k];
+    for (int k = 0; k <= q; k++)
+        means[k] /= n;
+
+    // Centered cross products: Scc (controls) and Scy (controls x response)
+    std::vector<std::vector<double>> scc(q, std::vector<double>(q, 0.0));
+    std::vector<double> scy(q, 0.0);
+    for (const auto& batch : batchMeans) {
+        double dy = batch[0] - means[0];
+        for (int j = 0; j < q; j++) {
+            double dj = batch[1 + j] - means[1 + j];
+            scy[j] += dj * dy;
+            for (int k = 0; k < q; k++)
+                scc[j][k] += dj * (batch[1 + k] - means[1 + k]);
+        }
+    }
+
+    std::vector<double> beta;
+    if (!solve(scc, scy, beta))
+        return result;
+
+    double residualSquares = 0;
+    for (const auto& batch : batchMeans) {
+        double residual = batch[0] - means[0];
+        for (int j = 0; j < q; j++)
+            residual -= beta[j] * (batch[1 + j] - means[1 + j]);
+        residualSquares += residual * residual;
+    }
+    double residualVariance = residualSquares / (n - q - 1);
+
+    // Var = s^2 * (1/n + cbar' Scc^-1 cbar), controls have true mean zero
+    std::vector<double> controlMeans(means.begin() + 1, means.end());
+    std::vector<double> sccInvMean;
+    if (!solve(scc, controlMeans, sccInvMean))
+        return result;
+    double leverage = 1.0 / n;
+    for (int j = 0; j < q; j++)
+        leverage += controlMeans[j] * sccInvMean[j];
+
+    result.mean = means[0];
+    for (int j = 0; j < q; j++)
+        result.mean -= beta[j] * means[1 + j];
+    result.coefficients = beta;
+    result.halfWidth = BatchMeans::studentTQuantile(0.5 + confidence / 2, n - q - 1)
+                       * std::sqrt(residualVariance * leverage);
+    return result;
+}
+
+// Gaussian elimination with partial pivoting; false if (nearly) singular
+inline bool ControlVariates::solve(std::vector<std::vector<double>> a, std::vector<double> b, std::vector<double>& x)
+{
+    int n = (int)b.size();
+    double scale = 0;
+    for (int i = 0; i < n; i++)
+        scale = std::max(scale, std::fabs(a[i][i]));
+    if (scale == 0)
+        return false;
+
+    for (int col = 0; col < n; col++) {
+        int pivot = col;
+        for (int row = col + 1; row < n; row++)
+            if (std::fabs(a[row][col]) > std::fabs(a[pivot][col]))
+                pivot = row;
+        if (std::fabs(a[pivot][col]) < 1e-12 * scale)
+            return false;
+        std::swap(a[col], a[pivot]);
+        std::swap(b[col], b[pivot]);
+        for (int row = col + 1; row < n; row++) {
+            double factor = a[row][col] / a[col][col];
+            for (int k = col; k < n; k++)
+                a[row][k] -= factor * a[col][k];
+            b[row] -= factor * b[col];
+        }
+    }
+
+    x.assign(n, 0.0);
+    for (int row = n - 1; row >= 0; row--) {
+        double sum = b[row];
+        for (int k = row + 1; k < n; k++)
+            sum -= a[row][k] * x[k];
+        x[row] = sum / a[row][row];
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,315 @@
+//
+// Log-linear bucketed histogram with HDR histogram semantics
+//
+// Values are counted in units of lowestValue. Up to 2 * 10^significantDigits
+// units every unit has its own bucket; above that, each power of two range is
+// split into the same number of linear sub-buckets, so the relative error of
+// any quantile stays below 10^-significantDigits. Memory is fixed by the
+// configuration (the counts array only grows up to the index of the largest
+// value seen), histograms with the same configuration can be merged, and
+// they serialize to a compact run-length/varint encoded binary form.
+//
+
+#ifndef __SUPERMARKET_LOGHISTOGRAM_H
+#define __SUPERMARKET_LOGHISTOGRAM_H
+
+#include <vector>
+#include <string>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+class LogHistogram
+{
+  private:
+    double lowestValue;
+    double highestValue;
+    int significantDigits;
+    int subBucketHalfCountMagnitude;
+    int64_t subBucketHalfCount;
+    int64_t subBucketMask;
+    int64_t highestUnits;
+
+    std::vector<uint64_t> counts;
+    uint64_t totalCount;
+    uint64_t overflowCount;   // values above highestValue (counted at the top)
+    double minValue;
+    double maxValue;
+    double sum;
+
+  public:
+    LogHistogram(double lowestValue = 0.001, double highestValue = 86400, int significantDigits = 2);
+
+    void record(double value);
+    void merge(const LogHistogram& other);
+    bool isCompatible(const LogHistogram& other) const;
+
+    uint64_t getCount() const { return totalCount; }
+    uint64_t getOverflowCount() const { return overflowCount; }
+    double getMin() const { return totalCount > 0 ? minValue : 0; }
+    double getMax() const { return totalCount > 0 ? maxValue : 0; }
+    double getMean() const { return totalCount > 0 ? sum / totalCount : 0; }
+    double quantile(double q) const;
+    size_t getMemoryFootprint() const { return counts.capacity() * sizeof(uint64_t); }
+
+    void serialize(std::ostream& out) const;
+    static LogHistogram deserialize(std::istream& in);
+
+  private:
+    size_t countsIndex(int64_t units) const;
+    int64_t highestEquivalentUnits(size_t index) const;
+
+    static void writeVarint(std::ostream& out, uint64_t value);
+    static uint64_t readVarint(std::istream& in);
+    static void writeDouble(std::ostream& out, double value);
+    static double readDouble(std::istream& in);
+
+    friend void writeLogHistogramRecord(std::ostream&, const std::string&, const std::string&, const LogHistogram&);
+    friend bool readLogHistogramRecord(std::istream&, std::string&, std::string&, LogHistogram&);
+};
+
+inline LogHistogram::LogHistogram(double lowestValue, double highestValue, int significantDigits)
+    : lowestValue(lowestValue), highestValue(highestValue), significantDigits(significantDigits),
+      totalCount(0), overflowCount(0), minValue(0), maxValue(0), sum(0)
+{
+    if (lowestValue <= 0 || highestValue < 2 * lowestValue)
+        throw std::invalid_argument("LogHistogram: need 0 < lowestValue and highestValue >= 2 * lowestValue");
+    if (significantDigits < 1 || significantDigits > 5)
+        throw std::invalid_argument("LogHistogram: significantDigits must be between 1 and 5");
+
+    int64_t largestSingleUnitValue = 2 * (int64_t)std::pow(10, significantDigits);
+    int subBucketCountMagnitude = (int)std::ceil(std::log2((double)largestSingleUnitValue));
+    subBucketHalfCountMagnitude = std::max(subBucketCountMagnitude, 1) - 1;
+    subBucketHalfCount = (int64_t)1 << subBucketHalfCountMagnitude;
+    subBucketMask = ((int64_t)1 << (subBucketHalfCountMagnitude + 1)) - 1;
+    highestUnits = (int64_t)(highestValue / lowestValue);
+}
+
+inline size_t LogHistogram::countsIndex(int64_t units) const
+{
+    int pow2Ceiling = 64 - __builtin_clzll((uint64_t)(units | subBucketMask));
+    int bucketIndex = pow2Ceiling - (subBucketHalfCountMagnitude + 1);
+    int64_t subBucketIndex = units >> bucketIndex;
+    return ((size_t)(bucketIndex + 1) << subBucketHalfCountMagnitude) + (subBucketIndex - subBucketHalfCount);
+}
+
+inline int64_t LogHistogram::highestEquivalentUnits(size_t index) const
+{
+    int bucketIndex = (int)(index >> subBucketHalfCountMagnitude) - 1;
+    int64_t subBucketIndex = (int64_t)(index & (subBucketHalfCount - 1)) + subBucketHalfCount;
+    if (bucketIndex < 0) {
+        subBucketIndex -= subBucketHalfCount;
+        bucketIndex = 0;
+    }
+    return (subBucketIndex << bucketIndex) + ((int64_t)1 << bucketIndex) - 1;
+}
+
+inline void LogHistogram::record(double value)
+{
+    if (std::isnan(value))
+        return;
+
+    if (totalCount == 0 || value < minValue)
+        minValue = value;
+    if (totalCount == 0 || value > maxValue)
+        maxValue = value;
+    sum += value;
+    totalCount++;
+
+    int64_t units = value > 0 ? (int64_t)(value / lowestValue) : 0;
+    if (units > highestUnits) {
+        units = highestUnits;
+        overflowCount++;
+    }
+
+    size_t index = countsIndex(units);
+    if (index >= counts.size())
+        counts.resize(index + 1, 0);
+    counts[index]++;
+}
+
+inline bool LogHistogram::isCompatible(const LogHistogram& other) const
+{
+    return lowestValue == other.lowestValue && highestValue == other.highestValue
+            && significantDigits == other.significantDigits;
+}
+
+inline void LogHistogram::merge(const LogHistogram& other)
+{
+    if (!isCompatible(other))
+        throw std::invalid_argument("LogHistogram: cannot merge histograms with different configurations");
+    if (other.totalCount == 0)
+        return;
+
+    if (other.counts.size() > counts.size())
+        counts.resize(other.counts.size(), 0);
+    for (size_t i = 0; i < other.counts.size(); i++)
+        counts[i] += other.counts[i];
+
+    minValue = totalCount > 0 ? std::min(minValue, other.minValue) : other.minValue;
+    maxValue = totalCount > 0 ? std::max(maxValue, other.maxValue) : other.maxValue;
+    sum += other.sum;
+    totalCount += other.totalCount;
+    overflowCount += other.overflowCount;
+}
+
+inline double LogHistogram::quantile(double q) const
+{
+    if (totalCount == 0)
+        return 0;
+
+    q = std::min(std::max(q, 0.0), 1.0);
+    uint64_t rank = std::max<uint64_t>(1, (uint64_t)std::ceil(q * totalCount));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            double value = (highestEquivalentUnits(i) + 1) * lowestValue;
+            return std::min(std::max(value, minValue), maxValue);
+        }
+    }
+    return maxValue;
+}
+
+//
+// Binary form: "LHG1", the configuration, the exact summary values, then
+// the counts as zigzag varints where a negative number -n stands for a run
+// of n empty buckets.
+//
+inline void LogHistogram::writeVarint(std::ostream& out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out.put((char)((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.put((char)value);
+}
+
+inline uint64_t LogHistogram::readVarint(std::istream& in)
+{
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = in.get();
+        if (c == EOF)
+            throw std::runtime_error("LogHistogram: unexpected end of data");
+        value |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80))
+            return value;
+    }
+    throw std::runtime_error("LogHistogram: malformed varint");
+}
+
+inline void LogHistogram::writeDouble(std::ostream& out, double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < 8; i++)
+        out.put((char)((bits >> (8 * i)) & 0xff));
+}
+
+inline double LogHistogram::readDouble(std::istream& in)
+{
+    uint64_t bits = 0;
+    for (int i = 0; i < 8; i++) {
+        int c = in.get();
+        if (c == EOF)
+            throw std::runtime_error("LogHistogram: unexpected end of data");
+        bits |= (uint64_t)(c & 0xff) << (8 * i);
+    }
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline void LogHistogram::serialize(std::ostream& out) const
+{
+    out.write("LHG1", 4);
+    writeVarint(out, significantDigits);
+    writeDouble(out, lowestValue);
+    writeDouble(out, highestValue);
+    writeDouble(out, minValue);
+    writeDouble(out, maxValue);
+    writeDouble(out, sum);
+    writeVarint(out, totalCount);
+    writeVarint(out, overflowCount);
+    writeVarint(out, counts.size());
+
+    for (size_t i = 0; i < counts.size(); ) {
+        if (counts[i] == 0) {
+            uint64_t run = 0;
+            while (i < counts.size() && counts[i] == 0) {
+                run++;
+                i++;
+            }
+            writeVarint(out, (run << 1) - 1);  // zigzag of -run
+        } else {
+            writeVarint(out, counts[i] << 1);  // zigzag of a positive count
+            i++;
+        }
+    }
+}
+
+inline LogHistogram LogHistogram::deserialize(std::istream& in)
+{
+    char magic[4];
+    if (!in.read(magic, 4) || std::memcmp(magic, "LHG1", 4) != 0)
+        throw std::runtime_error("LogHistogram: bad magic");
+
+    int digits = (int)readVarint(in);
+    double lowest = readDouble(in);
+    double highest = readDouble(in);
+    LogHistogram histogram(lowest, highest, digits);
+    histogram.minValue = readDouble(in);
+    histogram.maxValue = readDouble(in);
+    histogram.sum = readDouble(in);
+    histogram.totalCount = readVarint(in);
+    histogram.overflowCount = readVarint(in);
+
+    uint64_t size = readVarint(in);
+    if (size > ((uint64_t)1 << 32))
+        throw std::runtime_error("LogHistogram: implausible size");
+    histogram.counts.assign(size, 0);
+    for (uint64_t i = 0; i < size; ) {
+        uint64_t zigzag = readVarint(in);
+        if (zigzag & 1) {
+            i += (zigzag + 1) >> 1;  // run of empty buckets
+        } else {
+            histogram.counts[i] = zigzag >> 1;
+            i++;
+        }
+    }
+    return histogram;
+}
+
+//
+// Histogram files hold a sequence of records: module path, statistic name
+// and the serialized histogram
+//
+inline void writeLogHistogramRecord(std::ostream& out, const std::string& module, const std::string& statistic, const LogHistogram& histogram)
+{
+    LogHistogram::writeVarint(out, module.size());
+    out.write(module.data(), module.size());
+    LogHistogram::writeVarint(out, statistic.size());
+    out.write(statistic.data(), statistic.size());
+    histogram.serialize(out);
+}
+
+inline bool readLogHistogramRecord(std::istream& in, std::string& module, std::string& statistic, LogHistogram& histogram)
+{
+    if (in.peek() == EOF)
+        return false;
+
+    module.resize(LogHistogram::readVarint(in));
+    in.read(&module[0], module.size());
+    statistic.resize(LogHistogram::readVarint(in));
+    in.read(&statistic[0], statistic.size());
+    histogram = LogHistogram::deserialize(in);
+    return true;
+}
+
+#endif
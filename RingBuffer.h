@@ -0,0 +1,65 @@
+//
+// FIFO queue of small records in one contiguous ring (power-of-two
+// capacity, doubled when full)
+//
+// Unlike std::queue (std::deque: blocks of 512 bytes plus a map) and
+// queues of pointers to heap objects, consecutive elements share cache
+// lines and a dequeue touches no memory other than the record itself.
+// Memory only grows, to the largest length seen.
+//
+
+#ifndef __SUPERMARKET_RINGBUFFER_H
+#define __SUPERMARKET_RINGBUFFER_H
+
+#include <cstddef>
+#include <vector>
+
+template <class T>
+class RingBuffer
+{
+  private:
+    std::vector<T> slots;  // size is zero or a power of two
+    size_t head = 0;       // index of the front element
+    size_t count = 0;
+
+  public:
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+    size_t capacity() const { return slots.size(); }
+    size_t memoryBytes() const { return slots.capacity() * sizeof(T); }
+
+    T& front() { return slots[head]; }
+    const T& front() const { return slots[head]; }
+
+    // i-th element from the front
+    T& operator[](size_t i) { return slots[(head + i) & (slots.size() - 1)]; }
+    const T& operator[](size_t i) const { return slots[(head + i) & (slots.size() - 1)]; }
+
+    void push(const T& value) {
+        if (count == slots.size())
+            grow();
+        slots[(head + count) & (slots.size() - 1)] = value;
+        count++;
+    }
+
+    void pop() {
+        head = (head + 1) & (slots.size() - 1);
+        count--;
+    }
+
+    void clear() {
+        head = 0;
+        count = 0;
+    }
+
+  private:
+    void grow() {
+        std::vector<T> larger(slots.empty() ? 16 : 2 * slots.size());
+        for (size_t i = 0; i < count; i++)
+            larger[i] = (*this)[i];
+        slots.swap(larger);
+        head = 0;
+    }
+};
+
+#endif
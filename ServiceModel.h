@@ -0,0 +1,19 @@
+//
+// Service model of the default store: baskets of MIN_ITEMS..MAX_ITEMS
+// items, each taking MIN_ITEM_TIME..MAX_ITEM_TIME seconds (both uniform)
+// before the cashier's speed factor. Used by the Shop and the Cashier and
+// by the approximations that have to match them (SteadyState.h).
+//
+
+#ifndef __SUPERMARKET_SERVICEMODEL_H
+#define __SUPERMARKET_SERVICEMODEL_H
+
+struct ServiceModel
+{
+    static constexpr int MIN_ITEMS = 1;
+    static constexpr int MAX_ITEMS = 25;
+    static constexpr double MIN_ITEM_TIME = 0.5;  // s
+    static constexpr double MAX_ITEM_TIME = 2.0;  // s
+};
+
+#endif
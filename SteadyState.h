@@ -0,0 +1,212 @@
+//
+// Approximate steady-state distribution of one store, for starting runs
+// near equilibrium instead of empty (no warm-up to discard)
+//
+// Per lane, the distribution of the customers at the lane (in service and
+// waiting). It is either analytic or learned by a pilot run, stored as
+//
+//     { "laneArrivalInterval": 20, "speedFactor": 1, "byRoundRobinOffset": false,
+//       "customers": [ [0.19, 0.15, ...], ... ] }   P(N=0), P(N=1), ... per lane
+//
+// Under round robin the lanes are not alike at a random instant: the lane
+// that receives the next arrival has drained longest since its last one,
+// the lane that just received one is the fullest. With byRoundRobinOffset,
+// customers[d] is the distribution of the lane that receives the d-th next
+// arrival (d = 0 next), not of lane d.
+//
+// Sampling turns it into a StoreSnapshot: the round robin position is
+// uniform and the lanes are otherwise independent, the customer in
+// service has an equilibrium (length-biased) service time with a uniform
+// share already elapsed, and the queued customers have waited exponential
+// gaps back from the youngest. The next arrival is drawn by the shop.
+//
+
+#ifndef __SUPERMARKET_STEADYSTATE_H
+#define __SUPERMARKET_STEADYSTATE_H
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "ServiceModel.h"
+#include "StoreSnapshot.h"
+
+struct SteadyState
+{
+    std::vector<std::vector<double>> customers;  // [lane][n] = P(N=n)
+    double laneArrivalInterval = 0;  // s, mean time between arrivals at one lane
+    double speedFactor = 1.0;
+    bool byRoundRobinOffset = false;  // customers[d] belongs to the lane d arrivals ahead
+
+    // Kingman (exact Pollaczek-Khinchine for Poisson arrivals) mean per
+    // lane, spread as a geometric tail over P(N>0) = rho. Round robin sees
+    // Erlang inter-arrival times at each lane (with the Kraemer/
+    // Langenbach-Belz correction), everything else is treated as Poisson
+    // (random routing; overestimates shortest queue). Under round robin a
+    // lane serves rho * a / S = 1/numCashiers customers per arrival
+    // interval a, so the mean drops by that much per position ahead.
+    static SteadyState analytic(int numCashiers, double arrivalInterval, int strategy, double speedFactor);
+
+    // Learned distribution, as written by tools/warmup
+    static SteadyState read(const std::string& fileName);
+    std::string toJson() const;
+
+    // uniform01() returns uniform draws from [0,1)
+    template <class Uniform01>
+    StoreSnapshot sample(Uniform01 uniform01) const;
+};
+
+inline SteadyState SteadyState::analytic(int numCashiers, double arrivalInterval, int strategy, double speedFactor)
+{
+    const int minItems = ServiceModel::MIN_ITEMS, maxItems = ServiceModel::MAX_ITEMS;
+    const double minItemTime = ServiceModel::MIN_ITEM_TIME, maxItemTime = ServiceModel::MAX_ITEM_TIME;
+    double meanItems = (minItems + maxItems) / 2.0;
+    double itemsVariance = ((maxItems - minItems + 1.0) * (maxItems - minItems + 1.0) - 1) / 12.0;
+    double meanItemTime = (minItemTime + maxItemTime) / 2.0;
+    double itemTimeVariance = (maxItemTime - minItemTime) * (maxItemTime - minItemTime) / 12.0;
+    double meanService = meanItems * meanItemTime * speedFactor;
+    double serviceVariance = (meanItems * itemTimeVariance + itemsVariance * meanItemTime * meanItemTime) * speedFactor * speedFactor;
+
+    SteadyState steadyState;
+    steadyState.laneArrivalInterval = arrivalInterval * numCashiers;
+    steadyState.speedFactor = speedFactor;
+    double rho = meanService / steadyState.laneArrivalInterval;
+    if (!(rho < 1))
+        throw std::runtime_error("no steady state: lane utilization " + std::to_string(rho) + " >= 1");
+
+    double arrivalCv2 = strategy == 0 ? 1.0 / numCashiers : 1.0;
+    double serviceCv2 = serviceVariance / (meanService * meanService);
+    double correction = std::exp(-2 * (1 - rho) * (1 - arrivalCv2) * (1 - arrivalCv2) / (3 * rho * (arrivalCv2 + serviceCv2)));
+    double meanCustomers = rho + correction * rho * rho / (1 - rho) * (arrivalCv2 + serviceCv2) / 2;
+    auto geometric = [rho](double mean) {
+        double q = mean > rho ? 1 - rho / mean : 0;  // geometric ratio of P(N=n), n >= 1
+        std::vector<double> distribution(1, 1 - rho);
+        double tail = rho;
+        for (double p = rho * (1 - q); tail > 1e-9 && p > 0; p *= q) {
+            distribution.push_back(p);
+            tail -= p;
+        }
+        return distribution;
+    };
+
+    if (strategy == 0) {
+        steadyState.byRoundRobinOffset = true;
+        for (int d = 0; d < numCashiers; d++)
+            steadyState.customers.push_back(geometric(meanCustomers + (d - (numCashiers - 1) / 2.0) / numCashiers));
+    } else {
+        steadyState.customers.assign(numCashiers, geometric(meanCustomers));
+    }
+    return steadyState;
+}
+
+inline SteadyState SteadyState::read(const std::string& fileName)
+{
+    std::ifstream in(fileName);
+    if (!in)
+        throw std::runtime_error("cannot open steady state " + fileName);
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    JsonValue root = JsonValue::parse(buffer.str());
+    if (root.type != JsonValue::OBJECT)
+        throw std::runtime_error("steady state: top level must be an object");
+
+    SteadyState steadyState;
+    steadyState.laneArrivalInterval = root.numberOr("laneArrivalInterval", 0);
+    steadyState.speedFactor = root.numberOr("speedFactor", 1.0);
+    if (steadyState.laneArrivalInterval <= 0)
+        throw std::runtime_error("steady state: 'laneArrivalInterval' must be positive");
+    if (const JsonValue *byOffset = root.find("byRoundRobinOffset")) {
+        if (byOffset->type != JsonValue::BOOLEAN)
+            throw std::runtime_error("steady state: 'byRoundRobinOffset' must be true or false");
+        steadyState.byRoundRobinOffset = byOffset->boolean;
+    }
+    const JsonValue *lanes = root.find("customers");
+    if (!lanes || lanes->type != JsonValue::ARRAY)
+        throw std::runtime_error("steady state: 'customers' must be an array");
+    for (const JsonValue& lane : lanes->elements) {
+        if (lane.type != JsonValue::ARRAY || lane.elements.empty())
+            throw std::runtime_error("steady state: each lane must be a non-empty array of probabilities");
+        std::vector<double> distribution;
+        for (const JsonValue& p : lane.elements) {
+            if (p.type != JsonValue::NUMBER || p.number < 0)
+                throw std::runtime_error("steady state: probabilities must be non-negative numbers");
+            distribution.push_back(p.number);
+        }
+        steadyState.customers.push_back(distribution);
+    }
+    return steadyState;
+}
+
+inline std::string SteadyState::toJson() const
+{
+    std::ostringstream out;
+    out.precision(6);
+    out << "{ \"laneArrivalInterval\": " << laneArrivalInterval << ", \"speedFactor\": " << speedFactor
+        << ", \"byRoundRobinOffset\": " << (byRoundRobinOffset ? "true" : "false") << ",\n  \"customers\": [";
+    for (size_t i = 0; i < customers.size(); i++) {
+        out << (i > 0 ? ",\n    [" : "\n    [");
+        for (size_t n = 0; n < customers[i].size(); n++)
+            out << (n > 0 ? ", " : "") << customers[i][n];
+        out << "]";
+    }
+    out << " ] }\n";
+    return out.str();
+}
+
+template <class Uniform01>
+StoreSnapshot SteadyState::sample(Uniform01 uniform01) const
+{
+    const int minItems = ServiceModel::MIN_ITEMS, maxItems = ServiceModel::MAX_ITEMS;
+    const double minItemTime = ServiceModel::MIN_ITEM_TIME, maxItemTime = ServiceModel::MAX_ITEM_TIME;
+    auto items = [&]() { return minItems + (int)(uniform01() * (maxItems - minItems + 1)); };
+    auto serviceTime = [&](int n) {
+        double s = 0;
+        for (int i = 0; i < n; i++)
+            s += minItemTime + (maxItemTime - minItemTime) * uniform01();
+        return s * speedFactor;
+    };
+    double longestService = maxItems * maxItemTime * speedFactor;
+
+    StoreSnapshot snapshot;
+    snapshot.roundRobinCounter = (long)(uniform01() * customers.size());
+    snapshot.lanes.resize(customers.size());
+    for (size_t d = 0; d < customers.size(); d++) {
+        const std::vector<double>& distribution = customers[d];
+        double total = 0;
+        for (double p : distribution)
+            total += p;
+        double u = uniform01() * total;
+        int n = 0;
+        while (n + 1 < (int)distribution.size() && u >= distribution[n]) {
+            u -= distribution[n];
+            n++;
+        }
+
+        StoreSnapshot::Lane lane;
+        if (n > 0) {
+            // Length-biased service time by rejection, then a uniform share of it elapsed
+            double service;
+            do {
+                lane.serviceItems = items();
+                service = serviceTime(lane.serviceItems);
+            } while (uniform01() * longestService > service);
+            lane.busy = true;
+            lane.elapsedService = uniform01() * service;
+            lane.remainingService = service - lane.elapsedService;
+        }
+        lane.queue.resize(n > 0 ? n - 1 : 0);
+        double waited = 0;
+        for (int k = (int)lane.queue.size() - 1; k >= 0; k--) {
+            waited += -laneArrivalInterval * std::log(1 - uniform01());
+            lane.queue[k].items = items();
+            lane.queue[k].waited = waited;
+        }
+        size_t cashier = byRoundRobinOffset ? (snapshot.roundRobinCounter + d) % customers.size() : d;
+        snapshot.lanes[cashier] = lane;
+    }
+    return snapshot;
+}
+
+#endif
@@ -0,0 +1,171 @@
+//
+// Time-stepped approximation of one store, for coarse planning studies
+// (SteppedStore module, tools/stepped)
+//
+// Instead of one event per arrival and per departure, the store advances
+// in steps of timeStep. Each step draws the number of arrivals from a
+// Poisson distribution, spreads them over the step as sorted uniform
+// offsets and routes the whole batch on the lane lengths of the step start
+// plus the batch's own assignments (departures within the step are not
+// seen). Per lane, a waiting time follows from when the lane's assigned
+// work runs out (Lindley recursion), and the end of a step drains all
+// lanes at once. Lane lengths are sampled at step ends.
+//
+// With round robin and random routing, the waiting times are exact in
+// distribution. Shortest queue routes on a view up to one step old, and
+// the time-averaged lane lengths are step-end samples, so both depend on
+// the step.
+//
+// Rng is any type with uniform01(), uniform draws from [0,1).
+//
+
+#ifndef __SUPERMARKET_STEPPEDENGINE_H
+#define __SUPERMARKET_STEPPEDENGINE_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "RingBuffer.h"
+
+struct SteppedConfig
+{
+    int numCashiers = 4;
+    double arrivalInterval = 5;  // s, mean of the exponential inter-arrival time
+    int strategy = 0;            // 0=Round Robin, 1=Shortest Queue, 2=Random
+    double speedFactor = 1.0;
+    double timeStep = 1;         // s
+    int minItems = 1;
+    int maxItems = 25;
+    double minItemTime = 0.5;    // s
+    double maxItemTime = 2.0;    // s
+};
+
+template <class Rng>
+class SteppedEngine
+{
+  public:
+    struct Statistics {
+        long arrivals = 0;
+        long served = 0;
+        double waitSum = 0;            // s
+        double serviceSum = 0;         // s, of all arrivals
+        double waitingCustomerTime = 0;  // sum over step ends of customers waiting (not in service) * timeStep
+        long steps = 0;
+    };
+
+  private:
+    SteppedConfig config;
+    Rng& rng;
+    double now = 0;
+    long roundRobinCounter = 0;
+    std::vector<double> freeAt;                  // per lane: when its assigned work runs out
+    std::vector<RingBuffer<double>> departures;  // per lane: departure times not drained yet
+    std::vector<double> offsets;
+    Statistics statistics;
+
+  public:
+    SteppedEngine(const SteppedConfig& config, Rng& rng)
+        : config(config), rng(rng), freeAt(config.numCashiers, 0.0), departures(config.numCashiers) {}
+
+    double getTime() const { return now; }
+    int getLaneLength(int lane) const { return (int)departures[lane].size(); }
+    const Statistics& getStatistics() const { return statistics; }
+
+    // Advances one step; onArrival(lane, waitingTime, serviceTime) is called
+    // for every arrival of the step, in arrival order
+    template <class OnArrival>
+    void step(OnArrival onArrival) {
+        double end = now + config.timeStep;
+
+        // Given their number, Poisson arrivals are sorted uniform offsets
+        long n = poisson(config.timeStep / config.arrivalInterval);
+        offsets.resize(n);
+        for (long j = 0; j < n; j++)
+            offsets[j] = rng.uniform01() * config.timeStep;
+        std::sort(offsets.begin(), offsets.end());
+
+        for (long j = 0; j < n; j++) {
+            double arrival = now + offsets[j];
+            int lane = selectLane();
+            int items = config.minItems + (int)(rng.uniform01() * (config.maxItems - config.minItems + 1));
+            double serviceTime = 0;
+            for (int i = 0; i < items; i++)
+                serviceTime += config.minItemTime + (config.maxItemTime - config.minItemTime) * rng.uniform01();
+            serviceTime *= config.speedFactor;
+
+            double start = std::max(freeAt[lane], arrival);
+            freeAt[lane] = start + serviceTime;
+            departures[lane].push(freeAt[lane]);
+            statistics.arrivals++;
+            statistics.waitSum += start - arrival;
+            statistics.serviceSum += serviceTime;
+            onArrival(lane, start - arrival, serviceTime);
+        }
+
+        // Drain all lanes to the end of the step
+        for (int lane = 0; lane < config.numCashiers; lane++) {
+            RingBuffer<double>& queue = departures[lane];
+            while (!queue.empty() && queue.front() <= end) {
+                queue.pop();
+                statistics.served++;
+            }
+            if (queue.size() > 1)
+                statistics.waitingCustomerTime += (queue.size() - 1) * config.timeStep;
+        }
+        now = end;
+        statistics.steps++;
+    }
+
+  private:
+    int selectLane() {
+        switch (config.strategy) {
+            case 1: {
+                int best = 0;
+                for (int i = 1; i < config.numCashiers; i++)
+                    if (departures[i].size() < departures[best].size())
+                        best = i;
+                return best;
+            }
+            case 2:
+                return std::min(config.numCashiers - 1, (int)(rng.uniform01() * config.numCashiers));
+            default:
+                return (int)(roundRobinCounter++ % config.numCashiers);
+        }
+    }
+
+    // Inversion for small means, PTRS transformed rejection (Hoermann) for large ones
+    long poisson(double mean) {
+        if (mean < 30) {
+            double p = std::exp(-mean);
+            double cumulative = p;
+            double u = rng.uniform01();
+            long k = 0;
+            while (u > cumulative && p > 0) {
+                k++;
+                p *= mean / k;
+                cumulative += p;
+            }
+            return k;
+        }
+        double root = std::sqrt(mean);
+        double logMean = std::log(mean);
+        double b = 0.931 + 2.53 * root;
+        double a = -0.059 + 0.02483 * b;
+        double inverseAlpha = 1.1239 + 1.1328 / (b - 3.4);
+        double vr = 0.9277 - 3.6224 / (b - 2);
+        while (true) {
+            double u = rng.uniform01() - 0.5;
+            double v = rng.uniform01();
+            double us = 0.5 - std::fabs(u);
+            long k = (long)std::floor((2 * a / us + b) * u + mean + 0.43);
+            if (us >= 0.07 && v <= vr)
+                return k;
+            if (k < 0 || (us < 0.013 && v > us))
+                continue;
+            if (std::log(v) + std::log(inverseAlpha) - std::log(a / (us * us) + b) <= -mean + k * logMean - std::lgamma(k + 1.0))
+                return k;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,279 @@
+//
+// Live state of one store, read from a JSON snapshot (digital-twin mode)
+//
+//     {
+//       "nextArrivalIn": 2.5,           optional: seconds until the next arrival
+//       "roundRobinCounter": 7,         optional: next round robin position
+//       "lanes": [                      one entry per cashier, in index order
+//         { "inService": { "items": 12, "elapsed": 6.0, "remaining": 8.5 },
+//           "queue": [ { "items": 7, "waited": 40.5 }, { "items": 20, "waited": 12 } ],
+//           "itemTimeEstimate": 1.3 },  optional: learning balancer's s/item
+//         { "queue": [] }
+//       ]
+//     }
+//
+// "waited" is how long a queued customer has been in line already, so its
+// waiting time counts from before the snapshot. Unknown keys are ignored.
+// Missing lanes are idle and empty.
+//
+
+#ifndef __SUPERMARKET_STORESNAPSHOT_H
+#define __SUPERMARKET_STORESNAPSHOT_H
+
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct StoreSnapshot
+{
+    struct Customer {
+        int items;
+        double waited;  // s in line before the snapshot
+    };
+
+    struct Lane {
+        bool busy = false;
+        int serviceItems = 0;
+        double elapsedService = 0;    // s
+        double remainingService = 0;  // s
+        std::vector<Customer> queue;
+        double itemTimeEstimate = -1;  // s per item, < 0 = not given
+
+        int customers() const { return (int)queue.size() + (busy ? 1 : 0); }
+    };
+
+    std::vector<Lane> lanes;
+    double nextArrivalIn = -1;  // s, < 0 = not given
+    long roundRobinCounter = 0;
+
+    static StoreSnapshot parse(const std::string& json);
+    static StoreSnapshot read(const std::string& fileName);
+};
+
+// Minimal JSON document model: enough for snapshots
+class JsonValue
+{
+  public:
+    enum Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+
+    Type type = NUL;
+    bool boolean = false;
+    double number = 0;
+    std::string string;
+    std::vector<JsonValue> elements;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    static JsonValue parse(const std::string& text);
+
+    const JsonValue *find(const std::string& key) const {
+        for (const auto& member : members)
+            if (member.first == key)
+                return &member.second;
+        return nullptr;
+    }
+
+    double numberOr(const std::string& key, double fallback) const {
+        const JsonValue *value = find(key);
+        if (!value)
+            return fallback;
+        if (value->type != NUMBER)
+            throw std::runtime_error("JSON: '" + key + "' must be a number");
+        return value->number;
+    }
+
+  private:
+    class Reader;
+};
+
+class JsonValue::Reader
+{
+  private:
+    const std::string& text;
+    size_t pos = 0;
+
+  public:
+    explicit Reader(const std::string& text) : text(text) {}
+
+    JsonValue document() {
+        JsonValue value = parseValue();
+        skipSpace();
+        if (pos != text.size())
+            fail("trailing characters");
+        return value;
+    }
+
+  private:
+    [[noreturn]] void fail(const std::string& what) const {
+        throw std::runtime_error("JSON: " + what + " at offset " + std::to_string(pos));
+    }
+
+    void skipSpace() {
+        while (pos < text.size() && std::isspace((unsigned char)text[pos]))
+            pos++;
+    }
+
+    bool consume(char c) {
+        skipSpace();
+        if (pos < text.size() && text[pos] == c) {
+            pos++;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c) {
+        if (!consume(c))
+            fail(std::string("expected '") + c + "'");
+    }
+
+    bool consumeWord(const char *word) {
+        size_t n = std::char_traits<char>::length(word);
+        if (text.compare(pos, n, word) != 0)
+            return false;
+        pos += n;
+        return true;
+    }
+
+    std::string parseString() {
+        expect('"');
+        std::string out;
+        while (pos < text.size() && text[pos] != '"') {
+            char c = text[pos++];
+            if (c == '\\' && pos < text.size()) {
+                char escaped = text[pos++];
+                switch (escaped) {
+                    case 'n': out += '\n'; break;
+                    case 't': out += '\t'; break;
+                    case 'r': out += '\r'; break;
+                    case 'b': out += '\b'; break;
+                    case 'f': out += '\f'; break;
+                    case 'u': pos += 4; out += '?'; break;  // no non-ASCII keys needed
+                    default: out += escaped;
+                }
+            } else
+                out += c;
+        }
+        if (pos >= text.size())
+            fail("unterminated string");
+        pos++;
+        return out;
+    }
+
+    JsonValue parseValue() {
+        skipSpace();
+        if (pos >= text.size())
+            fail("unexpected end");
+        JsonValue value;
+        char c = text[pos];
+        if (c == '{') {
+            value.type = OBJECT;
+            pos++;
+            if (!consume('}')) {
+                do {
+                    skipSpace();
+                    std::string key = parseString();
+                    expect(':');
+                    value.members.emplace_back(key, parseValue());
+                } while (consume(','));
+                expect('}');
+            }
+        } else if (c == '[') {
+            value.type = ARRAY;
+            pos++;
+            if (!consume(']')) {
+                do {
+                    value.elements.push_back(parseValue());
+                } while (consume(','));
+                expect(']');
+            }
+        } else if (c == '"') {
+            value.type = STRING;
+            value.string = parseString();
+        } else if (consumeWord("true")) {
+            value.type = BOOLEAN;
+            value.boolean = true;
+        } else if (consumeWord("false")) {
+            value.type = BOOLEAN;
+        } else if (consumeWord("null")) {
+            value.type = NUL;
+        } else {
+            const char *start = text.c_str() + pos;
+            char *end;
+            value.type = NUMBER;
+            value.number = strtod(start, &end);
+            if (end == start)
+                fail("unexpected character");
+            pos += end - start;
+        }
+        return value;
+    }
+};
+
+inline JsonValue JsonValue::parse(const std::string& text)
+{
+    return Reader(text).document();
+}
+
+inline StoreSnapshot StoreSnapshot::parse(const std::string& json)
+{
+    JsonValue root = JsonValue::parse(json);
+    if (root.type != JsonValue::OBJECT)
+        throw std::runtime_error("snapshot: top level must be an object");
+
+    StoreSnapshot snapshot;
+    snapshot.nextArrivalIn = root.numberOr("nextArrivalIn", -1);
+    snapshot.roundRobinCounter = (long)root.numberOr("roundRobinCounter", 0);
+
+    const JsonValue *lanes = root.find("lanes");
+    if (lanes && lanes->type != JsonValue::ARRAY)
+        throw std::runtime_error("snapshot: 'lanes' must be an array");
+    for (size_t i = 0; lanes && i < lanes->elements.size(); i++) {
+        const JsonValue& entry = lanes->elements[i];
+        if (entry.type != JsonValue::OBJECT)
+            throw std::runtime_error("snapshot: lane " + std::to_string(i) + " must be an object");
+        Lane lane;
+        if (const JsonValue *service = entry.find("inService")) {
+            if (service->type == JsonValue::OBJECT) {
+                lane.busy = true;
+                lane.serviceItems = (int)service->numberOr("items", 0);
+                lane.elapsedService = service->numberOr("elapsed", 0);
+                lane.remainingService = service->numberOr("remaining", 0);
+                if (lane.remainingService < 0 || lane.elapsedService < 0)
+                    throw std::runtime_error("snapshot: lane " + std::to_string(i) + ": negative service time");
+            } else if (service->type != JsonValue::NUL)
+                throw std::runtime_error("snapshot: lane " + std::to_string(i) + ": 'inService' must be an object or null");
+        }
+        if (const JsonValue *queue = entry.find("queue")) {
+            if (queue->type != JsonValue::ARRAY)
+                throw std::runtime_error("snapshot: lane " + std::to_string(i) + ": 'queue' must be an array");
+            for (const JsonValue& waiting : queue->elements) {
+                Customer customer;
+                customer.items = (int)waiting.numberOr("items", 0);
+                customer.waited = waiting.numberOr("waited", 0);
+                if (customer.items < 1)
+                    throw std::runtime_error("snapshot: lane " + std::to_string(i) + ": queued customer without items");
+                lane.queue.push_back(customer);
+            }
+        }
+        lane.itemTimeEstimate = entry.numberOr("itemTimeEstimate", -1);
+        snapshot.lanes.push_back(lane);
+    }
+    return snapshot;
+}
+
+inline StoreSnapshot StoreSnapshot::read(const std::string& fileName)
+{
+    std::ifstream in(fileName);
+    if (!in)
+        throw std::runtime_error("cannot open snapshot " + fileName);
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    return parse(buffer.str());
+}
+
+#endif
@@ -5,31 +5,122 @@
 
 #include <omnetpp.h>
 #include <queue>
+#include <deque>
 #include <vector>
 #include <algorithm>
+#include <functional>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <string>
+#include <cmath>
+#include <cstdlib>
+#include <chrono>
+#include <mutex>
 #include "supermarket_sim_m.h"
+#include "LogHistogram.h"
+#include "BatchMeans.h"
+#include "ControlVariates.h"
+#include "StoreSnapshot.h"
+#include "ServiceModel.h"
+#include "SteadyState.h"
+#include "RingBuffer.h"
+#include "SteppedEngine.h"
 
 using namespace omnetpp;
 
+//==============================================================================
+// STORE SNAPSHOT (digital-twin mode)
+//==============================================================================
+// Shop, Balancer and Cashiers start from the live state in the store's
+// snapshotFile. The file is read afresh by every run, so repeated runs in
+// one process pick up a snapshot that is rewritten in between.
+static bool readStoreSnapshot(cModule *store, StoreSnapshot& snapshot)
+{
+    std::string fileName = store->par("snapshotFile").stdstringValue();
+    if (fileName.empty())
+        return false;
+    try {
+        snapshot = StoreSnapshot::read(fileName);
+    }
+    catch (std::exception& e) {
+        throw cRuntimeError("Cannot use store snapshot '%s': %s", fileName.c_str(), e.what());
+    }
+    return true;
+}
+
 //==============================================================================
 // CASHIER CLASS
 //==============================================================================
+// A waiting customer as a compact record in the cashier's ring buffer.
+// CustomerMsg objects only travel between modules: an arriving message is
+// deleted after copying these fields out of it.
+struct QueuedCustomer
+{
+    simtime_t arrivalTime;
+    double interArrivalTime;       // for the arrival control variate
+    double arrivalTimeDerivative;  // for IPA
+    int customerId;
+    int numberOfItems;
+};
+static_assert(sizeof(QueuedCustomer) == 32, "two queued customers per cache line");
+
 class Cashier : public cSimpleModule
 {
   private:
-    std::queue<CustomerMsg*> customerQueue;
+    RingBuffer<QueuedCustomer> customerQueue;
     cMessage *processCustomerTimer;
     bool isBusy;
     int cashierIndex;
-    CustomerMsg *currentCustomer;  // Track current customer being served
+    CustomerMsg *currentCustomer;  // Track current customer being served (serviceMsg or nullptr)
+    CustomerMsg *serviceMsg;  // Reused for every service; the details of the departure signal
+    bool alignedServiceDraws;  // same number of draws for every service (antithetic runs)
     
     // Timing for idle time calculation
     simtime_t lastServiceEndTime;
     simtime_t totalIdleTime;
     
+    // Vacations (breaks and till failures), driven by the VacationScheduler.
+    // Breaks and failures may overlap, hence a nesting depth.
+    int vacationDepth;
+    simtime_t vacationStartTime;  // may lie ahead: the clock starts once the current service ends
+    simtime_t totalVacationTime;
+    int vacationsTaken;
+    
+    // Time-weighted queue length distribution: queueLengthTime[k] is the
+    // total time the queue held exactly k customers
+    std::vector<double> queueLengthTime;
+    size_t currentQueueLength;
+    simtime_t lastQueueLengthChange;
+    simtime_t queueLengthStartTime;
+    
+    // Fixed-interval time series, flushed lazily when an event falls into
+    // a later interval (no extra timer events)
+    simtime_t statsInterval;  // 0 = off
+    simtime_t intervalEnd;
+    simtime_t busyMark;       // start of the not yet credited busy time
+    int intervalServed;
+    int intervalWaitCount;
+    double intervalWaitSum;
+    simtime_t intervalBusyTime;
+    size_t intervalMaxQueueLength;
+    cOutVector intervalServedVector;
+    cOutVector intervalMeanWaitVector;
+    cOutVector intervalUtilizationVector;
+    cOutVector intervalMaxQueueLengthVector;
+    BatchMeans intervalUtilizationBatches;
+    
+    // Infinitesimal perturbation analysis along the Lindley recursion:
+    // derivatives of the last departure time with respect to a relative
+    // scale of all service times and to the mean inter-arrival time
+    simtime_t lastDepartureTime;
+    double lastDepartureItemTimeScale;
+    double lastDepartureArrivalInterval;
+    
     // Statistics
     int customersServed;
     double totalServiceTime;
+    double totalWaitingTime;
     int totalItemsProcessed;
     
     // Statistics signals
@@ -37,13 +128,29 @@ class Cashier : public cSimpleModule
     simsignal_t waitingTimeSignal;
     simsignal_t serviceTimeSignal;
     simsignal_t idleTimeSignal;
+    simsignal_t customerDepartedSignal;
+    simsignal_t onVacationSignal;
+    simsignal_t ipaItemTimeScaleSignal;
+    simsignal_t ipaArrivalIntervalSignal;
+    
+  public:
+    void startVacation();
+    void endVacation();
+    bool isOnVacation() const { return vacationDepth > 0; }
+    int getCustomersServed() const { return customersServed; }
+    double getTotalServiceTime() const { return totalServiceTime; }
+    double getTotalWaitingTime() const { return totalWaitingTime; }
+    void restoreSnapshot(const StoreSnapshot::Lane& lane, bool sampled = false);
     
   protected:
     virtual void initialize() override;
     virtual void handleMessage(cMessage *msg) override;
     virtual void finish() override;
     void processNextCustomer();
-    void startService(CustomerMsg *customer);
+    void queueLengthChanged();
+    void advanceIntervals();
+    void flushInterval(simtime_t end);
+    void startService(const QueuedCustomer& queued);
     void finishService();
 };
 
@@ -55,28 +162,124 @@ void Cashier::initialize()
     isBusy = false;
     cashierIndex = getIndex();
     currentCustomer = nullptr;
+    serviceMsg = new CustomerMsg("customer");
+    alignedServiceDraws = par("alignedServiceDraws").boolValue();
     
     // Initialize timing
     lastServiceEndTime = simTime();
     totalIdleTime = 0;
     
+    // Initialize vacation state
+    vacationDepth = 0;
+    vacationStartTime = 0;
+    totalVacationTime = 0;
+    vacationsTaken = 0;
+    
+    // Initialize queue length distribution
+    queueLengthTime.assign(1, 0.0);
+    currentQueueLength = 0;
+    lastQueueLengthChange = simTime();
+    queueLengthStartTime = simTime();
+    
+    // Initialize interval time series
+    statsInterval = par("statsInterval");
+    intervalEnd = simTime() + statsInterval;
+    busyMark = simTime();
+    intervalServed = 0;
+    intervalWaitCount = 0;
+    intervalWaitSum = 0;
+    intervalBusyTime = 0;
+    intervalMaxQueueLength = 0;
+    intervalServedVector.setName("intervalServed");
+    intervalMeanWaitVector.setName("intervalMeanWait");
+    intervalMeanWaitVector.setUnit("s");
+    intervalUtilizationVector.setName("intervalUtilization");
+    intervalMaxQueueLengthVector.setName("intervalMaxQueueLength");
+    
     // Initialize statistics
     customersServed = 0;
     totalServiceTime = 0.0;
+    totalWaitingTime = 0.0;
     totalItemsProcessed = 0;
     
+    lastDepartureTime = -1;
+    lastDepartureItemTimeScale = 0;
+    lastDepartureArrivalInterval = 0;
+    
     // Register statistics signals
     queueLengthSignal = registerSignal("queueLength");
     waitingTimeSignal = registerSignal("waitingTime");
     serviceTimeSignal = registerSignal("serviceTime");
     idleTimeSignal = registerSignal("idleTime");
+    customerDepartedSignal = registerSignal("customerDeparted");
+    onVacationSignal = registerSignal("onVacation");
+    ipaItemTimeScaleSignal = registerSignal("ipaItemTimeScale");
+    ipaArrivalIntervalSignal = registerSignal("ipaArrivalInterval");
     
     // Record initial queue length
     emit(queueLengthSignal, 0);
+    emit(onVacationSignal, 0L);
+    
+    // Digital-twin mode: start from the live state of this lane
+    StoreSnapshot snapshot;
+    if (readStoreSnapshot(getParentModule(), snapshot) && cashierIndex < (int)snapshot.lanes.size())
+        restoreSnapshot(snapshot.lanes[cashierIndex]);
+}
+
+void Cashier::restoreSnapshot(const StoreSnapshot::Lane& lane, bool sampled)
+{
+    Enter_Method_Silent();
+    
+    // Customers from a snapshot have id 0. Their inter-arrival time is set to
+    // the mean, so they add no deviation to the arrival control variate.
+    // Customers of a sampled steady state have id -1: their waits are not
+    // recorded, since the customers present at a random instant are biased
+    // towards long waits.
+    int customerId = sampled ? -1 : 0;
+    double arrivalInterval = getParentModule()->getSubmodule("shop")->par("arrivalInterval").doubleValue();
+    
+    // The customer in service finishes after the remaining service time;
+    // its wait lies before the snapshot and is not recorded (id -1, also
+    // for a snapshot, so departure listeners skip it too)
+    if (lane.busy) {
+        currentCustomer = serviceMsg;
+        currentCustomer->setCustomerId(-1);
+        currentCustomer->setNumberOfItems(lane.serviceItems);
+        currentCustomer->setArrivalTime(simTime() - lane.elapsedService);
+        currentCustomer->setServiceStartTime(simTime() - lane.elapsedService);
+        currentCustomer->setInterArrivalTime(arrivalInterval);
+        currentCustomer->setArrivalTimeDerivative(0);
+        currentCustomer->setTotalWaitingTime(0);
+        currentCustomer->setBaseServiceTime((lane.elapsedService + lane.remainingService) / par("speedFactor").doubleValue());
+        isBusy = true;
+        busyMark = simTime();
+        scheduleAt(simTime() + lane.remainingService, processCustomerTimer);
+    }
+    
+    // Queued customers keep the time they have already waited
+    for (const StoreSnapshot::Customer& waiting : lane.queue) {
+        QueuedCustomer customer;
+        customer.arrivalTime = simTime() - waiting.waited;
+        customer.interArrivalTime = arrivalInterval;
+        customer.arrivalTimeDerivative = 0;
+        customer.customerId = customerId;
+        customer.numberOfItems = waiting.items;
+        customerQueue.push(customer);
+    }
+    if (!lane.queue.empty())
+        queueLengthChanged();
+    
+    EV << "Cashier " << cashierIndex << " starts from " << (sampled ? "steady state: " : "snapshot: ") << (lane.busy ? "busy" : "idle")
+       << ", " << lane.queue.size() << " waiting\n";
+    
+    if (!isBusy)
+        processNextCustomer();
 }
 
 void Cashier::handleMessage(cMessage *msg)
 {
+    advanceIntervals();
+    
     if (msg == processCustomerTimer) {
         // Finish serving current customer
         finishService();
@@ -87,10 +290,17 @@ void Cashier::handleMessage(cMessage *msg)
         EV << "Cashier " << cashierIndex << " received customer " << customer->getCustomerId() 
            << " with " << customer->getNumberOfItems() << " items\n";
         
-        customerQueue.push(customer);
+        QueuedCustomer queued;
+        queued.arrivalTime = customer->getArrivalTime();
+        queued.interArrivalTime = customer->getInterArrivalTime();
+        queued.arrivalTimeDerivative = customer->getArrivalTimeDerivative();
+        queued.customerId = customer->getCustomerId();
+        queued.numberOfItems = customer->getNumberOfItems();
+        customerQueue.push(queued);
+        delete customer;
         
         // Record queue length change
-        emit(queueLengthSignal, (long)customerQueue.size());
+        queueLengthChanged();
         
         if (!isBusy) {
             processNextCustomer();
@@ -100,22 +310,77 @@ void Cashier::handleMessage(cMessage *msg)
 
 void Cashier::processNextCustomer()
 {
-    if (!customerQueue.empty()) {
-        CustomerMsg *customer = customerQueue.front();
+    // No new customers are pulled from the queue while on vacation
+    if (!customerQueue.empty() && vacationDepth == 0) {
+        QueuedCustomer customer = customerQueue.front();
         customerQueue.pop();
         
         // Record queue length change
-        emit(queueLengthSignal, (long)customerQueue.size());
+        queueLengthChanged();
         
         startService(customer);
     } else {
+        if (isBusy)
+            intervalBusyTime += simTime() - busyMark;
         isBusy = false;
         // Start measuring idle time
         lastServiceEndTime = simTime();
     }
 }
 
-void Cashier::startService(CustomerMsg *customer)
+void Cashier::queueLengthChanged()
+{
+    // Credit the time since the last change to the previous length
+    queueLengthTime[currentQueueLength] += SIMTIME_DBL(simTime() - lastQueueLengthChange);
+    lastQueueLengthChange = simTime();
+    
+    currentQueueLength = customerQueue.size();
+    if (currentQueueLength >= queueLengthTime.size())
+        queueLengthTime.resize(currentQueueLength + 1, 0.0);
+    intervalMaxQueueLength = std::max(intervalMaxQueueLength, currentQueueLength);
+    
+    emit(queueLengthSignal, (long)currentQueueLength);
+}
+
+void Cashier::advanceIntervals()
+{
+    if (statsInterval <= 0)
+        return;
+    
+    while (simTime() >= intervalEnd) {
+        flushInterval(intervalEnd);
+        intervalEnd += statsInterval;
+    }
+}
+
+void Cashier::flushInterval(simtime_t end)
+{
+    simtime_t length = end - (intervalEnd - statsInterval);
+    if (length <= 0)
+        return;
+    
+    // Credit busy time up to the end of the interval
+    if (isBusy) {
+        intervalBusyTime += end - busyMark;
+        busyMark = end;
+    }
+    double utilization = SIMTIME_DBL(intervalBusyTime / length);
+    
+    intervalServedVector.recordWithTimestamp(end, intervalServed);
+    intervalMeanWaitVector.recordWithTimestamp(end, intervalWaitCount > 0 ? intervalWaitSum / intervalWaitCount : 0);
+    intervalUtilizationVector.recordWithTimestamp(end, utilization);
+    intervalMaxQueueLengthVector.recordWithTimestamp(end, (double)intervalMaxQueueLength);
+    if (end == intervalEnd)
+        intervalUtilizationBatches.record(utilization);  // complete intervals only
+    
+    intervalServed = 0;
+    intervalWaitCount = 0;
+    intervalWaitSum = 0;
+    intervalBusyTime = 0;
+    intervalMaxQueueLength = customerQueue.size();
+}
+
+void Cashier::startService(const QueuedCustomer& queued)
 {
     // Calculate idle time if we were idle
     if (!isBusy) {
@@ -124,17 +389,39 @@ void Cashier::startService(CustomerMsg *customer)
         emit(idleTimeSignal, SIMTIME_DBL(idleTime));
     }
     
+    if (!isBusy)
+        busyMark = simTime();
     isBusy = true;
-    currentCustomer = customer;  // Store reference to current customer
+    CustomerMsg *customer = serviceMsg;
+    customer->setCustomerId(queued.customerId);
+    customer->setNumberOfItems(queued.numberOfItems);
+    customer->setArrivalTime(queued.arrivalTime);
+    customer->setInterArrivalTime(queued.interArrivalTime);
+    customer->setArrivalTimeDerivative(queued.arrivalTimeDerivative);
     customer->setServiceStartTime(simTime());
+    currentCustomer = customer;  // Store reference to current customer
     
-    // Calculate service time: 0.5s to 2s per item
+    // Calculate service time: 0.5s to 2s per item, scaled by the
+    // cashier's (possibly drifting) speed factor
     int items = customer->getNumberOfItems();
     double serviceTime = 0.0;
     
-    for (int i = 0; i < items; i++) {
-        serviceTime += uniform(0.5, 2.0);  // Random time per item
+    if (alignedServiceDraws) {
+        // Antithetic runs: a time is drawn for the largest possible basket
+        // and the first items are used, so every service takes the same
+        // number of draws and the pairs stay aligned whatever the baskets
+        for (int i = 0; i < ServiceModel::MAX_ITEMS; i++) {
+            double itemTime = uniform(ServiceModel::MIN_ITEM_TIME, ServiceModel::MAX_ITEM_TIME);
+            if (i < items)
+                serviceTime += itemTime;
+        }
+    } else {
+        for (int i = 0; i < items; i++) {
+            serviceTime += uniform(ServiceModel::MIN_ITEM_TIME, ServiceModel::MAX_ITEM_TIME);  // Random time per item
+        }
     }
+    customer->setBaseServiceTime(serviceTime);
+    serviceTime *= par("speedFactor").doubleValue();
     
     EV << "Cashier " << cashierIndex << " starts serving customer " 
        << customer->getCustomerId() << " (service time: " << serviceTime << "s)\n";
@@ -147,18 +434,41 @@ void Cashier::startService(CustomerMsg *customer)
             serviceTime);
     bubble(bubbleText);
     
-    // Calculate and record waiting time
+    // Calculate and record waiting time (not for a sampled initial state)
+    bool recordWait = customer->getCustomerId() >= 0;
     double waitingTime = SIMTIME_DBL(simTime() - customer->getArrivalTime());
     customer->setTotalWaitingTime(waitingTime);
-    emit(waitingTimeSignal, waitingTime);
+    if (recordWait)
+        emit(waitingTimeSignal, waitingTime);
     
     // Record service time
     emit(serviceTimeSignal, serviceTime);
     
+    // IPA: the service starts on arrival (idle cashier), on the previous
+    // departure, or at the end of a vacation (independent of both parameters)
+    double startItemTimeScale = 0, startArrivalInterval = 0;
+    if (simTime() == customer->getArrivalTime()) {
+        startArrivalInterval = customer->getArrivalTimeDerivative();
+    } else if (simTime() == lastDepartureTime) {
+        startItemTimeScale = lastDepartureItemTimeScale;
+        startArrivalInterval = lastDepartureArrivalInterval;
+    }
+    if (recordWait) {
+        emit(ipaItemTimeScaleSignal, startItemTimeScale);
+        emit(ipaArrivalIntervalSignal, startArrivalInterval - customer->getArrivalTimeDerivative());
+    }
+    lastDepartureItemTimeScale = startItemTimeScale + serviceTime;  // dS/dscale = S at scale 1
+    lastDepartureArrivalInterval = startArrivalInterval;
+    
     // Update statistics
     customersServed++;
     totalServiceTime += serviceTime;
     totalItemsProcessed += items;
+    if (recordWait) {
+        totalWaitingTime += waitingTime;
+        intervalWaitSum += waitingTime;
+        intervalWaitCount++;
+    }
     
     scheduleAt(simTime() + serviceTime, processCustomerTimer);
 }
@@ -180,16 +490,82 @@ void Cashier::finishService()
         
         // Record service end time for idle time calculation
         lastServiceEndTime = simTime();
+        lastDepartureTime = simTime();
+        intervalServed++;
+        
+        // Let the balancer update its occupancy counter and queue view
+        // (the customer goes along as details for completion feedback)
+        emit(customerDepartedSignal, (long)cashierIndex, currentCustomer);
         
-        delete currentCustomer;
         currentCustomer = nullptr;
     }
 }
 
+void Cashier::startVacation()
+{
+    Enter_Method("startVacation()");
+    advanceIntervals();
+    
+    if (vacationDepth++ > 0)
+        return;  // already away
+    
+    // Close the current idle period; time away does not count as idle
+    if (!isBusy) {
+        simtime_t idleTime = simTime() - lastServiceEndTime;
+        totalIdleTime += idleTime;
+        emit(idleTimeSignal, SIMTIME_DBL(idleTime));
+    }
+    
+    // A busy cashier finishes the current customer first; that time is
+    // already busy time, so the vacation clock starts at the service end
+    vacationStartTime = isBusy ? std::max(simTime(), processCustomerTimer->getArrivalTime()) : simTime();
+    vacationsTaken++;
+    emit(onVacationSignal, 1L);
+    
+    EV << "Cashier " << cashierIndex << " goes on vacation"
+       << (isBusy ? " after the current customer" : "") << "\n";
+    bubble("Lane closed");
+}
+
+void Cashier::endVacation()
+{
+    Enter_Method("endVacation()");
+    advanceIntervals();
+    
+    if (--vacationDepth > 0)
+        return;  // still away for another reason
+    
+    if (simTime() > vacationStartTime)
+        totalVacationTime += simTime() - vacationStartTime;
+    emit(onVacationSignal, 0L);
+    
+    EV << "Cashier " << cashierIndex << " is back, " << customerQueue.size() << " customers waiting\n";
+    bubble("Lane open");
+    
+    if (!isBusy) {
+        lastServiceEndTime = simTime();
+        processNextCustomer();
+    }
+}
+
 void Cashier::finish()
 {
+    // Complete the interval time series, including the partial last interval
+    if (statsInterval > 0) {
+        advanceIntervals();
+        flushInterval(simTime());
+        
+        BatchMeans::Estimate utilization = intervalUtilizationBatches.estimate();
+        recordScalar("intervalUtilization:bmMean", utilization.mean);
+        recordScalar("intervalUtilization:bmHalfWidth", utilization.halfWidth);
+        recordScalar("intervalUtilization:bmBatches", utilization.batches);
+    }
+    
     // Add final idle time if cashier is idle at end
-    if (!isBusy) {
+    if (vacationDepth > 0) {
+        if (simTime() > vacationStartTime)
+            totalVacationTime += simTime() - vacationStartTime;
+    } else if (!isBusy) {
         simtime_t finalIdleTime = simTime() - lastServiceEndTime;
         totalIdleTime += finalIdleTime;
     }
@@ -198,6 +574,7 @@ void Cashier::finish()
     double simulationTime = SIMTIME_DBL(simTime());
     double utilizationRate = simulationTime > 0 ? (totalServiceTime / simulationTime) * 100 : 0;
     double idleRate = simulationTime > 0 ? (SIMTIME_DBL(totalIdleTime) / simulationTime) * 100 : 0;
+    double availabilityRate = simulationTime > 0 ? (1 - SIMTIME_DBL(totalVacationTime) / simulationTime) * 100 : 100;
     
     EV << "Cashier " << cashierIndex << " Statistics:\n";
     EV << "  Customers served: " << customersServed << "\n";
@@ -206,6 +583,7 @@ void Cashier::finish()
     EV << "  Total idle time: " << totalIdleTime << "s\n";
     EV << "  Utilization rate: " << utilizationRate << "%\n";
     EV << "  Idle rate: " << idleRate << "%\n";
+    EV << "  Availability: " << availabilityRate << "% (" << vacationsTaken << " vacations)\n";
     EV << "  Average service time: " << (customersServed > 0 ? totalServiceTime / customersServed : 0) << "s\n";
     EV << "  Queue length at end: " << customerQueue.size() << "\n";
     
@@ -215,73 +593,427 @@ void Cashier::finish()
     recordScalar("totalIdleTime", SIMTIME_DBL(totalIdleTime));
     recordScalar("utilizationRate", utilizationRate);
     recordScalar("idleRate", idleRate);
+    recordScalar("availabilityRate", availabilityRate);
+    recordScalar("vacationsTaken", vacationsTaken);
+    recordScalar("totalVacationTime", SIMTIME_DBL(totalVacationTime));
     recordScalar("averageServiceTime", customersServed > 0 ? totalServiceTime / customersServed : 0);
     recordScalar("queueLengthAtEnd", (double)customerQueue.size());
     recordScalar("totalItemsProcessed", totalItemsProcessed);
     
+    // Time-weighted queue length distribution P(Q=k), its mean and the
+    // tail probabilities P(Q>k)
+    queueLengthTime[currentQueueLength] += SIMTIME_DBL(simTime() - lastQueueLengthChange);
+    lastQueueLengthChange = simTime();
+    double observedTime = SIMTIME_DBL(simTime() - queueLengthStartTime);
+    if (observedTime > 0) {
+        double meanQueueLength = 0;
+        double tail = 1.0;
+        for (size_t k = 0; k < queueLengthTime.size(); k++) {
+            double probability = queueLengthTime[k] / observedTime;
+            meanQueueLength += k * probability;
+            tail -= probability;
+            
+            char scalarName[50];
+            sprintf(scalarName, "queueLengthProb%d", (int)k);
+            recordScalar(scalarName, probability);
+            sprintf(scalarName, "queueLengthTail%d", (int)k);
+            recordScalar(scalarName, std::max(0.0, tail));
+        }
+        recordScalar("queueLengthTimeAvg", meanQueueLength);
+    }
+    
     cancelAndDelete(processCustomerTimer);
+    delete serviceMsg;
 }
 
 //==============================================================================
 // BALANCER CLASS
 //==============================================================================
-class Balancer : public cSimpleModule
+class Balancer : public cSimpleModule, public cListener
 {
   private:
     enum BalancingStrategy {
         ROUND_ROBIN = 0,
         SHORTEST_QUEUE = 1,
-        RANDOM = 2
+        RANDOM = 2,
+        HIERARCHICAL = 3,
+        LEARNING = 4
+    };
+    
+    enum VacationPolicy {
+        KEEP_ROUTING = 0,   // customers still join the queue of an absent cashier
+        EXCLUDE = 1         // absent cashiers get no new customers
+    };
+    
+    // A departure as reported by a cashier, kept until it becomes visible
+    // to the balancer
+    struct QueueStateUpdate {
+        simtime_t time;
+        int cashier;
+        int numberOfItems;
+        double serviceTime;
     };
     
     BalancingStrategy strategy;
+    VacationPolicy vacationPolicy;
+    std::vector<bool> cashierAvailable;
+    int availableCashiers;
     int roundRobinCounter;
-    std::vector<int> cashierQueueLengths;
+    std::vector<int> cashierQueueLengths;  // the balancer's (possibly stale) view
+    std::vector<int> trueQueueLengths;
     int numCashiers;
     
+    // Information delay: departures reach the balancer's view after
+    // stateUpdateDelay, or in batches every stateSnapshotInterval
+    simtime_t stateUpdateDelay;
+    simtime_t stateSnapshotInterval;
+    simtime_t stateSnapshotStart;  // snapshots fall on this grid, the timer only runs while updates are pending
+    std::deque<QueueStateUpdate> pendingUpdates;
+    cMessage *stateUpdateTimer;
+    
+    // Admission control: customers currently in the cashier queues
+    // (including those in service), updated on admission and departure
+    int capacity;   // -1 = unlimited
+    int occupancy;
+    
+    // Hierarchical balancing: cashiers are grouped into zones of zoneSize.
+    // The top level only sees per-zone load summaries. It counts its own
+    // assignments immediately, while departures are reported upward in
+    // batches of zoneSummaryBatch.
+    int zoneSize;
+    int numZones;
+    int zoneSummaryBatch;
+    std::vector<long> zoneLoad;
+    std::vector<long> zonePendingDepartures;
+    std::vector<int> zoneAvailable;  // cashiers per zone not on vacation
+    
+    // Learning balancing: per-cashier seconds-per-item estimates, learned
+    // from completion feedback, and the items assigned but not yet served
+    int candidateSamples;
+    double explorationRate;
+    double learningRate;
+    std::vector<double> itemTimeEstimates;
+    std::vector<long> cashierWorkload;
+    
     // Statistics
     int customersForwarded;
     std::vector<int> cashierAssignments; // Track assignments per cashier
+    double entriesInspected;  // queue/zone entries examined by selectCashier()
+    double decisionTime;      // wall-clock time spent in selectCashier() (ns)
+    double totalViewError;    // |true - seen| queue length of the chosen cashier
+    long stateUpdateEvents;   // deliveries of queue-state updates to the view, in every mode
     
     // Statistics signals  
     simsignal_t loadBalancingSignal;
+    simsignal_t occupancySignal;
+    simsignal_t customerDepartedSignal;
+    simsignal_t onVacationSignal;
+    simsignal_t itemTimeEstimateSignal;
+    simsignal_t predictionErrorSignal;
+    
+  public:
+    virtual ~Balancer();
+    bool tryAdmit();
+    int getOccupancy() const { return occupancy; }
+    int getCapacity() const { return capacity; }
     
   protected:
+    virtual int numInitStages() const override { return 2; }
+    virtual void initialize(int stage) override;
     virtual void initialize() override;
     virtual void handleMessage(cMessage *msg) override;
     virtual void finish() override;
-    int selectCashier();
+    using cListener::receiveSignal;
+    virtual void receiveSignal(cComponent *source, simsignal_t signalID, long value, cObject *details) override;
+    int selectCashier(int numberOfItems);
+    int selectHierarchical();
+    int selectLearning(int numberOfItems);
+    void applyStateUpdate(const QueueStateUpdate& update);
+    void learnFromDeparture(const QueueStateUpdate& update);
+    bool isEligible(int cashier) const;
+    void restoreSnapshot(const StoreSnapshot& snapshot);
+    void startNearSteadyState();
 };
 
 Define_Module(Balancer);
 
+Balancer::~Balancer()
+{
+    cModule *parent = getParentModule();
+    for (const char *signalName : {"customerDeparted", "onVacation"}) {
+        simsignal_t signal = registerSignal(signalName);
+        if (parent && parent->isSubscribed(signal, this))
+            parent->unsubscribe(signal, this);
+    }
+}
+
+void Balancer::initialize(int stage)
+{
+    // Stage 1 runs after all cashiers are initialized
+    if (stage == 0)
+        initialize();
+    else
+        startNearSteadyState();
+}
+
 void Balancer::initialize()
 {
     // Get balancing strategy from parameter (default: round robin)
     strategy = static_cast<BalancingStrategy>(par("strategy").intValue());
+    vacationPolicy = static_cast<VacationPolicy>(par("vacationPolicy").intValue());
     roundRobinCounter = 0;
     
     // Get number of cashiers from gate size
     numCashiers = gateSize("out");
     cashierQueueLengths.resize(numCashiers, 0);
+    trueQueueLengths.resize(numCashiers, 0);
     cashierAssignments.resize(numCashiers, 0);
+    cashierAvailable.resize(numCashiers, true);
+    availableCashiers = numCashiers;
     customersForwarded = 0;
+    entriesInspected = 0;
+    decisionTime = 0;
+    totalViewError = 0;
+    stateUpdateEvents = 0;
+    
+    stateUpdateDelay = par("stateUpdateDelay");
+    stateSnapshotInterval = par("stateSnapshotInterval");
+    stateUpdateTimer = new cMessage("stateUpdate");
+    stateSnapshotStart = simTime();
+    
+    zoneSize = std::max(1, (int)par("zoneSize").intValue());
+    zoneSummaryBatch = std::max(1, (int)par("zoneSummaryBatch").intValue());
+    numZones = (numCashiers + zoneSize - 1) / zoneSize;
+    zoneLoad.resize(numZones, 0);
+    zonePendingDepartures.resize(numZones, 0);
+    zoneAvailable.resize(numZones, 0);
+    for (int i = 0; i < numCashiers; i++)
+        zoneAvailable[i / zoneSize]++;
+    
+    candidateSamples = std::max(1, (int)par("candidateSamples").intValue());
+    explorationRate = par("explorationRate").doubleValue();
+    learningRate = par("learningRate").doubleValue();
+    itemTimeEstimates.resize(numCashiers, 1.25);  // prior: mean of uniform(0.5, 2.0)
+    cashierWorkload.resize(numCashiers, 0);
+    
+    capacity = par("capacity").intValue();
+    occupancy = 0;
+    
+    // Digital-twin mode: the cashiers start with the snapshot's customers
+    StoreSnapshot snapshot;
+    if (readStoreSnapshot(getParentModule(), snapshot))
+        restoreSnapshot(snapshot);
     
     // Register statistics signals
     loadBalancingSignal = registerSignal("loadBalancing");
+    itemTimeEstimateSignal = registerSignal("itemTimeEstimate");
+    predictionErrorSignal = registerSignal("predictionError");
+    occupancySignal = registerSignal("occupancy");
+    emit(occupancySignal, (long)occupancy);
+    
+    // Cashiers report departures; their signals propagate up to our parent
+    customerDepartedSignal = registerSignal("customerDeparted");
+    getParentModule()->subscribe(customerDepartedSignal, this);
+    onVacationSignal = registerSignal("onVacation");
+    getParentModule()->subscribe(onVacationSignal, this);
     
     EV << "Balancer initialized with " << numCashiers << " cashiers and strategy: ";
     switch(strategy) {
         case ROUND_ROBIN: EV << "Round Robin\n"; break;
         case SHORTEST_QUEUE: EV << "Shortest Queue First\n"; break;
         case RANDOM: EV << "Random\n"; break;
+        case HIERARCHICAL: EV << "Hierarchical (" << numZones << " zones of " << zoneSize << ")\n"; break;
+        case LEARNING: EV << "Learning (" << candidateSamples << " candidates)\n"; break;
+    }
+    if (capacity >= 0)
+        EV << "Store capacity: " << capacity << " customers\n";
+}
+
+void Balancer::restoreSnapshot(const StoreSnapshot& snapshot)
+{
+    if ((int)snapshot.lanes.size() > numCashiers)
+        throw cRuntimeError("Store snapshot has %d lanes, but the store has only %d cashiers",
+                (int)snapshot.lanes.size(), numCashiers);
+    
+    // Views start exact; the customers count against the capacity
+    for (int i = 0; i < (int)snapshot.lanes.size(); i++) {
+        const StoreSnapshot::Lane& lane = snapshot.lanes[i];
+        int customers = lane.customers();
+        cashierQueueLengths[i] = customers;
+        trueQueueLengths[i] = customers;
+        zoneLoad[i / zoneSize] += customers;
+        occupancy += customers;
+        
+        long items = lane.busy ? lane.serviceItems : 0;
+        for (const StoreSnapshot::Customer& waiting : lane.queue)
+            items += waiting.items;
+        cashierWorkload[i] = items;
+        if (lane.itemTimeEstimate > 0)
+            itemTimeEstimates[i] = lane.itemTimeEstimate;
+    }
+    roundRobinCounter = (int)(snapshot.roundRobinCounter % numCashiers);
+}
+
+void Balancer::startNearSteadyState()
+{
+    // Steady-state initialization: one sampled state for the whole store,
+    // pushed to the cashiers (a snapshot file takes precedence)
+    cModule *store = getParentModule();
+    std::string mode = store->par("initialState").stdstringValue();
+    if (mode == "empty" || !store->par("snapshotFile").stdstringValue().empty())
+        return;
+    if (mode != "analytic" && mode != "pilot")
+        throw cRuntimeError("Unknown initialState '%s' (empty, analytic or pilot)", mode.c_str());
+    
+    SteadyState steadyState;
+    try {
+        if (mode == "analytic") {
+            double arrivalInterval = store->getSubmodule("shop")->par("arrivalInterval").doubleValue();
+            double speedFactor = store->getSubmodule("cashier", 0)->par("speedFactor").doubleValue();
+            steadyState = SteadyState::analytic(numCashiers, arrivalInterval, strategy, speedFactor);
+        } else {
+            steadyState = SteadyState::read(store->par("steadyStateFile").stdstringValue());
+        }
+    }
+    catch (std::exception& e) {
+        throw cRuntimeError("Cannot start near steady state (%s): %s", mode.c_str(), e.what());
     }
+    if ((int)steadyState.customers.size() != numCashiers)
+        throw cRuntimeError("Steady state has %d lanes, but the store has %d cashiers",
+                (int)steadyState.customers.size(), numCashiers);
+    
+    StoreSnapshot snapshot = steadyState.sample([this]() { return uniform(0, 1); });
+    restoreSnapshot(snapshot);
+    emit(occupancySignal, (long)occupancy);
+    for (int i = 0; i < numCashiers; i++)
+        check_and_cast<Cashier*>(store->getSubmodule("cashier", i))->restoreSnapshot(snapshot.lanes[i], true);
+    
+    EV << "Store starts near steady state (" << mode << "): " << occupancy << " customers\n";
+}
+
+bool Balancer::tryAdmit()
+{
+    Enter_Method_Silent();
+    
+    if (capacity >= 0 && occupancy >= capacity)
+        return false;
+    
+    occupancy++;
+    emit(occupancySignal, (long)occupancy);
+    return true;
+}
+
+void Balancer::receiveSignal(cComponent *source, simsignal_t signalID, long value, cObject *details)
+{
+    Enter_Method_Silent();
+    
+    if (signalID == customerDepartedSignal) {
+        CustomerMsg *customer = check_and_cast<CustomerMsg*>(details);
+        QueueStateUpdate update;
+        update.time = simTime();
+        update.cashier = (int)value;
+        update.numberOfItems = customer->getNumberOfItems();
+        update.serviceTime = SIMTIME_DBL(simTime() - customer->getServiceStartTime());
+        trueQueueLengths[update.cashier]--;
+        
+        // The occupancy counter is exact, only the routing view may lag
+        occupancy--;
+        emit(occupancySignal, (long)occupancy);
+        
+        if (stateUpdateDelay == 0 && stateSnapshotInterval == 0) {
+            applyStateUpdate(update);
+            stateUpdateEvents++;
+        } else {
+            pendingUpdates.push_back(update);
+            if (!stateUpdateTimer->isScheduled()) {
+                if (stateSnapshotInterval > 0) {
+                    // Next snapshot on the grid, strictly after now
+                    double intervals = floor((simTime() - stateSnapshotStart) / stateSnapshotInterval);
+                    scheduleAt(stateSnapshotStart + (intervals + 1) * stateSnapshotInterval, stateUpdateTimer);
+                } else {
+                    scheduleAt(update.time + stateUpdateDelay, stateUpdateTimer);
+                }
+            }
+        }
+    }
+    else if (signalID == onVacationSignal) {
+        int cashier = check_and_cast<cModule*>(source)->getIndex();
+        bool available = (value == 0);
+        if (cashierAvailable[cashier] != available) {
+            cashierAvailable[cashier] = available;
+            availableCashiers += available ? 1 : -1;
+            zoneAvailable[cashier / zoneSize] += available ? 1 : -1;
+        }
+    }
+}
+
+void Balancer::applyStateUpdate(const QueueStateUpdate& update)
+{
+    int cashier = update.cashier;
+    if (cashierQueueLengths[cashier] > 0)
+        cashierQueueLengths[cashier]--;
+    
+    // Report departures to the top level once a batch is complete
+    int zone = cashier / zoneSize;
+    if (++zonePendingDepartures[zone] >= zoneSummaryBatch) {
+        zoneLoad[zone] = std::max(0L, zoneLoad[zone] - zonePendingDepartures[zone]);
+        zonePendingDepartures[zone] = 0;
+    }
+    
+    cashierWorkload[cashier] -= update.numberOfItems;
+    if (strategy == LEARNING)
+        learnFromDeparture(update);
+}
+
+void Balancer::learnFromDeparture(const QueueStateUpdate& update)
+{
+    int cashier = update.cashier;
+    int items = update.numberOfItems;
+    double serviceTime = update.serviceTime;
+    if (items <= 0 || serviceTime <= 0)
+        return;
+    
+    // Learning curve: how well did the estimate predict this service?
+    double predicted = items * itemTimeEstimates[cashier];
+    emit(predictionErrorSignal, fabs(predicted - serviceTime) / serviceTime);
+    
+    // Exponentially weighted update, so drifting speeds are tracked
+    itemTimeEstimates[cashier] += learningRate * (serviceTime / items - itemTimeEstimates[cashier]);
+    emit(itemTimeEstimateSignal, itemTimeEstimates[cashier]);
+}
+
+bool Balancer::isEligible(int cashier) const
+{
+    // With every cashier away there is nowhere else to go
+    return vacationPolicy == KEEP_ROUTING || availableCashiers == 0 || cashierAvailable[cashier];
 }
 
 void Balancer::handleMessage(cMessage *msg)
 {
-    if (CustomerMsg *customer = dynamic_cast<CustomerMsg*>(msg)) {
-        int selectedCashier = selectCashier();
+    if (msg == stateUpdateTimer) {
+        // Deliver all departures whose information delay has passed
+        bool delivered = false;
+        while (!pendingUpdates.empty() && pendingUpdates.front().time + stateUpdateDelay <= simTime()) {
+            applyStateUpdate(pendingUpdates.front());
+            pendingUpdates.pop_front();
+            delivered = true;
+        }
+        if (delivered)
+            stateUpdateEvents++;
+        
+        // The timer is suspended while nothing is pending; the next
+        // departure restarts it
+        if (!pendingUpdates.empty()) {
+            if (stateSnapshotInterval > 0)
+                scheduleAt(simTime() + stateSnapshotInterval, stateUpdateTimer);
+            else
+                scheduleAt(pendingUpdates.front().time + stateUpdateDelay, stateUpdateTimer);
+        }
+    }
+    else if (CustomerMsg *customer = dynamic_cast<CustomerMsg*>(msg)) {
+        auto decisionStart = std::chrono::steady_clock::now();
+        int selectedCashier = selectCashier(customer->getNumberOfItems());
+        decisionTime += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - decisionStart).count();
         
         EV << "Balancer forwards customer " << customer->getCustomerId() 
            << " to cashier " << selectedCashier << " (strategy: ";
@@ -300,6 +1032,14 @@ void Balancer::handleMessage(cMessage *msg)
                 EV << "Random"; 
                 strategyName = "Random";
                 break;
+            case HIERARCHICAL: 
+                EV << "Hierarchical"; 
+                strategyName = "Hierarchical";
+                break;
+            case LEARNING: 
+                EV << "Learning"; 
+                strategyName = "Learning";
+                break;
         }
         EV << ")\n";
         
@@ -311,9 +1051,13 @@ void Balancer::handleMessage(cMessage *msg)
                 strategyName);
         bubble(bubbleText);
         
-        // Update queue length tracking (simplified - in real implementation 
-        // we would get feedback from cashiers about queue changes)
+        // Update queue length tracking (decremented again when the
+        // cashier reports the customer's departure)
+        totalViewError += abs(trueQueueLengths[selectedCashier] - cashierQueueLengths[selectedCashier]);
         cashierQueueLengths[selectedCashier]++;
+        trueQueueLengths[selectedCashier]++;
+        zoneLoad[selectedCashier / zoneSize]++;
+        cashierWorkload[selectedCashier] += customer->getNumberOfItems();
         cashierAssignments[selectedCashier]++;
         customersForwarded++;
         
@@ -325,31 +1069,127 @@ void Balancer::handleMessage(cMessage *msg)
     }
 }
 
-int Balancer::selectCashier()
+int Balancer::selectCashier(int numberOfItems)
 {
     int selectedCashier = 0;
     
     switch(strategy) {
         case ROUND_ROBIN:
-            selectedCashier = roundRobinCounter % numCashiers;
-            roundRobinCounter++;
+            // Skip absent cashiers, at most one full round
+            for (int tries = 0; tries < numCashiers; tries++) {
+                selectedCashier = roundRobinCounter % numCashiers;
+                roundRobinCounter++;
+                entriesInspected++;
+                if (isEligible(selectedCashier))
+                    break;
+            }
             break;
             
         case SHORTEST_QUEUE:
             {
-                auto minIt = std::min_element(cashierQueueLengths.begin(), cashierQueueLengths.end());
-                selectedCashier = std::distance(cashierQueueLengths.begin(), minIt);
+                int best = -1;
+                for (int i = 0; i < numCashiers; i++) {
+                    if (isEligible(i) && (best < 0 || cashierQueueLengths[i] < cashierQueueLengths[best]))
+                        best = i;
+                }
+                selectedCashier = best;
+                entriesInspected += numCashiers;
             }
             break;
             
         case RANDOM:
-            selectedCashier = intuniform(0, numCashiers - 1);
+            if (vacationPolicy == KEEP_ROUTING || availableCashiers == 0 || availableCashiers == numCashiers) {
+                selectedCashier = intuniform(0, numCashiers - 1);
+                entriesInspected++;
+            } else {
+                // Pick the k-th available cashier
+                int k = intuniform(0, availableCashiers - 1);
+                for (selectedCashier = 0; selectedCashier < numCashiers; selectedCashier++) {
+                    if (cashierAvailable[selectedCashier] && k-- == 0)
+                        break;
+                }
+                entriesInspected += selectedCashier + 1;
+            }
+            break;
+            
+        case HIERARCHICAL:
+            selectedCashier = selectHierarchical();
+            break;
+            
+        case LEARNING:
+            selectedCashier = selectLearning(numberOfItems);
             break;
     }
     
     return selectedCashier;
 }
 
+int Balancer::selectHierarchical()
+{
+    bool excludeAbsent = vacationPolicy == EXCLUDE && availableCashiers > 0;
+    
+    // Top level: least loaded zone per cashier according to the summaries
+    int bestZone = -1;
+    double bestLoad = 0;
+    for (int z = 0; z < numZones; z++) {
+        int zoneCashiers = excludeAbsent ? zoneAvailable[z] : std::min(zoneSize, numCashiers - z * zoneSize);
+        if (zoneCashiers == 0)
+            continue;
+        double load = (double)zoneLoad[z] / zoneCashiers;
+        if (bestZone < 0 || load < bestLoad) {
+            bestZone = z;
+            bestLoad = load;
+        }
+    }
+    entriesInspected += numZones;
+    
+    // Zone level: shortest queue within the chosen zone
+    int first = bestZone * zoneSize;
+    int last = std::min(first + zoneSize, numCashiers);
+    int best = -1;
+    for (int i = first; i < last; i++) {
+        if (isEligible(i) && (best < 0 || cashierQueueLengths[i] < cashierQueueLengths[best]))
+            best = i;
+    }
+    entriesInspected += last - first;
+    
+    return best;
+}
+
+int Balancer::selectLearning(int numberOfItems)
+{
+    // Exploration: now and then a single random candidate is taken as is,
+    // so that the estimates of rarely chosen cashiers stay fresh
+    int numCandidates = uniform(0, 1) < explorationRate ? 1 : candidateSamples;
+    
+    // Exploitation: the sampled candidate with the earliest estimated
+    // completion time for this customer
+    int best = -1;
+    double bestCompletion = 0;
+    for (int c = 0; c < numCandidates; c++) {
+        int i = intuniform(0, numCashiers - 1);
+        entriesInspected++;
+        if (!isEligible(i))
+            continue;
+        double completion = (cashierWorkload[i] + numberOfItems) * itemTimeEstimates[i];
+        if (best < 0 || completion < bestCompletion) {
+            best = i;
+            bestCompletion = completion;
+        }
+    }
+    
+    // Only absent cashiers were drawn: take the next eligible one
+    if (best < 0) {
+        best = intuniform(0, numCashiers - 1);
+        while (!isEligible(best)) {
+            best = (best + 1) % numCashiers;
+            entriesInspected++;
+        }
+    }
+    
+    return best;
+}
+
 void Balancer::finish()
 {
     EV << "Balancer Statistics:\n";
@@ -372,6 +1212,15 @@ void Balancer::finish()
     
     recordScalar("customersForwarded", customersForwarded);
     recordScalar("balancingEfficiency", balancingEfficiency);
+    recordScalar("occupancyAtEnd", occupancy);
+    
+    // Decision cost of the balancing strategy
+    recordScalar("meanDecisionCost", customersForwarded > 0 ? entriesInspected / customersForwarded : 0);
+    recordScalar("meanDecisionTime", customersForwarded > 0 ? decisionTime / customersForwarded : 0, "ns");
+    
+    // Staleness of the queue-state view
+    recordScalar("meanViewError", customersForwarded > 0 ? totalViewError / customersForwarded : 0);
+    recordScalar("stateUpdateEvents", stateUpdateEvents);
     
     // Record individual cashier assignments
     for (int i = 0; i < numCashiers; i++) {
@@ -379,49 +1228,139 @@ void Balancer::finish()
         sprintf(scalarName, "cashier%d_assignments", i);
         recordScalar(scalarName, cashierAssignments[i]);
     }
+    
+    // Learned service speeds
+    if (strategy == LEARNING) {
+        for (int i = 0; i < numCashiers; i++) {
+            char scalarName[50];
+            sprintf(scalarName, "cashier%d_itemTimeEstimate", i);
+            recordScalar(scalarName, itemTimeEstimates[i], "s");
+        }
+    }
+    
+    cancelAndDelete(stateUpdateTimer);
 }
 
 //==============================================================================
 // SHOP CLASS (Customer Generator)
 //==============================================================================
-class Shop : public cSimpleModule
+class Shop : public cSimpleModule, public cListener
 {
   private:
+    enum AdmissionPolicy {
+        BLOCK = 0,          // turn away customers while the store is full
+        WAIT_OUTSIDE = 1    // queue them outside until a place frees up
+    };
+    
     cMessage *generateCustomerTimer;
     int customerCounter;
     double arrivalInterval;
+    double lastInterArrival;  // gap before the next customer (control variate)
+    double arrivalTimeDerivative;  // d(next arrival time)/d(arrivalInterval), for IPA
+    
+    // Admission control
+    Balancer *balancer;
+    AdmissionPolicy admissionPolicy;
+    std::queue<CustomerMsg*> waitingLine;  // customers waiting outside
+    bool releasingWaitingLine;
     
     // Statistics
     int customersGenerated;
+    int customersBlocked;       // arrivals turned away because the store was full
+    int customersWaitedOutside; // arrivals that found the store full and queued outside
+    
+    // Fixed-interval time series of arrivals, flushed lazily
+    simtime_t statsInterval;  // 0 = off
+    simtime_t intervalEnd;
+    int intervalGenerated;
+    cOutVector intervalGeneratedVector;
     
     // Statistics signals
     simsignal_t customerGeneratedSignal;
     simsignal_t interArrivalTimeSignal;
+    simsignal_t customerBlockedSignal;
+    simsignal_t customerWaitedOutsideSignal;
+    simsignal_t outsideWaitTimeSignal;
+    simsignal_t outsideQueueLengthSignal;
+    simsignal_t occupancySignal;
+    
+  public:
+    virtual ~Shop();
+    int getCustomersGenerated() const { return customersGenerated; }
+    int getCustomersBlocked() const { return customersBlocked; }
     
   protected:
     virtual void initialize() override;
     virtual void handleMessage(cMessage *msg) override;
     virtual void finish() override;
+    using cListener::receiveSignal;
+    virtual void receiveSignal(cComponent *source, simsignal_t signalID, long value, cObject *details) override;
     void generateCustomer();
+    void advanceIntervals();
+    void enterStore(CustomerMsg *customer);
+    void releaseWaitingLine();
 };
 
 Define_Module(Shop);
 
+Shop::~Shop()
+{
+    cModule *parent = getParentModule();
+    simsignal_t signal = registerSignal("occupancy");
+    if (parent && parent->isSubscribed(signal, this))
+        parent->unsubscribe(signal, this);
+}
+
 void Shop::initialize()
 {
     generateCustomerTimer = new cMessage("generateCustomer");
     customerCounter = 1;
     arrivalInterval = par("arrivalInterval").doubleValue();
+    lastInterArrival = arrivalInterval;  // first arrival is not sampled: zero deviation
+    arrivalTimeDerivative = 0;  // the first arrival is at a fixed time
+    admissionPolicy = static_cast<AdmissionPolicy>(par("admissionPolicy").intValue());
+    releasingWaitingLine = false;
     customersGenerated = 0;
+    customersBlocked = 0;
+    customersWaitedOutside = 0;
+    
+    statsInterval = par("statsInterval");
+    intervalEnd = simTime() + statsInterval;
+    intervalGenerated = 0;
+    intervalGeneratedVector.setName("intervalGenerated");
     
     // Register statistics signals
     customerGeneratedSignal = registerSignal("customerGenerated");
     interArrivalTimeSignal = registerSignal("interArrivalTime");
+    customerBlockedSignal = registerSignal("customerBlocked");
+    customerWaitedOutsideSignal = registerSignal("customerWaitedOutside");
+    outsideWaitTimeSignal = registerSignal("outsideWaitTime");
+    outsideQueueLengthSignal = registerSignal("outsideQueueLength");
+    
+    // The balancer keeps the store occupancy; watch it so the waiting line
+    // outside can move as soon as a customer leaves
+    balancer = check_and_cast<Balancer*>(gate("out")->getPathEndGate()->getOwnerModule());
+    occupancySignal = registerSignal("occupancy");
+    getParentModule()->subscribe(occupancySignal, this);
+    emit(outsideQueueLengthSignal, 0L);
     
     EV << "Shop initialized with mean arrival interval: " << arrivalInterval << "s (exponential distribution)\n";
     EV << "Current simulation time: " << simTime() << "\n";
     EV << "Scheduling first customer at time: " << (simTime() + 0.1) << "\n";
     
+    // Digital-twin mode: the next arrival is known or drawn from now on
+    // (exponential inter-arrival times are memoryless)
+    StoreSnapshot snapshot;
+    if (readStoreSnapshot(getParentModule(), snapshot)) {
+        double firstArrival = snapshot.nextArrivalIn;
+        if (firstArrival < 0) {
+            firstArrival = exponential(arrivalInterval);
+            arrivalTimeDerivative = firstArrival / arrivalInterval;
+        }
+        scheduleAt(simTime() + firstArrival, generateCustomerTimer);
+        return;
+    }
+    
     // Schedule first customer immediately to start the simulation
     scheduleAt(simTime() + 0.1, generateCustomerTimer);
 }
@@ -429,10 +1368,13 @@ void Shop::initialize()
 void Shop::handleMessage(cMessage *msg)
 {
     if (msg == generateCustomerTimer) {
+        advanceIntervals();
         generateCustomer();
         
         // Schedule next customer arrival using exponential distribution
         double nextArrival = exponential(arrivalInterval);
+        lastInterArrival = nextArrival;
+        arrivalTimeDerivative += nextArrival / arrivalInterval;  // exponential: d/dmean = value/mean
         emit(interArrivalTimeSignal, nextArrival);
         EV << "Next customer scheduled in " << nextArrival << " seconds (exponential)\n";
         scheduleAt(simTime() + nextArrival, generateCustomerTimer);
@@ -446,8 +1388,10 @@ void Shop::generateCustomer()
     // Create new customer
     CustomerMsg *customer = new CustomerMsg("customer");
     customer->setCustomerId(customerCounter++);
-    customer->setNumberOfItems(intuniform(1, 25));  // 1 to 25 items
+    customer->setNumberOfItems(intuniform(ServiceModel::MIN_ITEMS, ServiceModel::MAX_ITEMS));  // 1 to 25 items
     customer->setArrivalTime(simTime());
+    customer->setInterArrivalTime(lastInterArrival);
+    customer->setArrivalTimeDerivative(arrivalTimeDerivative);
     
     EV << "Shop generates customer " << customer->getCustomerId() 
        << " with " << customer->getNumberOfItems() << " items at time " << simTime() << "\n";
@@ -460,18 +1404,796 @@ void Shop::generateCustomer()
     bubble(bubbleText);
     
     customersGenerated++;
+    intervalGenerated++;
     emit(customerGeneratedSignal, (long)customersGenerated);
     
+    // Admission check against the store capacity (nobody may overtake
+    // customers already waiting outside)
+    if (waitingLine.empty() && balancer->tryAdmit()) {
+        enterStore(customer);
+        return;
+    }
+    
+    if (admissionPolicy == WAIT_OUTSIDE) {
+        EV << "Store full, customer " << customer->getCustomerId() << " waits outside\n";
+        customersWaitedOutside++;
+        emit(customerWaitedOutsideSignal, (long)customersWaitedOutside);
+        waitingLine.push(customer);
+        emit(outsideQueueLengthSignal, (long)waitingLine.size());
+    } else {
+        EV << "Store full, customer " << customer->getCustomerId() << " turned away\n";
+        customersBlocked++;
+        emit(customerBlockedSignal, (long)customersBlocked);
+        bubble("Store full - customer turned away");
+        delete customer;
+    }
+}
+
+void Shop::enterStore(CustomerMsg *customer)
+{
+    // Waiting times at the cashiers are measured from entering the store;
+    // the time spent outside before is recorded as outsideWaitTime
+    customer->setArrivalTime(simTime());
+    
     // Send to balancer
     EV << "Sending customer to balancer via 'out' gate\n";
     send(customer, "out");
 }
 
+void Shop::receiveSignal(cComponent *source, simsignal_t signalID, long value, cObject *details)
+{
+    Enter_Method_Silent();
+    
+    // Admitting a customer changes the occupancy as well; ignore those
+    if (signalID == occupancySignal && source == balancer && !releasingWaitingLine)
+        releaseWaitingLine();
+}
+
+void Shop::releaseWaitingLine()
+{
+    releasingWaitingLine = true;
+    while (!waitingLine.empty() && balancer->tryAdmit()) {
+        CustomerMsg *customer = waitingLine.front();
+        waitingLine.pop();
+        emit(outsideQueueLengthSignal, (long)waitingLine.size());
+        
+        double outsideWait = SIMTIME_DBL(simTime() - customer->getArrivalTime());
+        emit(outsideWaitTimeSignal, outsideWait);
+        
+        EV << "Customer " << customer->getCustomerId() << " enters after waiting outside for "
+           << outsideWait << "s\n";
+        enterStore(customer);
+    }
+    releasingWaitingLine = false;
+}
+
+void Shop::advanceIntervals()
+{
+    if (statsInterval <= 0)
+        return;
+    
+    while (simTime() >= intervalEnd) {
+        intervalGeneratedVector.recordWithTimestamp(intervalEnd, intervalGenerated);
+        intervalGenerated = 0;
+        intervalEnd += statsInterval;
+    }
+}
+
 void Shop::finish()
 {
+    // Complete the interval time series, including the partial last interval
+    if (statsInterval > 0) {
+        advanceIntervals();
+        if (simTime() > intervalEnd - statsInterval)
+            intervalGeneratedVector.recordWithTimestamp(simTime(), intervalGenerated);
+    }
+    
+    double blockingProbability = customersGenerated > 0 ? (double)customersBlocked / customersGenerated : 0;
+    double outsideWaitProbability = customersGenerated > 0 ? (double)customersWaitedOutside / customersGenerated : 0;
+    
     EV << "Shop Statistics:\n";
     EV << "  Customers generated: " << customersGenerated << "\n";
+    EV << "  Customers turned away: " << customersBlocked << " (" << blockingProbability * 100 << "%)\n";
+    EV << "  Customers waited outside: " << customersWaitedOutside << " (" << outsideWaitProbability * 100 << "%)\n";
+    EV << "  Waiting outside at end: " << waitingLine.size() << "\n";
     
     recordScalar("customersGenerated", customersGenerated);
+    recordScalar("customersBlocked", customersBlocked);
+    recordScalar("blockingProbability", blockingProbability);
+    recordScalar("customersWaitedOutside", customersWaitedOutside);
+    recordScalar("outsideWaitProbability", outsideWaitProbability);
+    recordScalar("outsideQueueLengthAtEnd", (double)waitingLine.size());
     cancelAndDelete(generateCustomerTimer);
 }
+
+//==============================================================================
+// VACATION SCHEDULER CLASS
+//==============================================================================
+class VacationScheduler : public cSimpleModule
+{
+  private:
+    enum VacationEventType {
+        BREAK_START,
+        BREAK_END,
+        FAILURE,
+        REPAIR
+    };
+    
+    struct VacationEvent {
+        simtime_t time;
+        long sequence;  // keeps the order of simultaneous events deterministic
+        int cashier;
+        VacationEventType type;
+        
+        bool operator>(const VacationEvent& other) const {
+            return time != other.time ? time > other.time : sequence > other.sequence;
+        }
+    };
+    
+    // All vacation timers of all cashiers share one self-message, which is
+    // always scheduled for the earliest pending event
+    std::priority_queue<VacationEvent, std::vector<VacationEvent>, std::greater<VacationEvent>> pendingEvents;
+    cMessage *vacationTimer;
+    long eventCounter;
+    std::vector<Cashier*> cashiers;
+    
+    double breakInterval;
+    double breakDuration;
+    double meanTimeToFailure;
+    double meanRepairTime;
+    
+    // Statistics
+    int breaksStarted;
+    int failuresOccurred;
+    
+  protected:
+    virtual void initialize() override;
+    virtual void handleMessage(cMessage *msg) override;
+    virtual void finish() override;
+    void scheduleVacationEvent(simtime_t time, int cashier, VacationEventType type);
+};
+
+Define_Module(VacationScheduler);
+
+void VacationScheduler::initialize()
+{
+    vacationTimer = new cMessage("vacationTimer");
+    eventCounter = 0;
+    breaksStarted = 0;
+    failuresOccurred = 0;
+    
+    breakInterval = par("breakInterval").doubleValue();
+    breakDuration = par("breakDuration").doubleValue();
+    meanTimeToFailure = par("meanTimeToFailure").doubleValue();
+    meanRepairTime = par("meanRepairTime").doubleValue();
+    
+    cModule *firstCashier = getParentModule()->getSubmodule("cashier", 0);
+    int numCashiers = firstCashier ? firstCashier->getVectorSize() : 0;
+    for (int i = 0; i < numCashiers; i++)
+        cashiers.push_back(check_and_cast<Cashier*>(getParentModule()->getSubmodule("cashier", i)));
+    
+    for (int i = 0; i < numCashiers; i++) {
+        // Stagger the scheduled breaks so the cashiers do not all leave at once
+        if (breakInterval > 0)
+            scheduleVacationEvent(simTime() + breakInterval * (i + 1) / numCashiers, i, BREAK_START);
+        if (meanTimeToFailure > 0)
+            scheduleVacationEvent(simTime() + exponential(meanTimeToFailure), i, FAILURE);
+    }
+    
+    EV << "Vacation scheduler initialized for " << numCashiers << " cashiers (break every "
+       << breakInterval << "s for " << breakDuration << "s, MTTF " << meanTimeToFailure
+       << "s, MTTR " << meanRepairTime << "s)\n";
+}
+
+void VacationScheduler::scheduleVacationEvent(simtime_t time, int cashier, VacationEventType type)
+{
+    pendingEvents.push(VacationEvent{time, eventCounter++, cashier, type});
+    
+    // Keep the single timer pointed at the earliest event
+    const VacationEvent& earliest = pendingEvents.top();
+    if (!vacationTimer->isScheduled() || earliest.time < vacationTimer->getArrivalTime()) {
+        cancelEvent(vacationTimer);
+        scheduleAt(earliest.time, vacationTimer);
+    }
+}
+
+void VacationScheduler::handleMessage(cMessage *msg)
+{
+    if (msg != vacationTimer)
+        return;
+    
+    while (!pendingEvents.empty() && pendingEvents.top().time <= simTime()) {
+        VacationEvent event = pendingEvents.top();
+        pendingEvents.pop();
+        Cashier *cashier = cashiers[event.cashier];
+        
+        switch (event.type) {
+            case BREAK_START:
+                breaksStarted++;
+                cashier->startVacation();
+                scheduleVacationEvent(simTime() + breakDuration, event.cashier, BREAK_END);
+                scheduleVacationEvent(simTime() + breakInterval, event.cashier, BREAK_START);
+                break;
+                
+            case BREAK_END:
+                cashier->endVacation();
+                break;
+                
+            case FAILURE:
+                failuresOccurred++;
+                cashier->startVacation();
+                scheduleVacationEvent(simTime() + exponential(meanRepairTime), event.cashier, REPAIR);
+                break;
+                
+            case REPAIR:
+                cashier->endVacation();
+                scheduleVacationEvent(simTime() + exponential(meanTimeToFailure), event.cashier, FAILURE);
+                break;
+        }
+    }
+    
+    if (!pendingEvents.empty() && !vacationTimer->isScheduled())
+        scheduleAt(pendingEvents.top().time, vacationTimer);
+}
+
+void VacationScheduler::finish()
+{
+    EV << "Vacation Scheduler Statistics:\n";
+    EV << "  Breaks started: " << breaksStarted << "\n";
+    EV << "  Failures occurred: " << failuresOccurred << "\n";
+    
+    recordScalar("breaksStarted", breaksStarted);
+    recordScalar("failuresOccurred", failuresOccurred);
+    
+    cancelAndDelete(vacationTimer);
+}
+
+//==============================================================================
+// CONTROL VARIATE ESTIMATOR CLASS
+//==============================================================================
+// The input distributions have exactly known means (inter-arrival time,
+// basket size, time per item), so their sampled deviations are free control
+// variates for the mean waiting time, see ControlVariates.h
+class ControlVariateEstimator : public cSimpleModule, public cListener
+{
+  private:
+    double meanInterArrival;
+    double meanItems;
+    double meanItemTime;
+    ControlVariates *controlVariates;
+    simsignal_t customerDepartedSignal;
+    
+  public:
+    ControlVariateEstimator() : controlVariates(nullptr) {}
+    virtual ~ControlVariateEstimator();
+    
+  protected:
+    virtual void initialize() override;
+    virtual void finish() override;
+    using cListener::receiveSignal;
+    virtual void receiveSignal(cComponent *source, simsignal_t signalID, long value, cObject *details) override;
+};
+
+Define_Module(ControlVariateEstimator);
+
+ControlVariateEstimator::~ControlVariateEstimator()
+{
+    cModule *parent = getParentModule();
+    simsignal_t signal = registerSignal("customerDeparted");
+    if (parent && parent->isSubscribed(signal, this))
+        parent->unsubscribe(signal, this);
+    delete controlVariates;
+}
+
+void ControlVariateEstimator::initialize()
+{
+    meanInterArrival = getParentModule()->getSubmodule("shop")->par("arrivalInterval").doubleValue();
+    meanItems = par("meanItems").doubleValue();
+    meanItemTime = par("meanItemTime").doubleValue();
+    controlVariates = new ControlVariates(3, par("maxBatches").intValue());
+    
+    // Blocked customers never depart, which would bias the inter-arrival control
+    if (getParentModule()->getSubmodule("balancer")->par("capacity").intValue() >= 0)
+        EV_WARN << "Store capacity is limited, control-variate estimates may be biased\n";
+    
+    customerDepartedSignal = registerSignal("customerDeparted");
+    getParentModule()->subscribe(customerDepartedSignal, this);
+}
+
+void ControlVariateEstimator::receiveSignal(cComponent *source, simsignal_t signalID, long value, cObject *details)
+{
+    Enter_Method_Silent();
+    
+    // Customers of a sampled initial state and the customer in service at a
+    // restore have no recorded wait
+    CustomerMsg *customer = check_and_cast<CustomerMsg*>(details);
+    if (customer->getCustomerId() < 0)
+        return;
+    int items = customer->getNumberOfItems();
+    controlVariates->record(customer->getTotalWaitingTime(), {
+        customer->getInterArrivalTime() - meanInterArrival,
+        items - meanItems,
+        customer->getBaseServiceTime() - items * meanItemTime
+    });
+}
+
+void ControlVariateEstimator::finish()
+{
+    ControlVariates::Estimate estimate = controlVariates->estimate(par("confidence").doubleValue(),
+                                                                   par("minBatches").intValue());
+    
+    // Replications needed for a given precision scale with the squared half-width
+    double varianceRatio = estimate.plainHalfWidth > 0 ? pow(estimate.halfWidth / estimate.plainHalfWidth, 2) : NAN;
+    
+    EV << "Control variates (" << controlVariates->getCount() << " customers, " << estimate.batches << " batches):\n";
+    EV << "  Mean waiting time: " << estimate.plainMean << "s +/- " << estimate.plainHalfWidth << "s\n";
+    EV << "  Adjusted:          " << estimate.mean << "s +/- " << estimate.halfWidth << "s\n";
+    
+    recordScalar("waitingTimeMean", estimate.plainMean);
+    recordScalar("waitingTimeHalfWidth", estimate.plainHalfWidth);
+    recordScalar("waitingTimeCvMean", estimate.mean);
+    recordScalar("waitingTimeCvHalfWidth", estimate.halfWidth);
+    recordScalar("cvVarianceRatio", varianceRatio);
+    recordScalar("cvBatches", estimate.batches);
+    recordScalar("cvCoefficientInterArrival", estimate.coefficients[0]);
+    recordScalar("cvCoefficientItems", estimate.coefficients[1]);
+    recordScalar("cvCoefficientItemTime", estimate.coefficients[2]);
+}
+
+//==============================================================================
+// STORE PARAMETER TABLE (NED function)
+//==============================================================================
+// Per-store parameters for the chain network come from a CSV table with a
+// header row of column names and one row per store. Each file is parsed only
+// once, so looking up the parameters of thousands of stores stays cheap. The
+// cache is shared by runs on parallel threads (tools/replicate) and locked;
+// a parsed table is never changed.
+class StoreTable
+{
+  private:
+    std::map<std::string, int> columns;
+    std::vector<std::vector<double>> rows;
+    
+  public:
+    static const StoreTable& get(const std::string& fileName);
+    double lookup(int row, const std::string& column) const;
+    
+  private:
+    explicit StoreTable(const std::string& fileName);
+};
+
+const StoreTable& StoreTable::get(const std::string& fileName)
+{
+    static std::mutex mutex;
+    static std::map<std::string, StoreTable*> tables;
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = tables.find(fileName);
+    if (it == tables.end())
+        it = tables.emplace(fileName, new StoreTable(fileName)).first;
+    return *it->second;
+}
+
+StoreTable::StoreTable(const std::string& fileName)
+{
+    std::ifstream file(fileName);
+    if (!file)
+        throw cRuntimeError("Cannot open store table '%s'", fileName.c_str());
+    
+    std::string line;
+    bool haveHeader = false;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        
+        std::stringstream fields(line);
+        std::string field;
+        if (!haveHeader) {
+            for (int i = 0; std::getline(fields, field, ','); i++) {
+                field.erase(0, field.find_first_not_of(" \t\r"));
+                field.erase(field.find_last_not_of(" \t\r") + 1);
+                columns[field] = i;
+            }
+            haveHeader = true;
+            continue;
+        }
+        
+        std::vector<double> row;
+        while (std::getline(fields, field, ','))
+            row.push_back(atof(field.c_str()));
+        if (row.size() != columns.size())
+            throw cRuntimeError("Store table '%s': row %d has %d fields, expected %d",
+                    fileName.c_str(), (int)rows.size(), (int)row.size(), (int)columns.size());
+        rows.push_back(row);
+    }
+}
+
+double StoreTable::lookup(int row, const std::string& column) const
+{
+    auto it = columns.find(column);
+    if (it == columns.end())
+        throw cRuntimeError("Store table has no column '%s'", column.c_str());
+    if (row < 0 || row >= (int)rows.size())
+        throw cRuntimeError("Store table has no row %d (%d stores defined)", row, (int)rows.size());
+    return rows[row][it->second];
+}
+
+static cValue storeParam(cComponent *context, cValue argv[], int argc)
+{
+    const StoreTable& table = StoreTable::get(argv[0].stdstringValue());
+    return table.lookup((int)argv[1].intValue(), argv[2].stdstringValue());
+}
+
+Define_NED_Function(storeParam, "double storeParam(string table, int row, string column)");
+
+//==============================================================================
+// CHAIN STATISTICS CLASS
+//==============================================================================
+class ChainStatistics : public cSimpleModule
+{
+  protected:
+    virtual void finish() override;
+};
+
+Define_Module(ChainStatistics);
+
+void ChainStatistics::finish()
+{
+    // Single pass over all stores, reading the live counters of their
+    // modules (independent of the order in which finish() is called)
+    long totalGenerated = 0;
+    long totalBlocked = 0;
+    long totalServed = 0;
+    long totalCashiers = 0;
+    double totalWaiting = 0;
+    double totalService = 0;
+    double sumStoreWait = 0;
+    double sumStoreWaitSquared = 0;
+    double worstStoreWait = 0;
+    int worstStore = -1;
+    int numStores = 0;
+    
+    cModule *firstStore = getParentModule()->getSubmodule("store", 0);
+    int storeCount = firstStore ? firstStore->getVectorSize() : 0;
+    
+    for (int s = 0; s < storeCount; s++) {
+        cModule *store = getParentModule()->getSubmodule("store", s);
+        Shop *shop = check_and_cast<Shop*>(store->getSubmodule("shop"));
+        totalGenerated += shop->getCustomersGenerated();
+        totalBlocked += shop->getCustomersBlocked();
+        
+        long storeServed = 0;
+        double storeWaiting = 0;
+        int numCashiers = store->par("numCashiers").intValue();
+        for (int i = 0; i < numCashiers; i++) {
+            Cashier *cashier = check_and_cast<Cashier*>(store->getSubmodule("cashier", i));
+            storeServed += cashier->getCustomersServed();
+            storeWaiting += cashier->getTotalWaitingTime();
+            totalService += cashier->getTotalServiceTime();
+        }
+        totalServed += storeServed;
+        totalWaiting += storeWaiting;
+        totalCashiers += numCashiers;
+        
+        double storeWait = storeServed > 0 ? storeWaiting / storeServed : 0;
+        sumStoreWait += storeWait;
+        sumStoreWaitSquared += storeWait * storeWait;
+        if (worstStore < 0 || storeWait > worstStoreWait) {
+            worstStoreWait = storeWait;
+            worstStore = s;
+        }
+        numStores++;
+    }
+    
+    double simulationTime = SIMTIME_DBL(simTime());
+    double meanWaitingTime = totalServed > 0 ? totalWaiting / totalServed : 0;
+    double meanStoreWait = numStores > 0 ? sumStoreWait / numStores : 0;
+    double storeWaitStddev = numStores > 1 ? sqrt(std::max(0.0, (sumStoreWaitSquared - numStores * meanStoreWait * meanStoreWait) / (numStores - 1))) : 0;
+    double utilizationRate = simulationTime > 0 && totalCashiers > 0 ? totalService / (simulationTime * totalCashiers) * 100 : 0;
+    double blockingProbability = totalGenerated > 0 ? (double)totalBlocked / totalGenerated : 0;
+    
+    EV << "Chain Statistics:\n";
+    EV << "  Stores: " << numStores << " (" << totalCashiers << " cashiers)\n";
+    EV << "  Customers generated: " << totalGenerated << "\n";
+    EV << "  Customers served: " << totalServed << "\n";
+    EV << "  Mean waiting time: " << meanWaitingTime << "s\n";
+    EV << "  Worst store: " << worstStore << " (mean wait " << worstStoreWait << "s)\n";
+    EV << "  Cashier utilization: " << utilizationRate << "%\n";
+    
+    recordScalar("stores", numStores);
+    recordScalar("cashiers", totalCashiers);
+    recordScalar("customersGenerated", totalGenerated);
+    recordScalar("customersServed", totalServed);
+    recordScalar("blockingProbability", blockingProbability);
+    recordScalar("meanWaitingTime", meanWaitingTime);
+    recordScalar("storeWaitingTimeStddev", storeWaitStddev);
+    recordScalar("worstStoreWaitingTime", worstStoreWait);
+    recordScalar("worstStore", worstStore);
+    recordScalar("utilizationRate", utilizationRate);
+}
+
+//==============================================================================
+// STEPPED STORE CLASS (time-stepped fast mode)
+//==============================================================================
+// A whole store without per-customer events: one timer per time step,
+// bulk Poisson arrivals routed as a batch, all lanes drained at once (see
+// SteppedEngine.h). Records the store-wide statistics of the event-driven
+// model under the same names.
+class SteppedStore : public cSimpleModule
+{
+  private:
+    // Random numbers from the module's RNG
+    struct ModuleRng {
+        cSimpleModule *module;
+        double uniform01() { return module->uniform(0, 1); }
+    };
+    
+    ModuleRng rng;
+    SteppedEngine<ModuleRng> *engine;
+    cMessage *stepTimer;
+    simtime_t timeStep;
+    int numCashiers;
+    
+    simsignal_t waitingTimeSignal;
+    simsignal_t serviceTimeSignal;
+    
+  public:
+    SteppedStore() : engine(nullptr), stepTimer(nullptr) {}
+    virtual ~SteppedStore();
+    
+  protected:
+    virtual void initialize() override;
+    virtual void handleMessage(cMessage *msg) override;
+    virtual void finish() override;
+};
+
+Define_Module(SteppedStore);
+
+SteppedStore::~SteppedStore()
+{
+    delete engine;
+}
+
+void SteppedStore::initialize()
+{
+    SteppedConfig config;
+    config.numCashiers = numCashiers = par("numCashiers").intValue();
+    config.arrivalInterval = par("arrivalInterval").doubleValue();
+    config.strategy = par("strategy").intValue();
+    config.speedFactor = par("speedFactor").doubleValue();
+    config.timeStep = par("timeStep").doubleValue();
+    if (config.numCashiers < 1 || config.timeStep <= 0 || config.strategy < 0 || config.strategy > 2)
+        throw cRuntimeError("SteppedStore needs numCashiers >= 1, timeStep > 0 and strategy 0..2");
+    timeStep = config.timeStep;
+    
+    rng.module = this;
+    engine = new SteppedEngine<ModuleRng>(config, rng);
+    
+    waitingTimeSignal = registerSignal("waitingTime");
+    serviceTimeSignal = registerSignal("serviceTime");
+    
+    // A step is executed at its end, once all of its arrivals lie in the past
+    stepTimer = new cMessage("step");
+    scheduleAt(simTime() + timeStep, stepTimer);
+    
+    EV << "Stepped store initialized with " << numCashiers << " cashiers, time step " << timeStep << "s\n";
+}
+
+void SteppedStore::handleMessage(cMessage *msg)
+{
+    engine->step([this](int, double waitingTime, double serviceTime) {
+        emit(waitingTimeSignal, waitingTime);
+        emit(serviceTimeSignal, serviceTime);
+    });
+    scheduleAt(simTime() + timeStep, stepTimer);
+}
+
+void SteppedStore::finish()
+{
+    // Statistics up to the last complete step
+    const SteppedEngine<ModuleRng>::Statistics& statistics = engine->getStatistics();
+    double time = engine->getTime();
+    double meanWaitingTime = statistics.arrivals > 0 ? statistics.waitSum / statistics.arrivals : 0;
+    double utilizationRate = time > 0 ? statistics.serviceSum / (time * numCashiers) * 100 : 0;
+    double queueLengthTimeAvg = time > 0 ? statistics.waitingCustomerTime / (time * numCashiers) : 0;
+    
+    EV << "Stepped Store Statistics:\n";
+    EV << "  Steps: " << statistics.steps << "\n";
+    EV << "  Customers generated: " << statistics.arrivals << "\n";
+    EV << "  Customers served: " << statistics.served << "\n";
+    EV << "  Mean waiting time: " << meanWaitingTime << "s\n";
+    EV << "  Cashier utilization: " << utilizationRate << "%\n";
+    
+    recordScalar("steps", statistics.steps);
+    recordScalar("customersGenerated", statistics.arrivals);
+    recordScalar("customersServed", statistics.served);
+    recordScalar("meanWaitingTime", meanWaitingTime);
+    recordScalar("utilizationRate", utilizationRate);
+    recordScalar("queueLengthTimeAvg", queueLengthTimeAvg);
+    
+    cancelAndDelete(stepTimer);
+    stepTimer = nullptr;
+}
+
+//==============================================================================
+// HDR HISTOGRAM RESULT RECORDER
+//==============================================================================
+Register_PerRunConfigOption(CFGID_HDR_SIGNIFICANT_DIGITS, "hdr-significant-digits", CFG_INT, "2", "Significant decimal digits kept by the hdrHistogram result recorder (1..5)");
+Register_PerRunConfigOption(CFGID_HDR_LOWEST_VALUE, "hdr-lowest-value", CFG_DOUBLE, "0.001", "Resolution of the hdrHistogram result recorder, in the unit of the statistic");
+Register_PerRunConfigOption(CFGID_HDR_HIGHEST_VALUE, "hdr-highest-value", CFG_DOUBLE, "86400", "Highest value tracked by the hdrHistogram result recorder; larger values are counted at the top");
+Register_PerRunConfigOption(CFGID_HDR_HISTOGRAM_FILE, "hdr-histogram-file", CFG_FILENAME, nullptr, "If set, hdrHistogram recorders also write their histograms to this file; every run truncates it, so use ${runnumber} to keep one file per run. Merge them with tools/hdrmerge");
+
+// Fixed-memory log-linear histogram with quantile scalars, see LogHistogram.h
+class HdrHistogramRecorder : public cNumericResultRecorder
+{
+  private:
+    LogHistogram *histogram = nullptr;
+    
+  public:
+    virtual ~HdrHistogramRecorder() { delete histogram; }
+    
+  protected:
+    virtual void collect(simtime_t_cref t, double value, cObject *details) override;
+    virtual void finish(cResultFilter *prev) override;
+};
+
+Register_ResultRecorder("hdrHistogram", HdrHistogramRecorder);
+
+void HdrHistogramRecorder::collect(simtime_t_cref t, double value, cObject *details)
+{
+    if (!histogram) {
+        cConfiguration *config = getEnvir()->getConfig();
+        histogram = new LogHistogram(config->getAsDouble(CFGID_HDR_LOWEST_VALUE),
+                                     config->getAsDouble(CFGID_HDR_HIGHEST_VALUE),
+                                     config->getAsInt(CFGID_HDR_SIGNIFICANT_DIGITS));
+    }
+    histogram->record(value);
+}
+
+void HdrHistogramRecorder::finish(cResultFilter *prev)
+{
+    if (!histogram)
+        return;
+    
+    opp_string_map attributes = getStatisticAttributes();
+    const struct { const char *suffix; double q; } quantiles[] = {
+        {"p50", 0.5}, {"p90", 0.9}, {"p95", 0.95}, {"p99", 0.99}, {"p99.9", 0.999}
+    };
+    for (const auto& quantile : quantiles) {
+        std::string name = std::string(getStatisticName()) + ":" + quantile.suffix;
+        getEnvir()->recordScalar(getComponent(), name.c_str(), histogram->quantile(quantile.q), &attributes);
+    }
+    
+    // Optional binary output for merging across cashiers and runs; each
+    // run starts its file afresh, so a file name without ${runnumber}
+    // holds the last run of the process rather than a silent mix of runs
+    std::string fileName = getEnvir()->getConfig()->getAsFilename(CFGID_HDR_HISTOGRAM_FILE);
+    if (!fileName.empty()) {
+        static std::mutex mutex;  // runs on parallel threads may share a file
+        static std::map<std::string, std::string> fileRuns;  // file name -> run that started it
+        std::lock_guard<std::mutex> lock(mutex);
+        std::string runId = getEnvir()->getConfigEx()->getVariable("runid");
+        std::string& startedBy = fileRuns[fileName];
+        bool first = startedBy != runId;
+        startedBy = runId;
+        std::ofstream out(fileName, std::ios::binary | (first ? std::ios::trunc : std::ios::app));
+        writeLogHistogramRecord(out, getComponent()->getFullPath(), getStatisticName(), *histogram);
+        if (!out)
+            throw cRuntimeError("Cannot write histogram file '%s'", fileName.c_str());
+    }
+}
+
+//==============================================================================
+// BATCH MEANS RESULT RECORDER
+//==============================================================================
+Register_PerRunConfigOption(CFGID_BATCH_MEANS_CONFIDENCE, "batch-means-confidence", CFG_DOUBLE, "0.95", "Confidence level of the half-widths recorded by the batchMeans result recorder");
+Register_PerRunConfigOption(CFGID_BATCH_MEANS_MIN_BATCHES, "batch-means-min-batches", CFG_INT, "10", "Fewest batches the batchMeans result recorder may merge down to while searching for uncorrelated batch means");
+
+// Mean with an autocorrelation-aware confidence interval, see BatchMeans.h
+class BatchMeansRecorder : public cNumericResultRecorder
+{
+  private:
+    BatchMeans batchMeans;
+    
+  protected:
+    virtual void collect(simtime_t_cref t, double value, cObject *details) override;
+    virtual void finish(cResultFilter *prev) override;
+};
+
+Register_ResultRecorder("batchMeans", BatchMeansRecorder);
+
+void BatchMeansRecorder::collect(simtime_t_cref t, double value, cObject *details)
+{
+    batchMeans.record(value);
+}
+
+void BatchMeansRecorder::finish(cResultFilter *prev)
+{
+    cConfiguration *config = getEnvir()->getConfig();
+    BatchMeans::Estimate estimate = batchMeans.estimate(config->getAsDouble(CFGID_BATCH_MEANS_CONFIDENCE),
+                                                        config->getAsInt(CFGID_BATCH_MEANS_MIN_BATCHES));
+    
+    opp_string_map attributes = getStatisticAttributes();
+    std::string prefix = std::string(getStatisticName()) + ":";
+    getEnvir()->recordScalar(getComponent(), (prefix + "bmMean").c_str(), estimate.mean, &attributes);
+    getEnvir()->recordScalar(getComponent(), (prefix + "bmHalfWidth").c_str(), estimate.halfWidth, &attributes);
+    getEnvir()->recordScalar(getComponent(), (prefix + "bmBatches").c_str(), estimate.batches);
+    getEnvir()->recordScalar(getComponent(), (prefix + "bmBatchSize").c_str(), estimate.batchSize);
+    
+    if (!estimate.independent)
+        EV_WARN << getComponent()->getFullPath() << " " << getStatisticName()
+                << ": batch means still correlated (lag-1 " << estimate.lag1 << "), run longer for a reliable half-width\n";
+}
+
+//==============================================================================
+// ANTITHETIC RANDOM NUMBER GENERATOR
+//==============================================================================
+// Mersenne Twister that pairs consecutive seed sets antithetically: seed sets
+// 2k and 2k+1 share one underlying stream, the odd one returns the complement
+// of every draw (u -> 1 - u). Select it with rng-class = "AntitheticRNG",
+// seed-set = ${repetition} and an even repeat count; tools/pairmerge averages
+// the pairs. Every distribution of the model consumes exactly one draw per
+// call (intRand(n) is computed from a single draw instead of by rejection),
+// and with alignedServiceDraws a service always draws MAX_ITEMS item times.
+// Each module still has to draw from a stream of its own: modules sharing
+// one stream interleave their draws in an order that differs between the
+// runs of a pair.
+class AntitheticRNG : public cMersenneTwister
+{
+  private:
+    bool complement;
+    
+  public:
+    AntitheticRNG() : complement(false) {}
+    
+    virtual void initialize(int seedSet, int rngId, int numRngs, int parsimProcId, int parsimNumPartitions, cConfiguration *cfg) override;
+    virtual void selfTest() override;
+    virtual uint32_t intRand() override;
+    virtual uint32_t intRand(uint32_t n) override;
+    virtual double doubleRand() override;
+    virtual double doubleRandNonz() override;
+    virtual double doubleRandIncl1() override;
+};
+
+Register_Class(AntitheticRNG);
+
+void AntitheticRNG::initialize(int seedSet, int rngId, int numRngs, int parsimProcId, int parsimNumPartitions, cConfiguration *cfg)
+{
+    complement = seedSet % 2 != 0;
+    cMersenneTwister::initialize(seedSet / 2, rngId, numRngs, parsimProcId, parsimNumPartitions, cfg);
+}
+
+void AntitheticRNG::selfTest()
+{
+    // The reference sequence of the self test only holds for the plain stream
+    if (!complement)
+        cMersenneTwister::selfTest();
+}
+
+uint32_t AntitheticRNG::intRand()
+{
+    uint32_t value = cMersenneTwister::intRand();
+    return complement ? intRandMax() - value : value;
+}
+
+uint32_t AntitheticRNG::intRand(uint32_t n)
+{
+    // One draw: k in one run, n-1-k in the other (except at bucket edges)
+    uint32_t value = (uint32_t)(doubleRand() * n);
+    return value < n ? value : n - 1;
+}
+
+double AntitheticRNG::doubleRand()
+{
+    return intRand() * (1.0 / 4294967296.0);  // [0,1), complement is 1 - u - 2^-32
+}
+
+double AntitheticRNG::doubleRandNonz()
+{
+    return (intRand() + 0.5) * (1.0 / 4294967296.0);  // (0,1), complement is exactly 1 - u
+}
+
+double AntitheticRNG::doubleRandIncl1()
+{
+    return intRand() * (1.0 / 4294967295.0);  // [0,1], complement is exactly 1 - u
+}
@@ -0,0 +1,198 @@
+//
+// Parameter specs and design/result tables shared by the experiment tools
+//
+// A table file has one "#param spec" line per parameter, a header line with
+// the column names (parameters first, then responses) and comma-separated
+// rows. A spec is name=low:high (real), name=low:high:int (integer) or
+// name=a,b,c (categorical); low and high may carry a unit
+// (arrivalInterval=4s:20s). Names are ini keys such as *.shop.arrivalInterval.
+//
+
+#ifndef __SUPERMARKET_DESIGNTABLE_H
+#define __SUPERMARKET_DESIGNTABLE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "StoreReplica.h"
+
+struct Parameter
+{
+    enum Kind { REAL, INTEGER, CATEGORICAL };
+    std::string spec;
+    std::string name;
+    Kind kind;
+    double low, high;
+    std::string unit;
+    std::vector<std::string> levels;
+
+    static Parameter parse(const std::string& spec);
+
+    // Surrogate input: [0,1] for numbers, the level index for categories
+    double encode(const std::string& value) const;
+    // Value for the unit cube coordinate u in [0,1)
+    std::string decode(double u) const;
+    bool matches(const std::string& key) const;
+};
+
+inline Parameter Parameter::parse(const std::string& spec)
+{
+    Parameter p;
+    p.spec = spec;
+    size_t eq = spec.find('=');
+    if (eq == std::string::npos || eq == 0)
+        throw std::runtime_error("bad parameter spec " + spec);
+    p.name = spec.substr(0, eq);
+    std::string range = spec.substr(eq + 1);
+
+    if (range.find(',') != std::string::npos) {
+        p.kind = CATEGORICAL;
+        std::stringstream in(range);
+        std::string level;
+        while (std::getline(in, level, ','))
+            p.levels.push_back(level);
+        p.low = 0;
+        p.high = p.levels.size() - 1;
+        return p;
+    }
+
+    std::vector<std::string> parts;
+    std::stringstream in(range);
+    std::string part;
+    while (std::getline(in, part, ':'))
+        parts.push_back(part);
+    if (parts.size() < 2 || parts.size() > 3 || (parts.size() == 3 && parts[2] != "int"))
+        throw std::runtime_error("bad parameter spec " + spec);
+    char *end;
+    p.low = strtod(parts[0].c_str(), &end);
+    p.unit = end;
+    p.high = strtod(parts[1].c_str(), nullptr);
+    p.kind = parts.size() == 3 ? INTEGER : REAL;
+    if (!(p.high > p.low))
+        throw std::runtime_error("empty range in " + spec);
+    return p;
+}
+
+inline double Parameter::encode(const std::string& value) const
+{
+    if (kind == CATEGORICAL) {
+        for (size_t i = 0; i < levels.size(); i++)
+            if (levels[i] == value)
+                return i;
+        throw std::runtime_error("unknown level " + value + " of " + name);
+    }
+    return (strtod(value.c_str(), nullptr) - low) / (high - low);
+}
+
+inline std::string Parameter::decode(double u) const
+{
+    char buffer[64];
+    if (kind == CATEGORICAL)
+        return levels[std::min((size_t)(u * levels.size()), levels.size() - 1)];
+    if (kind == INTEGER) {
+        long value = (long)std::floor(low + u * (high - low + 1));
+        snprintf(buffer, sizeof(buffer), "%ld%s", std::min(value, (long)high), unit.c_str());
+    }
+    else
+        snprintf(buffer, sizeof(buffer), "%.6g%s", low + u * (high - low), unit.c_str());
+    return buffer;
+}
+
+// Full name or its last path component (arrivalInterval for *.shop.arrivalInterval)
+inline bool Parameter::matches(const std::string& key) const
+{
+    size_t dot = name.rfind('.');
+    return key == name || (dot != std::string::npos && key == name.substr(dot + 1));
+}
+
+struct Table
+{
+    std::vector<Parameter> parameters;
+    std::vector<std::string> columns;  // parameters first, then responses
+    std::vector<std::vector<std::string>> rows;
+
+    void read(const std::string& fileName);
+    void write(std::ostream& out) const;
+};
+
+inline void Table::read(const std::string& fileName)
+{
+    std::ifstream in(fileName);
+    if (!in)
+        throw std::runtime_error("cannot open " + fileName);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty())
+            continue;
+        if (line.compare(0, 7, "#param ") == 0) {
+            parameters.push_back(Parameter::parse(line.substr(7)));
+            continue;
+        }
+        std::vector<std::string> fields;
+        std::stringstream fieldStream(line);
+        std::string field;
+        while (std::getline(fieldStream, field, ','))
+            fields.push_back(field);
+        if (columns.empty())
+            columns = fields;
+        else if (fields.size() == columns.size())
+            rows.push_back(fields);
+    }
+    if (parameters.empty() || columns.size() < parameters.size())
+        throw std::runtime_error(fileName + ": no design");
+}
+
+inline void Table::write(std::ostream& out) const
+{
+    for (const Parameter& p : parameters)
+        out << "#param " << p.spec << "\n";
+    for (size_t i = 0; i < columns.size(); i++)
+        out << (i ? "," : "") << columns[i];
+    out << "\n";
+    for (const auto& row : rows) {
+        for (size_t i = 0; i < row.size(); i++)
+            out << (i ? "," : "") << row[i];
+        out << "\n";
+    }
+}
+
+inline std::vector<std::string> splitList(const std::string& text)
+{
+    std::vector<std::string> items;
+    std::stringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ','))
+        items.push_back(item);
+    return items;
+}
+
+// Store replica for one row; the parameters are matched by their last name
+// component (arrivalInterval, numCashiers, strategy, speedFactor)
+inline ReplicaConfig replicaConfig(const std::vector<Parameter>& parameters, const std::vector<std::string>& row)
+{
+    ReplicaConfig config;
+    for (size_t k = 0; k < parameters.size(); k++) {
+        const Parameter& p = parameters[k];
+        double value = strtod(row[k].c_str(), nullptr);
+        if (p.matches("arrivalInterval"))
+            config.arrivalInterval = value;
+        else if (p.matches("numCashiers"))
+            config.numCashiers = (int)value;
+        else if (p.matches("strategy"))
+            config.strategy = (int)value;
+        else if (p.matches("speedFactor"))
+            config.speedFactor = value;
+        else
+            throw std::runtime_error("replica has no parameter " + p.name + ", use -x");
+    }
+    return config;
+}
+
+#endif
@@ -0,0 +1,356 @@
+//
+// Gaussian process regression surrogate for the design-of-experiments tool
+//
+// Inputs are scaled to [0,1] for continuous parameters; categorical
+// parameters are given as level indices. The correlation is a product of a
+// squared exponential per continuous input, exp(-((x - x') / l)^2), and an
+// exchangeable term per categorical input, exp(-theta * [c != c']). The
+// response is centered, the signal variance is profiled out, and the length
+// scales, thetas and the nugget (noise-to-signal ratio) maximize the profile
+// likelihood (Nelder-Mead from a few starts). Prediction needs one
+// correlation vector and one triangular solve: microseconds for a few
+// hundred design points.
+//
+
+#ifndef __SUPERMARKET_GAUSSIANPROCESS_H
+#define __SUPERMARKET_GAUSSIANPROCESS_H
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Minimizes f by Nelder-Mead from the given start with the given step size
+inline std::vector<double> nelderMead(const std::function<double(const std::vector<double>&)>& f,
+                                      std::vector<double> start, double step, int maxEvaluations)
+{
+    size_t n = start.size();
+    std::vector<std::vector<double>> simplex(n + 1, start);
+    std::vector<double> values(n + 1);
+    for (size_t i = 0; i < n; i++)
+        simplex[i + 1][i] += step;
+    for (size_t i = 0; i <= n; i++)
+        values[i] = f(simplex[i]);
+    int evaluations = (int)n + 1;
+
+    while (evaluations < maxEvaluations) {
+        std::vector<size_t> order(n + 1);
+        for (size_t i = 0; i <= n; i++)
+            order[i] = i;
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return values[a] < values[b]; });
+        size_t best = order[0], worst = order[n], secondWorst = order[n - 1];
+        if (std::fabs(values[worst] - values[best]) < 1e-9 * (1 + std::fabs(values[best])))
+            break;
+
+        std::vector<double> centroid(n, 0.0);
+        for (size_t i = 0; i <= n; i++)
+            if (i != worst)
+                for (size_t k = 0; k < n; k++)
+                    centroid[k] += simplex[i][k] / n;
+        auto along = [&](double t) {
+            std::vector<double> point(n);
+            for (size_t k = 0; k < n; k++)
+                point[k] = centroid[k] + t * (simplex[worst][k] - centroid[k]);
+            return point;
+        };
+
+        std::vector<double> reflected = along(-1);
+        double reflectedValue = f(reflected);
+        evaluations++;
+        if (reflectedValue < values[best]) {
+            std::vector<double> expanded = along(-2);
+            double expandedValue = f(expanded);
+            evaluations++;
+            if (expandedValue < reflectedValue) {
+                simplex[worst] = expanded;
+                values[worst] = expandedValue;
+            } else {
+                simplex[worst] = reflected;
+                values[worst] = reflectedValue;
+            }
+        } else if (reflectedValue < values[secondWorst]) {
+            simplex[worst] = reflected;
+            values[worst] = reflectedValue;
+        } else {
+            std::vector<double> contracted = along(0.5);
+            double contractedValue = f(contracted);
+            evaluations++;
+            if (contractedValue < values[worst]) {
+                simplex[worst] = contracted;
+                values[worst] = contractedValue;
+            } else {
+                // Shrink towards the best point
+                for (size_t i = 0; i <= n; i++) {
+                    if (i == best)
+                        continue;
+                    for (size_t k = 0; k < n; k++)
+                        simplex[i][k] = simplex[best][k] + 0.5 * (simplex[i][k] - simplex[best][k]);
+                    values[i] = f(simplex[i]);
+                    evaluations++;
+                }
+            }
+        }
+    }
+    return simplex[std::min_element(values.begin(), values.end()) - values.begin()];
+}
+
+class GaussianProcess
+{
+  private:
+    std::vector<bool> categorical;
+    std::vector<double> scales;  // length scale (continuous) or theta (categorical)
+    double nugget;
+    double signalVariance;
+    double responseMean;
+    std::vector<std::vector<double>> x;
+    std::vector<double> alpha;               // R^-1 (y - mean)
+    std::vector<std::vector<double>> chol;   // lower Cholesky factor of R
+    double looRmse;
+
+  public:
+    GaussianProcess() : nugget(1e-6), signalVariance(1), responseMean(0), looRmse(0) {}
+
+    void fit(const std::vector<std::vector<double>>& inputs, const std::vector<double>& responses,
+             const std::vector<bool>& isCategorical);
+    void predict(const std::vector<double>& input, double& mean, double& variance) const;
+    double getLooRmse() const { return looRmse; }
+    double getNugget() const { return nugget; }
+    const std::vector<double>& getScales() const { return scales; }
+    size_t getNumInputs() const { return categorical.size(); }
+
+    void save(std::ostream& out) const;
+    void load(std::istream& in);
+
+  private:
+    double correlation(const std::vector<double>& a, const std::vector<double>& b) const {
+        double exponent = 0;
+        for (size_t k = 0; k < a.size(); k++) {
+            if (categorical[k]) {
+                if (a[k] != b[k])
+                    exponent += scales[k];
+            } else {
+                double d = (a[k] - b[k]) / scales[k];
+                exponent += d * d;
+            }
+        }
+        return std::exp(-exponent);
+    }
+    static bool cholesky(std::vector<std::vector<double>>& a);
+    std::vector<double> solveLower(const std::vector<double>& b) const;
+    std::vector<double> solveUpper(const std::vector<double>& b) const;
+    double negativeProfileLikelihood(const std::vector<double>& y);
+    void factorize(const std::vector<double>& y);
+};
+
+inline bool GaussianProcess::cholesky(std::vector<std::vector<double>>& a)
+{
+    size_t n = a.size();
+    for (size_t j = 0; j < n; j++) {
+        double diagonal = a[j][j];
+        for (size_t k = 0; k < j; k++)
+            diagonal -= a[j][k] * a[j][k];
+        if (diagonal <= 0)
+            return false;
+        a[j][j] = std::sqrt(diagonal);
+        for (size_t i = j + 1; i < n; i++) {
+            double sum = a[i][j];
+            for (size_t k = 0; k < j; k++)
+                sum -= a[i][k] * a[j][k];
+            a[i][j] = sum / a[j][j];
+        }
+        for (size_t k = j + 1; k < n; k++)
+            a[j][k] = 0;
+    }
+    return true;
+}
+
+inline std::vector<double> GaussianProcess::solveLower(const std::vector<double>& b) const
+{
+    size_t n = b.size();
+    std::vector<double> z(n);
+    for (size_t i = 0; i < n; i++) {
+        double sum = b[i];
+        for (size_t k = 0; k < i; k++)
+            sum -= chol[i][k] * z[k];
+        z[i] = sum / chol[i][i];
+    }
+    return z;
+}
+
+inline std::vector<double> GaussianProcess::solveUpper(const std::vector<double>& b) const
+{
+    size_t n = b.size();
+    std::vector<double> z(n);
+    for (size_t i = n; i-- > 0; ) {
+        double sum = b[i];
+        for (size_t k = i + 1; k < n; k++)
+            sum -= chol[k][i] * z[k];
+        z[i] = sum / chol[i][i];
+    }
+    return z;
+}
+
+// Builds and factorizes R for the current hyperparameters; sets alpha and the
+// profiled signal variance
+inline void GaussianProcess::factorize(const std::vector<double>& y)
+{
+    size_t n = x.size();
+    chol.assign(n, std::vector<double>(n, 0.0));
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < i; j++)
+            chol[i][j] = chol[j][i] = correlation(x[i], x[j]);
+        chol[i][i] = 1 + nugget;
+    }
+    if (!cholesky(chol))
+        throw std::runtime_error("GaussianProcess: correlation matrix not positive definite");
+    alpha = solveUpper(solveLower(y));
+    double quadratic = 0;
+    for (size_t i = 0; i < n; i++)
+        quadratic += y[i] * alpha[i];
+    signalVariance = std::max(quadratic / n, 1e-300);
+}
+
+inline double GaussianProcess::negativeProfileLikelihood(const std::vector<double>& y)
+{
+    try {
+        factorize(y);
+    }
+    catch (std::runtime_error&) {
+        return std::numeric_limits<double>::infinity();
+    }
+    double logDeterminant = 0;
+    for (size_t i = 0; i < x.size(); i++)
+        logDeterminant += 2 * std::log(chol[i][i]);
+    return 0.5 * x.size() * std::log(signalVariance) + 0.5 * logDeterminant;
+}
+
+inline void GaussianProcess::fit(const std::vector<std::vector<double>>& inputs, const std::vector<double>& responses,
+                                 const std::vector<bool>& isCategorical)
+{
+    size_t n = inputs.size(), d = isCategorical.size();
+    if (n < 2 || responses.size() != n)
+        throw std::invalid_argument("GaussianProcess: need at least two design points");
+    x = inputs;
+    categorical = isCategorical;
+    responseMean = 0;
+    for (double r : responses)
+        responseMean += r / n;
+    std::vector<double> y(n);
+    for (size_t i = 0; i < n; i++)
+        y[i] = responses[i] - responseMean;
+
+    // Parameters: log scales, then log nugget
+    auto apply = [&](const std::vector<double>& p) {
+        scales.resize(d);
+        for (size_t k = 0; k < d; k++)
+            scales[k] = std::exp(std::min(std::max(p[k], -6.0), 6.0));
+        nugget = std::exp(std::min(std::max(p[d], -16.0), 2.0));
+    };
+    auto objective = [&](const std::vector<double>& p) {
+        apply(p);
+        return negativeProfileLikelihood(y);
+    };
+
+    std::vector<double> best;
+    double bestValue = std::numeric_limits<double>::infinity();
+    for (double start : {std::log(0.2), std::log(0.5), std::log(1.5)}) {
+        std::vector<double> p(d + 1, start);
+        for (size_t k = 0; k < d; k++)
+            if (categorical[k])
+                p[k] = std::log(1.0);
+        p[d] = std::log(1e-3);
+        std::vector<double> candidate = nelderMead(objective, p, 1.0, 400 * (int)(d + 1));
+        double value = objective(candidate);
+        if (value < bestValue) {
+            bestValue = value;
+            best = candidate;
+        }
+    }
+    if (!std::isfinite(bestValue))
+        throw std::runtime_error("GaussianProcess: fit failed");
+    apply(best);
+    factorize(y);
+
+    // Closed-form leave-one-out residuals: alpha_i / (R^-1)_ii
+    double squares = 0;
+    for (size_t i = 0; i < n; i++) {
+        std::vector<double> unit(n, 0.0);
+        unit[i] = 1;
+        std::vector<double> column = solveLower(unit);
+        double inverseDiagonal = 0;
+        for (double c : column)
+            inverseDiagonal += c * c;
+        double residual = alpha[i] / inverseDiagonal;
+        squares += residual * residual;
+    }
+    looRmse = std::sqrt(squares / n);
+}
+
+inline void GaussianProcess::predict(const std::vector<double>& input, double& mean, double& variance) const
+{
+    size_t n = x.size();
+    std::vector<double> r(n);
+    mean = responseMean;
+    for (size_t i = 0; i < n; i++) {
+        r[i] = correlation(input, x[i]);
+        mean += r[i] * alpha[i];
+    }
+    std::vector<double> v = solveLower(r);
+    double explained = 0;
+    for (double c : v)
+        explained += c * c;
+    variance = signalVariance * std::max(0.0, 1 - explained);  // of the mean response, without noise
+}
+
+inline void GaussianProcess::save(std::ostream& out) const
+{
+    out.precision(17);
+    size_t n = x.size(), d = categorical.size();
+    out << "gp " << n << " " << d << " " << nugget << " " << signalVariance << " " << responseMean << " " << looRmse << "\n";
+    for (size_t k = 0; k < d; k++)
+        out << (categorical[k] ? 1 : 0) << " " << scales[k] << "\n";
+    for (size_t i = 0; i < n; i++) {
+        for (size_t k = 0; k < d; k++)
+            out << x[i][k] << " ";
+        out << alpha[i] << "\n";
+    }
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j <= i; j++)
+            out << chol[i][j] << (j == i ? "\n" : " ");
+    }
+}
+
+inline void GaussianProcess::load(std::istream& in)
+{
+    std::string tag;
+    size_t n, d;
+    if (!(in >> tag >> n >> d >> nugget >> signalVariance >> responseMean >> looRmse) || tag != "gp")
+        throw std::runtime_error("GaussianProcess: bad model");
+    categorical.resize(d);
+    scales.resize(d);
+    for (size_t k = 0; k < d; k++) {
+        int flag;
+        in >> flag >> scales[k];
+        categorical[k] = flag != 0;
+    }
+    x.assign(n, std::vector<double>(d));
+    alpha.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        for (size_t k = 0; k < d; k++)
+            in >> x[i][k];
+        in >> alpha[i];
+    }
+    chol.assign(n, std::vector<double>(n, 0.0));
+    for (size_t i = 0; i < n; i++)
+        for (size_t j = 0; j <= i; j++)
+            in >> chol[i][j];
+    if (!in)
+        throw std::runtime_error("GaussianProcess: truncated model");
+}
+
+#endif
@@ -0,0 +1,129 @@
+//
+// Minimal reader for OMNeT++ scalar result files (.sca, text format)
+//
+// Collects per run the run id, the attributes (configname, repetition, ...),
+// the iteration variables and the scalars. Statistics, histograms, parameter
+// lines and the attributes of individual results are skipped.
+//
+
+#ifndef __SUPERMARKET_SCAFILE_H
+#define __SUPERMARKET_SCAFILE_H
+
+#include <cstdlib>
+#include <dirent.h>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+struct ScaRun
+{
+    std::string runId;
+    std::map<std::string, std::string> attributes;
+    std::map<std::string, std::string> iterationVariables;
+    std::map<std::pair<std::string, std::string>, double> scalars;  // (module, name) -> value
+
+    std::string attribute(const std::string& name) const {
+        auto it = attributes.find(name);
+        return it == attributes.end() ? "" : it->second;
+    }
+
+    // Scalar of the given module; an empty module name means the network
+    // (the only module path without a dot)
+    bool findScalar(const std::string& module, const std::string& name, double& value) const {
+        for (const auto& scalar : scalars) {
+            const std::string& path = scalar.first.first;
+            if (scalar.first.second == name && (module.empty() ? path.find('.') == std::string::npos : path == module)) {
+                value = scalar.second;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// Splits a line into fields; double-quoted fields may contain spaces and
+// backslash escapes
+inline std::vector<std::string> splitScaLine(const std::string& line)
+{
+    std::vector<std::string> fields;
+    size_t i = 0;
+    while (i < line.size()) {
+        while (i < line.size() && (line[i] == ' ' || line[i] == '\t'))
+            i++;
+        if (i >= line.size())
+            break;
+        std::string field;
+        if (line[i] == '"') {
+            for (i++; i < line.size() && line[i] != '"'; i++) {
+                if (line[i] == '\\' && i + 1 < line.size())
+                    i++;
+                field += line[i];
+            }
+            i++;
+        } else {
+            while (i < line.size() && line[i] != ' ' && line[i] != '\t')
+                field += line[i++];
+        }
+        fields.push_back(field);
+    }
+    return fields;
+}
+
+inline std::vector<ScaRun> readScaFile(const std::string& fileName)
+{
+    std::ifstream in(fileName);
+    if (!in)
+        throw std::runtime_error("cannot open " + fileName);
+
+    std::vector<ScaRun> runs;
+    bool inRunHeader = false;  // attr lines belong to the run, not to a result
+    std::string line;
+    while (std::getline(in, line)) {
+        std::vector<std::string> fields = splitScaLine(line);
+        if (fields.empty())
+            continue;
+        const std::string& kind = fields[0];
+        if (kind == "run" && fields.size() >= 2) {
+            runs.emplace_back();
+            runs.back().runId = fields[1];
+            inRunHeader = true;
+        }
+        else if (runs.empty())
+            continue;
+        else if (kind == "attr" && fields.size() >= 3) {
+            if (inRunHeader)
+                runs.back().attributes[fields[1]] = fields[2];
+        }
+        else if (kind == "itervar" && fields.size() >= 3)
+            runs.back().iterationVariables[fields[1]] = fields[2];
+        else if (kind == "scalar" && fields.size() >= 4) {
+            runs.back().scalars[{fields[1], fields[2]}] = strtod(fields[3].c_str(), nullptr);
+            inRunHeader = false;
+        }
+        else if (kind == "par" || kind == "statistic" || kind == "vector")
+            inRunHeader = false;
+    }
+    return runs;
+}
+
+// Runs of all .sca files in a directory (e.g. the result directory of one run)
+inline std::vector<ScaRun> readScaDirectory(const std::string& dirName)
+{
+    DIR *dir = opendir(dirName.c_str());
+    if (!dir)
+        throw std::runtime_error("cannot open directory " + dirName);
+    std::vector<ScaRun> runs;
+    while (dirent *entry = readdir(dir)) {
+        std::string file = entry->d_name;
+        if (file.size() > 4 && file.compare(file.size() - 4, 4, ".sca") == 0) {
+            std::vector<ScaRun> fileRuns = readScaFile(dirName + "/" + file);
+            runs.insert(runs.end(), fileRuns.begin(), fileRuns.end());
+        }
+    }
+    closedir(dir);
+    return runs;
+}
+
+#endif
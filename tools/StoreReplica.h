@@ -0,0 +1,201 @@
+//
+// Compact, copyable replica of one store (Shop, Balancer, Cashiers) for the
+// tools that need to copy, branch or step model state outside of the
+// simulation kernel
+//
+// Mirrors the default model: exponential inter-arrival times, 1..25 items,
+// 0.5..2s per item scaled by a speed factor, round robin / shortest queue /
+// random balancing, one FIFO queue per cashier. Service times are drawn on
+// arrival (same distribution as drawing them on service start), so the
+// waiting time of a customer is known as soon as it is routed. The whole
+// state including the random number generator is plain data: copying a
+// replica clones the simulation.
+//
+
+#ifndef __SUPERMARKET_STOREREPLICA_H
+#define __SUPERMARKET_STOREREPLICA_H
+
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// xoshiro256** with splitmix64 seeding: 32 bytes of state, cheap to copy
+class ReplicaRng
+{
+  private:
+    uint64_t s[4];
+
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+  public:
+    explicit ReplicaRng(uint64_t seed = 1) { this->seed(seed); }
+
+    void seed(uint64_t seed) {
+        for (int i = 0; i < 4; i++) {
+            uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            s[i] = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t next() {
+        uint64_t result = rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    double uniform01() { return (next() >> 11) * (1.0 / 9007199254740992.0); }  // [0,1)
+    double uniform(double a, double b) { return a + (b - a) * uniform01(); }
+    int intuniform(int a, int b) { return a + (int)(uniform01() * (b - a + 1)); }
+    double exponential(double mean) { return -mean * std::log(1.0 - uniform01()); }
+};
+
+struct ReplicaConfig
+{
+    int numCashiers = 4;
+    double arrivalInterval = 18;  // s, mean of the exponential inter-arrival time
+    int strategy = 0;             // 0=Round Robin, 1=Shortest Queue, 2=Random
+    double speedFactor = 1.0;
+    int minItems = 1;
+    int maxItems = 25;
+    double minItemTime = 0.5;     // s
+    double maxItemTime = 2.0;     // s
+
+    double meanServiceTime() const {
+        return (minItems + maxItems) / 2.0 * (minItemTime + maxItemTime) / 2.0 * speedFactor;
+    }
+};
+
+class StoreReplica
+{
+  public:
+    enum EventKind { ARRIVAL, DEPARTURE };
+
+    struct Arrival {
+        int cashier;
+        int items;
+        double waitingTime;
+        double serviceTime;
+    };
+
+  private:
+    const ReplicaConfig *config;
+    ReplicaRng rng;
+    double now;
+    double nextArrival;
+    long roundRobinCounter;
+    int customersInSystem;
+    std::vector<std::deque<double>> departures;  // per cashier, FIFO departure times
+
+  public:
+    StoreReplica(const ReplicaConfig& config, uint64_t seed)
+        : config(&config), rng(seed), now(0), roundRobinCounter(0), customersInSystem(0),
+          departures(config.numCashiers)
+    {
+        nextArrival = rng.exponential(config.arrivalInterval);
+    }
+
+    // Digital-twin start (before the first step): a customer in service
+    // at the cashier that leaves after the remaining service time
+    void startInService(int cashier, double remainingService) {
+        departures[cashier].push_back(now + remainingService);
+        customersInSystem++;
+    }
+
+    // Digital-twin start: a customer waiting in line; returns its waiting
+    // time from now on
+    double addWaiting(int cashier, int items) {
+        double serviceTime = 0;
+        for (int i = 0; i < items; i++)
+            serviceTime += rng.uniform(config->minItemTime, config->maxItemTime);
+        serviceTime *= config->speedFactor;
+        std::deque<double>& queue = departures[cashier];
+        double serviceStart = queue.empty() ? now : std::max(now, queue.back());
+        queue.push_back(serviceStart + serviceTime);
+        customersInSystem++;
+        return serviceStart - now;
+    }
+
+    void setNextArrival(double t) { nextArrival = t; }
+    void setRoundRobinCounter(long counter) { roundRobinCounter = counter; }
+
+    double getTime() const { return now; }
+    int getCustomersInSystem() const { return customersInSystem; }
+    int getQueueLength(int cashier) const { return (int)departures[cashier].size(); }
+    long getRoundRobinCounter() const { return roundRobinCounter; }
+    ReplicaRng& getRng() { return rng; }
+
+    double nextEventTime() const {
+        double t = nextArrival;
+        for (const auto& queue : departures)
+            if (!queue.empty() && queue.front() < t)
+                t = queue.front();
+        return t;
+    }
+
+    // Executes the next event; for arrivals, fills in where the customer went
+    EventKind step(Arrival *arrival = nullptr) {
+        int departing = -1;
+        double t = nextArrival;
+        for (int i = 0; i < config->numCashiers; i++) {
+            if (!departures[i].empty() && departures[i].front() < t) {
+                t = departures[i].front();
+                departing = i;
+            }
+        }
+        now = t;
+
+        if (departing >= 0) {
+            departures[departing].pop_front();
+            customersInSystem--;
+            return DEPARTURE;
+        }
+
+        Arrival a;
+        a.cashier = selectCashier();
+        a.items = rng.intuniform(config->minItems, config->maxItems);
+        a.serviceTime = 0;
+        for (int i = 0; i < a.items; i++)
+            a.serviceTime += rng.uniform(config->minItemTime, config->maxItemTime);
+        a.serviceTime *= config->speedFactor;
+
+        std::deque<double>& queue = departures[a.cashier];
+        double serviceStart = queue.empty() ? now : std::max(now, queue.back());
+        a.waitingTime = serviceStart - now;
+        queue.push_back(serviceStart + a.serviceTime);
+        customersInSystem++;
+
+        nextArrival = now + rng.exponential(config->arrivalInterval);
+        if (arrival)
+            *arrival = a;
+        return ARRIVAL;
+    }
+
+  private:
+    int selectCashier() {
+        switch (config->strategy) {
+            case 1: {
+                int best = 0;
+                for (int i = 1; i < config->numCashiers; i++)
+                    if (departures[i].size() < departures[best].size())
+                        best = i;
+                return best;
+            }
+            case 2:
+                return rng.intuniform(0, config->numCashiers - 1);
+            default:
+                return (int)(roundRobinCounter++ % config->numCashiers);
+        }
+    }
+};
+
+#endif
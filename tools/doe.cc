@@ -0,0 +1,478 @@
+//
+// doe - design-of-experiments driver with a Gaussian process surrogate
+//
+//   doe design -n points -p spec [-p spec ...] [-s seed] > design.csv
+//       Maximin Latin hypercube design. A spec is name=low:high (real),
+//       name=low:high:int (integer) or name=a,b,c (categorical); low and high
+//       may carry a unit (arrivalInterval=4s:20s). Names are ini keys such as
+//       *.shop.arrivalInterval.
+//   doe run design.csv [-j jobs] [-x command] [-d dir] [-M module] [-r responses]
+//                      [-T simTime] [-w warmup] [-R replications] > results.csv
+//       Runs all design points on all cores. With -x, the simulation
+//       executable runs once per point, e.g. -x "./supermarket_sim -u Cmdenv -c Default".
+//       Each point gets --name=value options and its own result directory,
+//       and the responses are read from the scalars of module -M (default:
+//       the network). Without -x, the store replica (StoreReplica.h) runs
+//       in-process. Responses default to storeWaitingTime:mean,:p95.
+//   doe fit results.csv > model.txt
+//       Fits one Gaussian process per response and reports leave-one-out errors
+//   doe predict model.txt name=value ...
+//       Surrogate mean, standard deviation and 95% interval per response
+//   doe sobol model.txt [-N samples] [-s seed]
+//       First-order and total Sobol indices of the surrogate mean
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../LogHistogram.h"
+#include "DesignTable.h"
+#include "GaussianProcess.h"
+#include "ScaFile.h"
+#include "StoreReplica.h"
+
+//
+// design
+//
+static int design(int argc, char **argv)
+{
+    Table table;
+    int points = 0;
+    uint64_t seed = 1;
+    for (int i = 0; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            points = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-p") && i + 1 < argc)
+            table.parameters.push_back(Parameter::parse(argv[++i]));
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            seed = strtoull(argv[++i], nullptr, 10);
+        else
+            throw std::runtime_error(std::string("design: unknown option ") + argv[i]);
+    }
+    if (points < 2 || table.parameters.empty())
+        throw std::runtime_error("design: need -n >= 2 and at least one -p");
+
+    // Best of a number of random Latin hypercubes by minimum pairwise distance
+    size_t d = table.parameters.size();
+    ReplicaRng rng(seed);
+    std::vector<std::vector<double>> best;
+    double bestDistance = -1;
+    for (int candidate = 0; candidate < 200; candidate++) {
+        std::vector<std::vector<double>> cube(points, std::vector<double>(d));
+        for (size_t k = 0; k < d; k++) {
+            std::vector<int> strata(points);
+            for (int i = 0; i < points; i++)
+                strata[i] = i;
+            for (int i = points - 1; i > 0; i--)
+                std::swap(strata[i], strata[rng.intuniform(0, i)]);
+            for (int i = 0; i < points; i++)
+                cube[i][k] = (strata[i] + rng.uniform01()) / points;
+        }
+        double minDistance = INFINITY;
+        for (int i = 0; i < points; i++)
+            for (int j = 0; j < i; j++) {
+                double distance = 0;
+                for (size_t k = 0; k < d; k++)
+                    distance += (cube[i][k] - cube[j][k]) * (cube[i][k] - cube[j][k]);
+                minDistance = std::min(minDistance, distance);
+            }
+        if (minDistance > bestDistance) {
+            bestDistance = minDistance;
+            best = cube;
+        }
+    }
+
+    for (const Parameter& p : table.parameters)
+        table.columns.push_back(p.name);
+    for (const auto& point : best) {
+        std::vector<std::string> row;
+        for (size_t k = 0; k < d; k++)
+            row.push_back(table.parameters[k].decode(point[k]));
+        table.rows.push_back(row);
+    }
+    table.write(std::cout);
+    return 0;
+}
+
+//
+// run
+//
+struct RunSettings
+{
+    std::string command;
+    std::string resultDir = "doe-results";
+    std::string module;
+    std::vector<std::string> responses = {"storeWaitingTime:mean", "storeWaitingTime:p95"};
+    double simTime = 100000;
+    double warmup = 1000;
+    int replications = 1;
+};
+
+// In-process replica: mean and quantiles of the waiting time
+static std::vector<double> runReplica(const Table& table, const std::vector<std::string>& row,
+                                      const RunSettings& settings, uint64_t seed)
+{
+    ReplicaConfig config = replicaConfig(table.parameters, row);
+
+    LogHistogram histogram;
+    for (int r = 0; r < settings.replications; r++) {
+        StoreReplica replica(config, seed + r);
+        StoreReplica::Arrival arrival;
+        while (replica.nextEventTime() < settings.simTime)
+            if (replica.step(&arrival) == StoreReplica::ARRIVAL && replica.getTime() >= settings.warmup)
+                histogram.record(arrival.waitingTime);
+    }
+
+    std::vector<double> values;
+    for (const std::string& response : settings.responses) {
+        if (response == "storeWaitingTime:mean")
+            values.push_back(histogram.getMean());
+        else if (response.compare(0, 18, "storeWaitingTime:p") == 0)
+            values.push_back(histogram.quantile(atof(response.c_str() + 18) / 100));
+        else
+            throw std::runtime_error("replica has no response " + response + ", use -x");
+    }
+    return values;
+}
+
+// Simulation executable: one process per point, responses from its scalars
+static std::vector<double> runCommand(const Table& table, const std::vector<std::string>& row,
+                                      const RunSettings& settings, int point)
+{
+    std::string dir = settings.resultDir + "/point" + std::to_string(point);
+    std::string command = settings.command;
+    for (size_t k = 0; k < table.parameters.size(); k++)
+        command += " '--" + table.parameters[k].name + "=" + row[k] + "'";
+    if (settings.replications > 1)
+        command += " --repeat=" + std::to_string(settings.replications);
+    command += " '--result-dir=" + dir + "' > '" + dir + ".log' 2>&1";
+    if (system(("mkdir -p '" + dir + "'").c_str()) != 0 || system(command.c_str()) != 0)
+        throw std::runtime_error("point " + std::to_string(point) + " failed, see " + dir + ".log");
+
+    std::vector<double> sums(settings.responses.size(), 0.0);
+    std::vector<int> counts(settings.responses.size(), 0);
+    for (const ScaRun& run : readScaDirectory(dir)) {
+        for (size_t i = 0; i < settings.responses.size(); i++) {
+            double value;
+            if (run.findScalar(settings.module, settings.responses[i], value)) {
+                sums[i] += value;
+                counts[i]++;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < sums.size(); i++) {
+        if (counts[i] == 0)
+            throw std::runtime_error("point " + std::to_string(point) + ": no scalar " + settings.responses[i]);
+        sums[i] /= counts[i];
+    }
+    return sums;
+}
+
+static int run(int argc, char **argv)
+{
+    if (argc < 1)
+        throw std::runtime_error("run: missing design file");
+    Table table;
+    table.read(argv[0]);
+    RunSettings settings;
+    int jobs = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (i + 1 >= argc)
+            throw std::runtime_error("run: missing value of " + option);
+        std::string value = argv[++i];
+        if (option == "-j") jobs = std::max(1, atoi(value.c_str()));
+        else if (option == "-x") settings.command = value;
+        else if (option == "-d") settings.resultDir = value;
+        else if (option == "-M") settings.module = value;
+        else if (option == "-r") settings.responses = splitList(value);
+        else if (option == "-T") settings.simTime = atof(value.c_str());
+        else if (option == "-w") settings.warmup = atof(value.c_str());
+        else if (option == "-R") settings.replications = std::max(1, atoi(value.c_str()));
+        else throw std::runtime_error("run: unknown option " + option);
+    }
+
+    size_t d = table.parameters.size();
+    std::vector<std::vector<double>> results(table.rows.size());
+    std::atomic<size_t> next(0);
+    std::mutex errorMutex;
+    std::string error;
+    auto worker = [&]() {
+        for (size_t i; (i = next++) < table.rows.size(); ) {
+            try {
+                std::vector<std::string> row(table.rows[i].begin(), table.rows[i].begin() + d);
+                results[i] = settings.command.empty() ? runReplica(table, row, settings, 1000 * (i + 1))
+                                                      : runCommand(table, row, settings, (int)i);
+                std::lock_guard<std::mutex> lock(errorMutex);
+                fprintf(stderr, "point %zu done\n", i);
+            }
+            catch (std::exception& e) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                error = e.what();
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int t = 0; t < jobs; t++)
+        threads.emplace_back(worker);
+    for (std::thread& thread : threads)
+        thread.join();
+    if (!error.empty())
+        throw std::runtime_error(error);
+
+    table.columns.resize(d);
+    for (const std::string& response : settings.responses)
+        table.columns.push_back(response);
+    for (size_t i = 0; i < table.rows.size(); i++) {
+        table.rows[i].resize(d);
+        for (double value : results[i]) {
+            char buffer[64];
+            snprintf(buffer, sizeof(buffer), "%.10g", value);
+            table.rows[i].push_back(buffer);
+        }
+    }
+    table.write(std::cout);
+    return 0;
+}
+
+//
+// Model files: "#param" lines, then per response "response <name>" and the GP
+//
+struct Model
+{
+    std::vector<Parameter> parameters;
+    std::vector<std::string> responses;
+    std::vector<GaussianProcess> surrogates;
+
+    void read(const std::string& fileName);
+    std::vector<bool> categorical() const {
+        std::vector<bool> flags;
+        for (const Parameter& p : parameters)
+            flags.push_back(p.kind == Parameter::CATEGORICAL);
+        return flags;
+    }
+};
+
+void Model::read(const std::string& fileName)
+{
+    std::ifstream in(fileName);
+    if (!in)
+        throw std::runtime_error("cannot open " + fileName);
+    std::string word;
+    while (in >> word) {
+        if (word == "#param") {
+            std::string spec;
+            in >> spec;
+            parameters.push_back(Parameter::parse(spec));
+        } else if (word == "response") {
+            std::string name;
+            in >> name;
+            responses.push_back(name);
+            surrogates.emplace_back();
+            surrogates.back().load(in);
+        } else
+            throw std::runtime_error(fileName + ": unexpected " + word);
+    }
+}
+
+static int fit(int argc, char **argv)
+{
+    if (argc != 1)
+        throw std::runtime_error("fit: need exactly one results file");
+    Table table;
+    table.read(argv[0]);
+    size_t d = table.parameters.size();
+
+    std::vector<std::vector<double>> inputs;
+    for (const auto& row : table.rows) {
+        std::vector<double> input;
+        for (size_t k = 0; k < d; k++)
+            input.push_back(table.parameters[k].encode(row[k]));
+        inputs.push_back(input);
+    }
+    std::vector<bool> categorical;
+    for (const Parameter& p : table.parameters)
+        categorical.push_back(p.kind == Parameter::CATEGORICAL);
+
+    for (const Parameter& p : table.parameters)
+        std::cout << "#param " << p.spec << "\n";
+    for (size_t c = d; c < table.columns.size(); c++) {
+        std::vector<double> responses;
+        double mean = 0, squares = 0;
+        for (const auto& row : table.rows)
+            responses.push_back(strtod(row[c].c_str(), nullptr));
+        for (double r : responses)
+            mean += r / responses.size();
+        for (double r : responses)
+            squares += (r - mean) * (r - mean) / responses.size();
+
+        GaussianProcess gp;
+        gp.fit(inputs, responses, categorical);
+        std::cout << "response " << table.columns[c] << "\n";
+        gp.save(std::cout);
+
+        fprintf(stderr, "%s: %zu points, LOO RMSE %.4g (response sd %.4g), nugget %.3g, scales",
+                table.columns[c].c_str(), responses.size(), gp.getLooRmse(), std::sqrt(squares), gp.getNugget());
+        for (size_t k = 0; k < d; k++)
+            fprintf(stderr, " %s=%.3g", table.parameters[k].name.c_str(), gp.getScales()[k]);
+        fprintf(stderr, "\n");
+    }
+    return 0;
+}
+
+static int predict(int argc, char **argv)
+{
+    if (argc < 1)
+        throw std::runtime_error("predict: missing model file");
+    Model model;
+    model.read(argv[0]);
+    size_t d = model.parameters.size();
+    std::vector<double> input(d, NAN);
+    for (int i = 1; i < argc; i++) {
+        std::string assignment = argv[i];
+        size_t eq = assignment.find('=');
+        bool found = false;
+        for (size_t k = 0; k < d && eq != std::string::npos; k++) {
+            if (model.parameters[k].matches(assignment.substr(0, eq))) {
+                input[k] = model.parameters[k].encode(assignment.substr(eq + 1));
+                found = true;
+            }
+        }
+        if (!found)
+            throw std::runtime_error("predict: unknown parameter " + assignment);
+    }
+    for (size_t k = 0; k < d; k++)
+        if (std::isnan(input[k]))
+            throw std::runtime_error("predict: missing value of " + model.parameters[k].name);
+
+    for (size_t r = 0; r < model.responses.size(); r++) {
+        const GaussianProcess& gp = model.surrogates[r];
+        double mean, variance;
+        const int repeats = 10000;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < repeats; i++)
+            gp.predict(input, mean, variance);
+        double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / repeats;
+        double sd = std::sqrt(variance);
+        printf("%-20s %12.6g +/- %-10.4g 95%% [%.6g, %.6g]  (%.2f us per query)\n", model.responses[r].c_str(),
+               mean, sd, mean - 1.96 * sd, mean + 1.96 * sd, micros);
+    }
+    return 0;
+}
+
+static int sobol(int argc, char **argv)
+{
+    if (argc < 1)
+        throw std::runtime_error("sobol: missing model file");
+    Model model;
+    model.read(argv[0]);
+    int samples = 10000;
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-N") && i + 1 < argc)
+            samples = std::max(100, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            seed = strtoull(argv[++i], nullptr, 10);
+        else
+            throw std::runtime_error(std::string("sobol: unknown option ") + argv[i]);
+    }
+
+    // Two independent input samples A and B, encoded for the surrogate
+    size_t d = model.parameters.size();
+    ReplicaRng rng(seed);
+    auto sample = [&]() {
+        std::vector<double> input(d);
+        for (size_t k = 0; k < d; k++)
+            input[k] = model.parameters[k].encode(model.parameters[k].decode(rng.uniform01()));
+        return input;
+    };
+    std::vector<std::vector<double>> a(samples), b(samples);
+    for (int i = 0; i < samples; i++) {
+        a[i] = sample();
+        b[i] = sample();
+    }
+
+    printf("%-20s %-30s %10s %10s\n", "response", "parameter", "first", "total");
+    for (size_t r = 0; r < model.responses.size(); r++) {
+        const GaussianProcess& gp = model.surrogates[r];
+        auto f = [&](const std::vector<double>& input) {
+            double mean, variance;
+            gp.predict(input, mean, variance);
+            return mean;
+        };
+        std::vector<double> fa(samples), fb(samples);
+        double mean = 0, total = 0;
+        for (int i = 0; i < samples; i++) {
+            fa[i] = f(a[i]);
+            fb[i] = f(b[i]);
+            mean += (fa[i] + fb[i]) / (2 * samples);
+        }
+        for (int i = 0; i < samples; i++)
+            total += ((fa[i] - mean) * (fa[i] - mean) + (fb[i] - mean) * (fb[i] - mean)) / (2 * samples);
+
+        // Saltelli (first order) and Jansen (total) estimators with A_B^k:
+        // A with column k taken from B
+        for (size_t k = 0; k < d; k++) {
+            double first = 0, totalEffect = 0;
+            for (int i = 0; i < samples; i++) {
+                std::vector<double> mixed = a[i];
+                mixed[k] = b[i][k];
+                double fab = f(mixed);
+                first += fb[i] * (fab - fa[i]) / samples;
+                totalEffect += (fa[i] - fab) * (fa[i] - fab) / (2 * samples);
+            }
+            printf("%-20s %-30s %10.4f %10.4f\n", model.responses[r].c_str(), model.parameters[k].name.c_str(),
+                   total > 0 ? first / total : 0, total > 0 ? totalEffect / total : 0);
+        }
+    }
+    return 0;
+}
+
+static void usage()
+{
+    fprintf(stderr, "Usage: doe design -n points -p spec [-p spec ...] [-s seed]\n"
+                    "       doe run design.csv [-j jobs] [-x command] [-d dir] [-M module] [-r responses]\n"
+                    "                          [-T simTime] [-w warmup] [-R replications]\n"
+                    "       doe fit results.csv\n"
+                    "       doe predict model.txt name=value ...\n"
+                    "       doe sobol model.txt [-N samples] [-s seed]\n");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+    std::string command = argv[1];
+    try {
+        if (command == "design")
+            return design(argc - 2, argv + 2);
+        if (command == "run")
+            return run(argc - 2, argv + 2);
+        if (command == "fit")
+            return fit(argc - 2, argv + 2);
+        if (command == "predict")
+            return predict(argc - 2, argv + 2);
+        if (command == "sobol")
+            return sobol(argc - 2, argv + 2);
+    }
+    catch (std::exception& e) {
+        fprintf(stderr, "doe: %s\n", e.what());
+        return 1;
+    }
+    usage();
+    return 1;
+}
@@ -0,0 +1,99 @@
+//
+// hdrmerge - merges the log-bucketed histograms written by the hdrHistogram
+// result recorder (see hdr-histogram-file in omnetpp.ini) across cashiers
+// and runs, and prints quantiles per statistic.
+//
+// Usage: hdrmerge [-m moduleSubstring] [-s statistic] [-o merged.hdr] files...
+//
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <vector>
+#include <string>
+#include "../LogHistogram.h"
+
+static void usage()
+{
+    fprintf(stderr, "Usage: hdrmerge [-m moduleSubstring] [-s statistic] [-o merged.hdr] files...\n");
+}
+
+int main(int argc, char **argv)
+{
+    std::string moduleFilter;
+    std::string statisticFilter;
+    std::string outputFile;
+    std::vector<std::string> inputFiles;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-m") && i + 1 < argc)
+            moduleFilter = argv[++i];
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            statisticFilter = argv[++i];
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            outputFile = argv[++i];
+        else if (argv[i][0] == '-') {
+            usage();
+            return 1;
+        }
+        else
+            inputFiles.push_back(argv[i]);
+    }
+    if (inputFiles.empty()) {
+        usage();
+        return 1;
+    }
+
+    std::map<std::string, LogHistogram> merged;  // per statistic
+    std::map<std::string, int> sources;
+    for (const std::string& fileName : inputFiles) {
+        std::ifstream in(fileName, std::ios::binary);
+        if (!in) {
+            fprintf(stderr, "hdrmerge: cannot open %s\n", fileName.c_str());
+            return 1;
+        }
+        try {
+            std::string module, statistic;
+            LogHistogram histogram;
+            while (readLogHistogramRecord(in, module, statistic, histogram)) {
+                if (!moduleFilter.empty() && module.find(moduleFilter) == std::string::npos)
+                    continue;
+                if (!statisticFilter.empty() && statistic != statisticFilter)
+                    continue;
+                auto it = merged.find(statistic);
+                if (it == merged.end())
+                    merged.emplace(statistic, histogram);
+                else
+                    it->second.merge(histogram);
+                sources[statistic]++;
+            }
+        }
+        catch (std::exception& e) {
+            fprintf(stderr, "hdrmerge: %s: %s\n", fileName.c_str(), e.what());
+            return 1;
+        }
+    }
+
+    printf("%-20s %8s %10s %10s %10s %10s %10s %10s %10s %10s\n",
+           "statistic", "sources", "count", "min", "mean", "p50", "p90", "p99", "p99.9", "max");
+    for (const auto& entry : merged) {
+        const LogHistogram& h = entry.second;
+        printf("%-20s %8d %10llu %10.4g %10.4g %10.4g %10.4g %10.4g %10.4g %10.4g\n",
+               entry.first.c_str(), sources[entry.first], (unsigned long long)h.getCount(),
+               h.getMin(), h.getMean(), h.quantile(0.5), h.quantile(0.9), h.quantile(0.99),
+               h.quantile(0.999), h.getMax());
+    }
+
+    if (!outputFile.empty()) {
+        std::ofstream out(outputFile, std::ios::binary | std::ios::trunc);
+        for (const auto& entry : merged)
+            writeLogHistogramRecord(out, "merged", entry.first, entry.second);
+        if (!out) {
+            fprintf(stderr, "hdrmerge: cannot write %s\n", outputFile.c_str());
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,372 @@
+//
+// ocba - picks the best of several alternatives (by default the balancing
+// strategies) with sequential replications allocated by Optimal Computing
+// Budget Allocation (Chen et al.)
+//
+// Every alternative first gets n0 replications. Each following round adds
+// delta replications, spread so that the totals approach the OCBA ratios
+//
+//     N_i / N_j = (s_i / d_i)^2 / (s_j / d_j)^2        i, j != b
+//     N_b = s_b * sqrt(sum_{i != b} N_i^2 / s_i^2)
+//
+// where b is the current best, s_i the sample standard deviations and d_i
+// the distance of the mean of i to the best. Alternatives that are hard to
+// tell apart from the best get most of the budget, clearly worse ones
+// almost none. The run stops when the approximate probability of correct
+// selection (Bonferroni bound over the pairwise normal approximations)
+// reaches the target, or when the budget is used up. Differences smaller
+// than the indifference zone (-z) are taken as -z, so practically equivalent
+// alternatives do not use up the budget.
+//
+// Replications with the same index use the same seed set in all
+// alternatives (common random numbers), which only makes the probability
+// bound conservative.
+//
+// With -x, every replication runs the simulation executable with
+// --name=value, --seed-set and its own result directory, and the response
+// is a scalar of the network module (or -M). Without -x, the store replica
+// (StoreReplica.h) runs in-process.
+//
+// Usage: ocba [-p name=a,b,...] [-x command] [-d dir] [-M module] [-r response] [-o min|max]
+//             [-P targetPcs] [-z indifference] [-i n0] [-D delta] [-B budget] [-j jobs]
+//             [-a arrivalInterval] [-c cashiers] [-f speedFactor] [-T simTime] [-w warmup] [-s seed]
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ScaFile.h"
+#include "StoreReplica.h"
+
+struct Settings
+{
+    std::string parameter = "*.balancer.strategy";
+    std::vector<std::string> values = {"0", "1", "2"};
+    std::string command;
+    std::string resultDir = "ocba-results";
+    std::string module;
+    std::string response = "storeWaitingTime:mean";
+    bool maximize = false;
+    double targetPcs = 0.95;
+    double indifference = 0;
+    int initialReplications = 10;
+    int delta = 0;  // default: one per alternative
+    long budget = 1000;
+    int jobs = 0;
+    ReplicaConfig replica;
+    double simTime = 100000;
+    double warmup = 1000;
+    uint64_t seed = 1;
+};
+
+struct Alternative
+{
+    std::string value;
+    std::vector<double> observations;  // minimization sense
+
+    double mean() const {
+        double sum = 0;
+        for (double x : observations)
+            sum += x;
+        return sum / observations.size();
+    }
+    double variance() const {
+        double m = mean(), squares = 0;
+        for (double x : observations)
+            squares += (x - m) * (x - m);
+        return observations.size() > 1 ? squares / (observations.size() - 1) : 0;
+    }
+};
+
+static double normalCdf(double x)
+{
+    return 0.5 * std::erfc(-x / std::sqrt(2.0));
+}
+
+// One replication: the response of the given alternative with seed set r
+static double replicate(const Settings& settings, const std::string& value, int r)
+{
+    if (!settings.command.empty()) {
+        std::string dir = settings.resultDir + "/" + value + "/" + std::to_string(r);
+        std::string command = settings.command + " '--" + settings.parameter + "=" + value + "' --seed-set=" +
+                              std::to_string(r) + " '--result-dir=" + dir + "' > '" + dir + ".log' 2>&1";
+        if (system(("mkdir -p '" + dir + "'").c_str()) != 0 || system(command.c_str()) != 0)
+            throw std::runtime_error("replication failed, see " + dir + ".log");
+        for (const ScaRun& run : readScaDirectory(dir)) {
+            double response;
+            if (run.findScalar(settings.module, settings.response, response))
+                return response;
+        }
+        throw std::runtime_error("no scalar " + settings.response + " in " + dir);
+    }
+
+    // Replica: mean waiting time after the warm-up period
+    ReplicaConfig config = settings.replica;
+    config.strategy = atoi(value.c_str());
+    StoreReplica replica(config, settings.seed * 1000003 + r);
+    StoreReplica::Arrival arrival;
+    double sum = 0;
+    long count = 0;
+    while (replica.nextEventTime() < settings.simTime) {
+        if (replica.step(&arrival) == StoreReplica::ARRIVAL && replica.getTime() >= settings.warmup) {
+            sum += arrival.waitingTime;
+            count++;
+        }
+    }
+    return count > 0 ? sum / count : 0;
+}
+
+// Runs the requested number of extra replications of every alternative in parallel
+static void runReplications(const Settings& settings, std::vector<Alternative>& alternatives,
+                            const std::vector<int>& extra)
+{
+    struct Task { size_t alternative; int replication; double result; };
+    std::vector<Task> tasks;
+    for (size_t i = 0; i < alternatives.size(); i++)
+        for (int k = 0; k < extra[i]; k++)
+            tasks.push_back({i, (int)alternatives[i].observations.size() + k, 0});
+
+    std::atomic<size_t> next(0);
+    std::mutex errorMutex;
+    std::string error;
+    auto worker = [&]() {
+        for (size_t t; (t = next++) < tasks.size(); ) {
+            try {
+                double response = replicate(settings, alternatives[tasks[t].alternative].value, tasks[t].replication);
+                tasks[t].result = settings.maximize ? -response : response;
+            }
+            catch (std::exception& e) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                error = e.what();
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int j = 0; j < settings.jobs; j++)
+        threads.emplace_back(worker);
+    for (std::thread& thread : threads)
+        thread.join();
+    if (!error.empty())
+        throw std::runtime_error(error);
+
+    for (const Task& task : tasks)
+        alternatives[task.alternative].observations.push_back(task.result);
+}
+
+static size_t bestOf(const std::vector<Alternative>& alternatives)
+{
+    size_t best = 0;
+    for (size_t i = 1; i < alternatives.size(); i++)
+        if (alternatives[i].mean() < alternatives[best].mean())
+            best = i;
+    return best;
+}
+
+// Approximate probability of correct selection for the given replication counts
+static double approximatePcs(const std::vector<Alternative>& alternatives, const std::vector<double>& counts,
+                             double indifference)
+{
+    size_t b = bestOf(alternatives);
+    double pcs = 1;
+    for (size_t i = 0; i < alternatives.size(); i++) {
+        if (i == b)
+            continue;
+        double distance = std::max(alternatives[i].mean() - alternatives[b].mean(), indifference);
+        double deviation = std::sqrt(alternatives[i].variance() / counts[i] + alternatives[b].variance() / counts[b]);
+        pcs -= deviation > 0 ? normalCdf(-distance / deviation) : (distance > 0 ? 0 : 0.5);
+    }
+    return std::max(pcs, 0.0);
+}
+
+static double currentPcs(const std::vector<Alternative>& alternatives, double indifference)
+{
+    std::vector<double> counts;
+    for (const Alternative& alternative : alternatives)
+        counts.push_back(alternative.observations.size());
+    return approximatePcs(alternatives, counts, indifference);
+}
+
+// OCBA: extra replications per alternative for a new total of total + delta
+static std::vector<int> allocate(const std::vector<Alternative>& alternatives, int delta, double indifference)
+{
+    size_t k = alternatives.size();
+    size_t b = bestOf(alternatives);
+    long total = delta;
+    for (const Alternative& alternative : alternatives)
+        total += alternative.observations.size();
+
+    // Distances below the indifference zone (or zero) would claim everything
+    double minDistance = indifference;
+    double scale = 0;
+    for (const Alternative& alternative : alternatives)
+        scale = std::max(scale, std::sqrt(alternative.variance()));
+    if (minDistance <= 0)
+        minDistance = 1e-6 * std::max(scale, 1e-12);
+
+    std::vector<double> ratios(k, 0.0);
+    double bestSum = 0, ratioSum = 0;
+    for (size_t i = 0; i < k; i++) {
+        if (i == b)
+            continue;
+        double sd = std::max(std::sqrt(alternatives[i].variance()), 1e-12);
+        double distance = std::max(alternatives[i].mean() - alternatives[b].mean(), minDistance);
+        ratios[i] = (sd / distance) * (sd / distance);
+        bestSum += ratios[i] * ratios[i] / (sd * sd);
+    }
+    ratios[b] = std::max(std::sqrt(alternatives[b].variance()), 1e-12) * std::sqrt(bestSum);
+    for (double ratio : ratios)
+        ratioSum += ratio;
+
+    // Fill the deficits towards the target totals; delta goes to the largest
+    // deficits, by largest remainder
+    std::vector<double> deficits(k);
+    double deficitSum = 0;
+    for (size_t i = 0; i < k; i++) {
+        deficits[i] = std::max(0.0, total * ratios[i] / ratioSum - alternatives[i].observations.size());
+        deficitSum += deficits[i];
+    }
+    std::vector<int> extra(k, 0);
+    if (deficitSum <= 0) {
+        extra[b] = delta;
+        return extra;
+    }
+    std::vector<double> remainders(k);
+    int assigned = 0;
+    for (size_t i = 0; i < k; i++) {
+        double share = delta * deficits[i] / deficitSum;
+        extra[i] = (int)share;
+        remainders[i] = share - extra[i];
+        assigned += extra[i];
+    }
+    while (assigned < delta) {
+        size_t i = std::max_element(remainders.begin(), remainders.end()) - remainders.begin();
+        extra[i]++;
+        remainders[i] = -1;
+        assigned++;
+    }
+    return extra;
+}
+
+static void usage()
+{
+    fprintf(stderr, "Usage: ocba [-p name=a,b,...] [-x command] [-d dir] [-M module] [-r response] [-o min|max]\n"
+                    "            [-P targetPcs] [-z indifference] [-i n0] [-D delta] [-B budget] [-j jobs]\n"
+                    "            [-a arrivalInterval] [-c cashiers] [-f speedFactor] [-T simTime] [-w warmup] [-s seed]\n");
+}
+
+int main(int argc, char **argv)
+{
+    Settings settings;
+    settings.replica.arrivalInterval = 5;  // load 0.81 with 4 cashiers
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2) {
+            usage();
+            return 1;
+        }
+        std::string value = argv[++i];
+        switch (argv[i - 1][1]) {
+            case 'p': {
+                size_t eq = value.find('=');
+                if (eq == std::string::npos) {
+                    usage();
+                    return 1;
+                }
+                settings.parameter = value.substr(0, eq);
+                settings.values.clear();
+                std::stringstream in(value.substr(eq + 1));
+                std::string item;
+                while (std::getline(in, item, ','))
+                    settings.values.push_back(item);
+                break;
+            }
+            case 'x': settings.command = value; break;
+            case 'd': settings.resultDir = value; break;
+            case 'M': settings.module = value; break;
+            case 'r': settings.response = value; break;
+            case 'o': settings.maximize = value == "max"; break;
+            case 'P': settings.targetPcs = atof(value.c_str()); break;
+            case 'z': settings.indifference = atof(value.c_str()); break;
+            case 'i': settings.initialReplications = atoi(value.c_str()); break;
+            case 'D': settings.delta = atoi(value.c_str()); break;
+            case 'B': settings.budget = atol(value.c_str()); break;
+            case 'j': settings.jobs = atoi(value.c_str()); break;
+            case 'a': settings.replica.arrivalInterval = atof(value.c_str()); break;
+            case 'c': settings.replica.numCashiers = atoi(value.c_str()); break;
+            case 'f': settings.replica.speedFactor = atof(value.c_str()); break;
+            case 'T': settings.simTime = atof(value.c_str()); break;
+            case 'w': settings.warmup = atof(value.c_str()); break;
+            case 's': settings.seed = strtoull(value.c_str(), nullptr, 10); break;
+            default: usage(); return 1;
+        }
+    }
+    size_t k = settings.values.size();
+    if (k < 2 || settings.initialReplications < 2 || settings.targetPcs <= 0 || settings.targetPcs >= 1) {
+        usage();
+        return 1;
+    }
+    const std::string suffix = "strategy";
+    const std::string& name = settings.parameter;
+    if (settings.command.empty() && (name.size() < suffix.size() || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0)) {
+        fprintf(stderr, "ocba: the replica only varies the strategy, use -x for %s\n", name.c_str());
+        return 1;
+    }
+    if (settings.delta <= 0)
+        settings.delta = (int)k;
+    if (settings.jobs <= 0)
+        settings.jobs = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<Alternative> alternatives(k);
+    for (size_t i = 0; i < k; i++)
+        alternatives[i].value = settings.values[i];
+
+    try {
+        runReplications(settings, alternatives, std::vector<int>(k, settings.initialReplications));
+        long total = k * settings.initialReplications;
+        double pcs = currentPcs(alternatives, settings.indifference);
+        printf("%-6s %8s %8s  %s\n", "round", "total", "pcs", "replications");
+        for (int round = 0; ; round++) {
+            printf("%-6d %8ld %8.4f ", round, total, pcs);
+            for (const Alternative& alternative : alternatives)
+                printf(" %s:%zu", alternative.value.c_str(), alternative.observations.size());
+            printf("\n");
+            fflush(stdout);
+            if (pcs >= settings.targetPcs || total + settings.delta > settings.budget)
+                break;
+            runReplications(settings, alternatives, allocate(alternatives, settings.delta, settings.indifference));
+            total += settings.delta;
+            pcs = currentPcs(alternatives, settings.indifference);
+        }
+
+        size_t best = bestOf(alternatives);
+        double sign = settings.maximize ? -1 : 1;
+        printf("\n%-30s %10s %14s %12s %8s\n", settings.parameter.c_str(), "reps", settings.response.c_str(), "sd", "");
+        for (size_t i = 0; i < k; i++)
+            printf("%-30s %10zu %14.6g %12.4g %8s\n", alternatives[i].value.c_str(), alternatives[i].observations.size(),
+                   sign * alternatives[i].mean(), std::sqrt(alternatives[i].variance()), i == best ? "best" : "");
+        printf("selected %s=%s with approximate PCS %.4f (target %.4f) after %ld replications\n",
+               settings.parameter.c_str(), alternatives[best].value.c_str(), pcs, settings.targetPcs, total);
+
+        // Equal allocation reaching the same bound, from the same estimates
+        long equal = settings.initialReplications;
+        while (equal * (long)k < 100 * settings.budget) {
+            if (approximatePcs(alternatives, std::vector<double>(k, (double)equal), settings.indifference) >= pcs)
+                break;
+            equal++;
+        }
+        printf("equal allocation would need about %ld replications (%.2fx)\n", equal * (long)k,
+               (double)(equal * (long)k) / total);
+    }
+    catch (std::exception& e) {
+        fprintf(stderr, "ocba: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,148 @@
+//
+// pairmerge - merges antithetic replications (rng-class = "AntitheticRNG",
+// see omnetpp.ini) from scalar files. Repetitions 2k and 2k+1 of the same
+// config and iteration variables form a pair; each pair's average is one
+// independent observation. Per config and scalar it prints the mean with its
+// half-width over the pairs, the half-width the same runs would give if they
+// were independent, the correlation within the pairs and the variance ratio
+// Var(pair average) / (Var(single run) / 2), i.e. the fraction of runs still
+// needed for the same precision.
+//
+// Usage: pairmerge [-m moduleSubstring] [-s scalar] [-c confidence] files...
+//
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include "../BatchMeans.h"
+#include "ScaFile.h"
+
+static void usage()
+{
+    fprintf(stderr, "Usage: pairmerge [-m moduleSubstring] [-s scalar] [-c confidence] files...\n");
+}
+
+static double variance(const std::vector<double>& values)
+{
+    double mean = 0, sum = 0;
+    for (double v : values)
+        mean += v;
+    mean /= values.size();
+    for (double v : values)
+        sum += (v - mean) * (v - mean);
+    return sum / (values.size() - 1);
+}
+
+int main(int argc, char **argv)
+{
+    std::string moduleFilter;
+    std::string scalarFilter;
+    double confidence = 0.95;
+    std::vector<std::string> inputFiles;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-m") && i + 1 < argc)
+            moduleFilter = argv[++i];
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            scalarFilter = argv[++i];
+        else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+            confidence = atof(argv[++i]);
+        else if (argv[i][0] == '-') {
+            usage();
+            return 1;
+        }
+        else
+            inputFiles.push_back(argv[i]);
+    }
+    if (inputFiles.empty() || confidence <= 0 || confidence >= 1) {
+        usage();
+        return 1;
+    }
+
+    // Group the runs by config and iteration variables, then by repetition
+    std::map<std::string, std::map<int, ScaRun>> groups;
+    for (const std::string& fileName : inputFiles) {
+        try {
+            for (ScaRun& run : readScaFile(fileName)) {
+                std::string key = run.attribute("configname");
+                for (const auto& variable : run.iterationVariables)
+                    key += " " + variable.first + "=" + variable.second;
+                groups[key][atoi(run.attribute("repetition").c_str())] = std::move(run);
+            }
+        }
+        catch (std::exception& e) {
+            fprintf(stderr, "pairmerge: %s\n", e.what());
+            return 1;
+        }
+    }
+
+    printf("%-30s %-30s %-28s %5s %12s %12s %12s %7s %8s\n",
+           "config", "module", "scalar", "pairs", "mean", "halfWidth", "indepHW", "corr", "varRatio");
+    for (const auto& group : groups) {
+        // Pair observations per scalar
+        std::map<std::pair<std::string, std::string>, std::vector<std::pair<double, double>>> pairs;
+        for (const auto& entry : group.second) {
+            int repetition = entry.first;
+            auto partner = group.second.find(repetition + 1);
+            if (repetition % 2 != 0 || partner == group.second.end())
+                continue;
+            for (const auto& scalar : entry.second.scalars) {
+                const std::string& module = scalar.first.first;
+                const std::string& name = scalar.first.second;
+                if (!moduleFilter.empty() && module.find(moduleFilter) == std::string::npos)
+                    continue;
+                if (!scalarFilter.empty() && name != scalarFilter)
+                    continue;
+                auto other = partner->second.scalars.find(scalar.first);
+                if (other != partner->second.scalars.end() && std::isfinite(scalar.second) && std::isfinite(other->second))
+                    pairs[scalar.first].push_back({scalar.second, other->second});
+            }
+        }
+
+        int unpaired = 0;
+        for (const auto& entry : group.second)
+            if (!group.second.count(entry.first % 2 == 0 ? entry.first + 1 : entry.first - 1))
+                unpaired++;
+        if (unpaired > 0)
+            fprintf(stderr, "pairmerge: %s: %d run(s) without antithetic partner ignored\n", group.first.c_str(), unpaired);
+
+        for (const auto& entry : pairs) {
+            const auto& observations = entry.second;
+            int n = (int)observations.size();
+            if (n < 2)
+                continue;
+
+            std::vector<double> averages, singles;
+            double meanFirst = 0, meanSecond = 0;
+            for (const auto& pair : observations) {
+                averages.push_back((pair.first + pair.second) / 2);
+                singles.push_back(pair.first);
+                singles.push_back(pair.second);
+                meanFirst += pair.first / n;
+                meanSecond += pair.second / n;
+            }
+            double mean = (meanFirst + meanSecond) / 2;
+
+            double covariance = 0, varianceFirst = 0, varianceSecond = 0;
+            for (const auto& pair : observations) {
+                covariance += (pair.first - meanFirst) * (pair.second - meanSecond);
+                varianceFirst += (pair.first - meanFirst) * (pair.first - meanFirst);
+                varianceSecond += (pair.second - meanSecond) * (pair.second - meanSecond);
+            }
+            double correlation = varianceFirst > 0 && varianceSecond > 0 ? covariance / std::sqrt(varianceFirst * varianceSecond) : NAN;
+            double singleVariance = variance(singles);
+            double varianceRatio = singleVariance > 0 ? variance(averages) / (singleVariance / 2) : NAN;
+
+            printf("%-30s %-30s %-28s %5d %12.6g %12.6g %12.6g %7.3f %8.3f\n",
+                   group.first.c_str(), entry.first.first.c_str(), entry.first.second.c_str(), n, mean,
+                   BatchMeans::confidenceHalfWidth(averages, confidence),
+                   BatchMeans::confidenceHalfWidth(singles, confidence),
+                   correlation, varianceRatio);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,312 @@
+//
+// queuebench - memory and cache cost of the cashier queues: queues of
+// pointers to heap-allocated messages (std::queue<CustomerMsg*>, as before)
+// against compact 32-byte records in a ring buffer (RingBuffer.h, as the
+// Cashier now keeps them)
+//
+// Both variants hold -c queues of -q customers and then run -n operations.
+// Each operation picks a random queue, dequeues the front customer, reads
+// the fields that starting a service reads and enqueues a new customer, so
+// the lengths stay constant. A message stands in for CustomerMsg: an object
+// of -m bytes (cMessage header plus the generated fields; print
+// sizeof(CustomerMsg) in your build for the exact size) with the fields at
+// the end, allocated as customers arrive in between other allocations.
+//
+// Reported per variant: heap bytes per queued customer (mallinfo2, with
+// allocator overhead and container structure), nanoseconds per operation
+// and, where the kernel allows perf events, cache misses per dequeue (all
+// levels as counted by the CPU, and L1 data read misses).
+//
+// Usage: queuebench [-c queues] [-q length] [-n operations] [-m messageBytes] [-s seed]
+//
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <malloc.h>
+#include <new>
+#include <queue>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "../RingBuffer.h"
+#include "StoreReplica.h"
+
+// Same layout as QueuedCustomer in the model (simtime_t is a 64-bit integer)
+struct Record
+{
+    int64_t arrivalTime;
+    double interArrivalTime;
+    double arrivalTimeDerivative;
+    int customerId;
+    int numberOfItems;
+};
+static_assert(sizeof(Record) == 32, "record layout");
+
+// Stand-in for a CustomerMsg: header bytes, then the fields
+struct Message
+{
+    static size_t size;
+
+    static Message *create(const Record& fields) {
+        Message *message = static_cast<Message*>(::operator new(size));
+        memset(static_cast<void*>(message), 0, size - sizeof(Record));
+        message->fields() = fields;
+        return message;
+    }
+    static void destroy(Message *message) { ::operator delete(message); }
+
+    Record& fields() { return *reinterpret_cast<Record*>(reinterpret_cast<char*>(this) + size - sizeof(Record)); }
+};
+size_t Message::size = 240;
+
+// Hardware cache miss counters of this thread; inactive if perf events are not permitted
+class CacheMisses
+{
+  private:
+    int fds[2] = {-1, -1};
+
+    static int open(uint32_t type, uint64_t config) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+  public:
+    CacheMisses() {
+        fds[0] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        fds[1] = open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    }
+    ~CacheMisses() {
+        for (int fd : fds)
+            if (fd >= 0)
+                close(fd);
+    }
+
+    void start() {
+        for (int fd : fds) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+    }
+
+    // Counts since start(), -1 where not available
+    void stop(long long counts[2]) {
+        for (int i = 0; i < 2; i++) {
+            counts[i] = -1;
+            if (fds[i] >= 0) {
+                ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+                if (read(fds[i], &counts[i], sizeof(counts[i])) != sizeof(counts[i]))
+                    counts[i] = -1;
+            }
+        }
+    }
+};
+
+struct Settings
+{
+    int queues = 64;
+    int length = 2000;
+    long operations = 4000000;
+    uint64_t seed = 1;
+};
+
+struct Result
+{
+    double bytesPerCustomer;
+    double nanosPerOperation;
+    long long misses[2];
+    double checksum;
+};
+
+static Record newCustomer(ReplicaRng& rng, int id, double now)
+{
+    Record record;
+    record.arrivalTime = (int64_t)(now * 1e12);
+    record.interArrivalTime = rng.exponential(5);
+    record.arrivalTimeDerivative = record.interArrivalTime / 5;
+    record.customerId = id;
+    record.numberOfItems = rng.intuniform(1, 25);
+    return record;
+}
+
+// What starting a service reads from the customer
+static double serve(const Record& record, double now)
+{
+    return now - record.arrivalTime * 1e-12 + record.numberOfItems + record.interArrivalTime + record.arrivalTimeDerivative;
+}
+
+static size_t heapInUse()
+{
+    return mallinfo2().uordblks;
+}
+
+// Heap growth since before without the noise blocks, which are then
+// allocated again (into the same holes, between the queued customers)
+static double queuedBytes(std::vector<void*>& noise, size_t before)
+{
+    std::vector<size_t> sizes;
+    for (void *block : noise) {
+        sizes.push_back(malloc_usable_size(block));
+        free(block);
+    }
+    double bytes = (double)heapInUse() - (double)before;
+    for (size_t i = 0; i < noise.size(); i++)
+        noise[i] = malloc(sizes[i]);
+    return bytes;
+}
+
+static Result benchmarkMessages(const Settings& settings)
+{
+    ReplicaRng rng(settings.seed);
+    std::vector<void*> noise;  // other allocations of the simulation, interleaved with arrivals
+    noise.reserve((size_t)settings.queues * settings.length + 1);
+    noise.push_back(malloc(16));
+    size_t before = heapInUse();
+    std::vector<std::queue<Message*>> queues(settings.queues);
+    int id = 0;
+    for (int k = 0; k < settings.length; k++) {
+        for (std::queue<Message*>& queue : queues) {
+            queue.push(Message::create(newCustomer(rng, ++id, 0)));
+            if (rng.uniform01() < 0.5)
+                noise.push_back(malloc(16 + rng.intuniform(0, 200)));
+        }
+    }
+    Result result;
+    result.bytesPerCustomer = queuedBytes(noise, before) / ((double)settings.queues * settings.length);
+
+    CacheMisses counters;
+    double checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    counters.start();
+    for (long n = 0; n < settings.operations; n++) {
+        std::queue<Message*>& queue = queues[rng.next() % settings.queues];
+        Message *customer = queue.front();
+        queue.pop();
+        checksum += serve(customer->fields(), n);
+        Message::destroy(customer);
+        size_t slot = rng.next() % noise.size();
+        free(noise[slot]);
+        noise[slot] = malloc(16 + rng.intuniform(0, 200));
+        queue.push(Message::create(newCustomer(rng, ++id, n)));
+    }
+    counters.stop(result.misses);
+    result.nanosPerOperation = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / settings.operations;
+    result.checksum = checksum;
+
+    for (std::queue<Message*>& queue : queues) {
+        while (!queue.empty()) {
+            Message::destroy(queue.front());
+            queue.pop();
+        }
+    }
+    for (void *block : noise)
+        free(block);
+    return result;
+}
+
+static Result benchmarkRecords(const Settings& settings)
+{
+    ReplicaRng rng(settings.seed);
+    std::vector<void*> noise;
+    noise.reserve((size_t)settings.queues * settings.length + 1);
+    noise.push_back(malloc(16));
+    size_t before = heapInUse();
+    std::vector<RingBuffer<Record>> queues(settings.queues);
+    int id = 0;
+    for (int k = 0; k < settings.length; k++) {
+        for (RingBuffer<Record>& queue : queues) {
+            queue.push(newCustomer(rng, ++id, 0));
+            if (rng.uniform01() < 0.5)
+                noise.push_back(malloc(16 + rng.intuniform(0, 200)));
+        }
+    }
+    Result result;
+    result.bytesPerCustomer = queuedBytes(noise, before) / ((double)settings.queues * settings.length);
+
+    CacheMisses counters;
+    double checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    counters.start();
+    for (long n = 0; n < settings.operations; n++) {
+        RingBuffer<Record>& queue = queues[rng.next() % settings.queues];
+        checksum += serve(queue.front(), n);
+        queue.pop();
+        size_t slot = rng.next() % noise.size();
+        free(noise[slot]);
+        noise[slot] = malloc(16 + rng.intuniform(0, 200));
+        queue.push(newCustomer(rng, ++id, n));
+    }
+    counters.stop(result.misses);
+    result.nanosPerOperation = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / settings.operations;
+    result.checksum = checksum;
+
+    for (void *block : noise)
+        free(block);
+    return result;
+}
+
+static void print(const char *name, const Result& result, const Settings& settings)
+{
+    printf("%-22s %12.1f %10.1f", name, result.bytesPerCustomer, result.nanosPerOperation);
+    for (long long misses : result.misses) {
+        if (misses >= 0)
+            printf(" %14.2f", (double)misses / settings.operations);
+        else
+            printf(" %14s", "n/a");
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    Settings settings;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2) {
+            fprintf(stderr, "Usage: queuebench [-c queues] [-q length] [-n operations] [-m messageBytes] [-s seed]\n");
+            return 1;
+        }
+        const char *value = argv[++i];
+        switch (argv[i - 1][1]) {
+            case 'c': settings.queues = atoi(value); break;
+            case 'q': settings.length = atoi(value); break;
+            case 'n': settings.operations = atol(value); break;
+            case 'm': Message::size = std::max((size_t)atol(value), 2 * sizeof(Record)); break;
+            case 's': settings.seed = strtoull(value, nullptr, 10); break;
+            default:
+                fprintf(stderr, "Usage: queuebench [-c queues] [-q length] [-n operations] [-m messageBytes] [-s seed]\n");
+                return 1;
+        }
+    }
+    if (settings.queues < 1 || settings.length < 1 || settings.operations < 1) {
+        fprintf(stderr, "queuebench: queues, length and operations must be positive\n");
+        return 1;
+    }
+
+    printf("%d queues of %d customers, %ld dequeue/enqueue operations, %zu-byte messages\n\n", settings.queues,
+           settings.length, settings.operations, Message::size);
+    printf("%-22s %12s %10s %14s %14s\n", "queue", "bytes/cust", "ns/op", "misses/deq", "L1d misses/deq");
+    Result messages = benchmarkMessages(settings);
+    print("std::queue<Message*>", messages, settings);
+    Result records = benchmarkRecords(settings);
+    print("RingBuffer<Record>", records, settings);
+    if (messages.checksum != records.checksum)
+        fprintf(stderr, "queuebench: checksums differ\n");
+    if (messages.misses[0] < 0)
+        printf("\ncache misses n/a: perf events not permitted (see /proc/sys/kernel/perf_event_paranoid)\n");
+    return 0;
+}
@@ -0,0 +1,446 @@
+//
+// replicate - many runs of one config as threads of one process
+//
+// Runs the runs of a config in omnetpp.ini (all iterations and
+// repetitions, or the first -r) as independent cSimulation instances on -j
+// threads. The NED files and the ini file are parsed once and shared
+// read-only. Each run has its own configuration (the run's section chain
+// and iteration variables over the shared ini), its own RNGs and its own
+// result manager, which writes the run's scalars to
+// <resultDir>/<config>-#<run>.sca. The first run goes alone on the main
+// thread, so that signal IDs, NED functions and the model's shared tables
+// are registered before the threads start.
+//
+// Collected are the scalars and statistics that modules record themselves
+// (in finish()). As in whatifd, @statistic result recorders and vectors
+// are not attached. Every run uses cMersenneTwister: a config whose
+// rng-class is anything else (e.g. Antithetic, cAntitheticRNG) is refused
+// with an error for each of its runs and must run as processes. Per-module
+// RNG mappings are not applied (every module draws from its RNG 0 of
+// num-rngs).
+//
+// With -x, the same runs are also started as processes of the simulation
+// executable, -j at a time, and the throughput of both in runs per second
+// is compared. The processes run with @statistic recorders and vectors
+// switched off, so both do the same work. Then every scalar of a process
+// run must be in the in-process .sca of the same run number with the same
+// value (to the 14 digits the process writes); mismatches are listed and
+// make the exit status nonzero.
+//
+// Usage: replicate [-c config] [-f inifile] [-n ned-path] [-r runs] [-j threads] [-d resultDir] [-x command]
+//
+// Built from the model sources against the OMNeT++ libraries (the kernel's
+// active simulation and context are thread-local), with its own main (see
+// README).
+//
+
+#include <omnetpp.h>
+#include "envir/inifilereader.h"
+#include "envir/sectionbasedconfig.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ScaFile.h"
+
+using namespace omnetpp;
+using namespace omnetpp::envir;
+
+//==============================================================================
+// SHARED CONFIGURATION
+//==============================================================================
+// Read-only view of the ini file parsed once; every run's configuration owns
+// one of these instead of its own parse
+class SharedIni : public cConfigurationReader
+{
+  private:
+    const InifileReader& ini;
+
+  public:
+    explicit SharedIni(const InifileReader& ini) : ini(ini) {}
+
+    virtual const char *getFileName() const override { return ini.getFileName(); }
+    virtual const char *getDefaultBaseDirectory() const override { return ini.getDefaultBaseDirectory(); }
+    virtual int getNumSections() const override { return ini.getNumSections(); }
+    virtual const char *getSectionName(int sectionId) const override { return ini.getSectionName(sectionId); }
+    virtual int getNumEntries(int sectionId) const override { return ini.getNumEntries(sectionId); }
+    virtual const KeyValue& getEntry(int sectionId, int entryId) const override { return ini.getEntry(sectionId, entryId); }
+    virtual void dump() const override { ini.dump(); }
+};
+
+static SectionBasedConfiguration *activate(const InifileReader& ini, const std::string& configName, int runNumber)
+{
+    SectionBasedConfiguration *config = new SectionBasedConfiguration();
+    config->setConfigurationReader(new SharedIni(ini));
+    config->activateConfig(configName.c_str(), runNumber);
+    return config;
+}
+
+static std::string configValue(cConfigurationEx *config, const char *key, const std::string& defaultValue)
+{
+    const char *value = config->getConfigValue(key);
+    if (!value || !*value)
+        return defaultValue;
+    std::string text = value;
+    if (text.size() >= 2 && text.front() == '"' && text.back() == '"')
+        text = text.substr(1, text.size() - 2);
+    return text;
+}
+
+//==============================================================================
+// PER-RUN ENVIRONMENT
+//==============================================================================
+struct Scalar
+{
+    std::string module;
+    std::string name;
+    double value;
+};
+
+// Environment of one run: parameters from its configuration, its own RNGs,
+// scalars collected in memory
+class RunEnvir : public cNullEnvir
+{
+  private:
+    cConfigurationEx *config;
+    std::vector<cRNG *> rngs;
+
+  public:
+    std::vector<Scalar> scalars;
+
+    RunEnvir(cConfigurationEx *config, int seedSet) : cNullEnvir(0, nullptr, config), config(config)
+    {
+        int numRngs = std::max(1, atoi(configValue(config, "num-rngs", "1").c_str()));
+        for (int k = 0; k < numRngs; k++) {
+            cRNG *rng = new cMersenneTwister();
+            rng->initialize(seedSet, k, numRngs, 0, 1, config);
+            rngs.push_back(rng);
+        }
+    }
+
+    virtual ~RunEnvir()
+    {
+        for (cRNG *rng : rngs)
+            delete rng;
+    }
+
+    virtual int getNumRNGs() const override { return (int)rngs.size(); }
+    virtual cRNG *getRNG(int k) override { return rngs[k % rngs.size()]; }
+
+    virtual void readParameter(cPar *par) override
+    {
+        std::string modulePath = par->getOwner()->getFullPath();
+        const char *value = config->getParameterValue(modulePath.c_str(), par->getName(), par->containsValue());
+        if (value && strcmp(value, "default") != 0) {
+            par->parse(value);
+            return;
+        }
+        if (!par->containsValue())
+            throw cRuntimeError("No value for parameter %s", par->getFullPath().c_str());
+        par->acceptDefault();
+    }
+
+    virtual void recordScalar(cComponent *component, const char *name, double value, opp_string_map *attributes = nullptr) override
+    {
+        scalars.push_back({component->getFullPath(), name, value});
+    }
+
+    virtual void recordStatistic(cComponent *component, const char *name, cStatistic *statistic, opp_string_map *attributes = nullptr) override
+    {
+        std::string base = name ? name : statistic->getName();
+        std::string module = component->getFullPath();
+        scalars.push_back({module, base + ":count", (double)statistic->getCount()});
+        scalars.push_back({module, base + ":mean", statistic->getMean()});
+        scalars.push_back({module, base + ":stddev", statistic->getStddev()});
+        scalars.push_back({module, base + ":min", statistic->getMin()});
+        scalars.push_back({module, base + ":max", statistic->getMax()});
+    }
+};
+
+//==============================================================================
+// RUNS
+//==============================================================================
+struct RunOutcome
+{
+    bool ok = false;
+    std::string error;
+    long events = 0;
+};
+
+static std::string quoted(const std::string& text)
+{
+    if (text.find_first_of(" \t\"") == std::string::npos && !text.empty())
+        return text;
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+static std::string scalarFile(const std::string& resultDir, const std::string& configName, int runNumber)
+{
+    return resultDir + "/" + configName + "-#" + std::to_string(runNumber) + ".sca";
+}
+
+static void writeScalars(const std::string& fileName, const std::string& configName, int runNumber,
+                         const std::vector<std::pair<std::string, std::string>>& iterationVariables,
+                         const std::vector<Scalar>& scalars)
+{
+    std::ofstream out(fileName);
+    out << "version 3\n";
+    out << "run " << configName << "-" << runNumber << "-replicate\n";
+    out << "attr configname " << quoted(configName) << "\n";
+    out << "attr runnumber " << runNumber << "\n";
+    for (const auto& variable : iterationVariables)
+        out << "itervar " << quoted(variable.first) << " " << quoted(variable.second) << "\n";
+    out << "\n";
+    char value[32];
+    for (const Scalar& scalar : scalars) {
+        snprintf(value, sizeof(value), "%.17g", scalar.value);
+        out << "scalar " << quoted(scalar.module) << " " << quoted(scalar.name) << " " << value << "\n";
+    }
+    if (!out)
+        throw std::runtime_error("cannot write " + fileName);
+}
+
+// One run on the calling thread, which becomes the active simulation's thread
+static RunOutcome runInProcess(const InifileReader& ini, const std::string& configName, int runNumber,
+                               const std::string& resultDir)
+{
+    RunOutcome outcome;
+    SectionBasedConfiguration *config = activate(ini, configName, runNumber);
+    std::vector<std::pair<std::string, std::string>> iterationVariables;
+    for (const char *name : config->getIterationVariableNames())
+        iterationVariables.push_back({name, config->getVariable(name)});
+    std::string rngClass = configValue(config, "rng-class", "cMersenneTwister");
+    std::string networkName = configValue(config, "network", "supermarket_sim");
+    std::string timeLimit = configValue(config, "sim-time-limit", "");
+    int seedSet = atoi(configValue(config, "seed-set", std::to_string(runNumber)).c_str());
+
+    RunEnvir *envir = new RunEnvir(config, seedSet);
+    cSimulation *simulation = new cSimulation("simulation", envir);
+    cSimulation::setActiveSimulation(simulation);
+    try {
+        if (rngClass != "cMersenneTwister" && rngClass != "omnetpp::cMersenneTwister")
+            throw cRuntimeError("rng-class %s is not supported, run this config as processes", rngClass.c_str());
+        cModuleType *networkType = cModuleType::find(networkName.c_str());
+        if (!networkType)
+            throw cRuntimeError("No such network: %s", networkName.c_str());
+        simulation->setupNetwork(networkType);
+        if (!timeLimit.empty())
+            simulation->setSimulationTimeLimit(SimTime::parse(timeLimit.c_str()));
+        simulation->callInitialize();
+        try {
+            while (cEvent *event = simulation->takeNextEvent()) {
+                simulation->executeEvent(event);
+                outcome.events++;
+            }
+        }
+        catch (cTerminationException& e) {
+            // sim-time-limit reached or endSimulation() called
+        }
+        simulation->callFinish();
+        outcome.ok = true;
+    }
+    catch (std::exception& e) {
+        outcome.error = e.what();
+    }
+    std::vector<Scalar> scalars;
+    scalars.swap(envir->scalars);
+    simulation->deleteNetwork();
+    cSimulation::setActiveSimulation(nullptr);
+    delete simulation;  // deletes the envir and its configuration as well
+
+    if (outcome.ok) {
+        try {
+            writeScalars(scalarFile(resultDir, configName, runNumber), configName, runNumber, iterationVariables,
+                         scalars);
+        }
+        catch (std::exception& e) {
+            outcome.ok = false;
+            outcome.error = e.what();
+        }
+    }
+    return outcome;
+}
+
+static RunOutcome runAsProcess(const std::string& command, const std::string& configName, int runNumber,
+                               const std::string& resultDir)
+{
+    RunOutcome outcome;
+    // Without recorders and vectors, like the in-process runs
+    std::string line = command + " -c '" + configName + "' -r " + std::to_string(runNumber) + " '--result-dir=" +
+                       resultDir + "' '--output-scalar-file=" + scalarFile(resultDir, configName, runNumber) +
+                       "' '--**.result-recording-modes=-' '--**.vector-recording=false' > /dev/null 2>&1";
+    outcome.ok = system(line.c_str()) == 0;
+    if (!outcome.ok)
+        outcome.error = "exit status of: " + line;
+    return outcome;
+}
+
+// Every scalar of the process run must be in the in-process run with the same
+// value; the in-process file has the statistics' fields as extra scalars.
+// Returns the number of runs that differ.
+static int compareScalars(const std::string& inProcessDir, const std::string& processDir,
+                          const std::string& configName, int runs)
+{
+    int differing = 0;
+    for (int runNumber = 0; runNumber < runs; runNumber++) {
+        std::vector<std::string> problems;
+        try {
+            std::vector<ScaRun> inProcess = readScaFile(scalarFile(inProcessDir, configName, runNumber));
+            std::vector<ScaRun> process = readScaFile(scalarFile(processDir, configName, runNumber));
+            if (inProcess.size() != 1 || process.size() != 1)
+                problems.push_back("expected one run per file");
+            else if (process[0].scalars.empty())
+                problems.push_back("no scalars in the process run");
+            else {
+                for (const auto& scalar : process[0].scalars) {
+                    std::string name = scalar.first.first + "." + scalar.first.second;
+                    auto it = inProcess[0].scalars.find(scalar.first);
+                    if (it == inProcess[0].scalars.end())
+                        problems.push_back(name + " missing");
+                    else if (!(std::fabs(it->second - scalar.second) <= 1e-12 * std::max(std::fabs(it->second), std::fabs(scalar.second))))
+                        problems.push_back(name + " " + std::to_string(it->second) + " vs " + std::to_string(scalar.second));
+                }
+            }
+        }
+        catch (std::exception& e) {
+            problems.push_back(e.what());
+        }
+        if (problems.empty())
+            continue;
+        differing++;
+        std::string more = problems.size() > 1 ? " and " + std::to_string(problems.size() - 1) + " more" : "";
+        fprintf(stderr, "replicate: run %d differs from its process run: %s%s\n", runNumber, problems[0].c_str(),
+                more.c_str());
+    }
+    return differing;
+}
+
+// Runs first..runs-1 on jobs threads; returns the number of failed runs
+template <class Run>
+static int runAll(int first, int runs, int jobs, Run run)
+{
+    std::atomic<int> next(first);
+    std::atomic<int> failed(0);
+    auto worker = [&]() {
+        for (int runNumber; (runNumber = next++) < runs; ) {
+            RunOutcome outcome = run(runNumber);
+            if (!outcome.ok) {
+                fprintf(stderr, "replicate: run %d: %s\n", runNumber, outcome.error.c_str());
+                failed++;
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 0; i < jobs; i++)
+        threads.emplace_back(worker);
+    for (std::thread& thread : threads)
+        thread.join();
+    return failed;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void usage()
+{
+    fprintf(stderr, "Usage: replicate [-c config] [-f inifile] [-n ned-path] [-r runs] [-j threads] [-d resultDir] [-x command]\n");
+}
+
+int main(int argc, char **argv)
+{
+    cStaticFlag dummy;  // must be first in main()
+
+    std::string configName = "LowLoad";
+    std::string iniFile = "omnetpp.ini";
+    std::string nedPath = ".";
+    std::string resultDir = "results/replicate";
+    std::string command;
+    int runs = -1;
+    int jobs = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2) {
+            usage();
+            return 1;
+        }
+        const char *value = argv[++i];
+        switch (argv[i - 1][1]) {
+            case 'c': configName = value; break;
+            case 'f': iniFile = value; break;
+            case 'n': nedPath = value; break;
+            case 'r': runs = atoi(value); break;
+            case 'j': jobs = std::max(1, atoi(value)); break;
+            case 'd': resultDir = value; break;
+            case 'x': command = value; break;
+            default: usage(); return 1;
+        }
+    }
+
+    try {
+        auto start = std::chrono::steady_clock::now();
+        CodeFragments::executeAll(CodeFragments::STARTUP);
+        SimTime::setScaleExp(-12);
+        cSimulation::loadNedSourceFolder(nedPath.c_str());
+        cSimulation::doneLoadingNedFiles();
+        InifileReader ini;
+        ini.readFile(iniFile.c_str());
+        {
+            SectionBasedConfiguration probe;
+            probe.setConfigurationReader(new SharedIni(ini));
+            int available = probe.getNumRunsInConfig(configName.c_str());
+            if (available <= 0)
+                throw std::runtime_error("no runs in config " + configName);
+            runs = runs < 0 ? available : std::min(runs, available);
+        }
+        if (runs < 1 || system(("mkdir -p '" + resultDir + "'").c_str()) != 0)
+            throw std::runtime_error("cannot create " + resultDir);
+        double startup = secondsSince(start);
+
+        // The first run registers everything shared, then the rest go in parallel
+        auto runStart = std::chrono::steady_clock::now();
+        auto inProcess = [&](int runNumber) { return runInProcess(ini, configName, runNumber, resultDir); };
+        int failed = runAll(0, 1, 1, inProcess);
+        failed += runAll(1, runs, jobs, inProcess);
+        double threaded = secondsSince(runStart);
+        printf("config %s: %d runs, %d threads\n", configName.c_str(), runs, jobs);
+        printf("in-process: NED and ini loaded in %.3fs, runs in %.3fs: %.1f runs/s (%.1f with loading)\n", startup,
+               threaded, runs / threaded, runs / (startup + threaded));
+
+        if (!command.empty()) {
+            std::string processDir = resultDir + "/processes";
+            if (system(("mkdir -p '" + processDir + "'").c_str()) != 0)
+                throw std::runtime_error("cannot create " + processDir);
+            auto processStart = std::chrono::steady_clock::now();
+            failed += runAll(0, runs, jobs, [&](int runNumber) {
+                return runAsProcess(command, configName, runNumber, processDir);
+            });
+            double processes = secondsSince(processStart);
+            printf("processes:  runs in %.3fs: %.1f runs/s (@statistic recorders and vectors off, as in-process)\n",
+                   processes, runs / processes);
+            printf("in-process speedup: %.2fx (%.2fx with loading)\n", processes / threaded, processes / (startup + threaded));
+            int differing = compareScalars(resultDir, processDir, configName, runs);
+            printf("scalars: %d of %d runs equal to their process run\n", runs - differing, runs);
+            failed += differing;
+        }
+        CodeFragments::executeAll(CodeFragments::SHUTDOWN);
+        return failed > 0 ? 1 : 0;
+    }
+    catch (std::exception& e) {
+        fprintf(stderr, "replicate: %s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,349 @@
+//
+// screen - multi-fidelity screening of a scenario set against a service
+// level: is the mean waiting time of each candidate at most the threshold?
+//
+// Stage 0 evaluates every candidate with a queueing approximation
+// (Pollaczek-Khinchine for random routing, Kingman with the
+// Kraemer/Langenbach-Belzen correction and Erlang inter-arrival times for
+// round robin, Allen-Cunneen M/G/c for shortest queue). Stage 1 is a short
+// truncated run, stage 2 the full-length run. A candidate moves on to the
+// next stage only if its estimate is within the error band of the stage
+// around the threshold,
+//
+//     |log(estimate / threshold)| < band
+//
+// where estimates below a tenth of the threshold are raised to it.
+// The bands come from a random calibration sample of candidates that runs
+// through all stages: band = margin * the largest log discrepancy between
+// the stage and the full run in the sample. The CPU time (including child
+// processes) of every stage is reported, together with the estimated cost
+// of running every candidate at full length.
+//
+// Candidates are the rows of a doe design file (see DesignTable.h). With -x,
+// the runs execute the simulation with --name=value options; the short runs
+// add --sim-time-limit. The response is a scalar of the network module (or
+// -M). Without -x, the store replica (StoreReplica.h) runs in-process with
+// -S and -T as its horizons. The approximation needs the replica parameters
+// (arrivalInterval, numCashiers, strategy, speedFactor); for other
+// parameters, stage 0 is skipped.
+//
+// Usage: screen candidates.csv -t threshold [-x command] [-d dir] [-M module] [-r response]
+//               [-S shortTime] [-T fullTime] [-w warmup] [-k calibration] [-m margin] [-j jobs] [-s seed]
+//
+
+#include <sys/resource.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "DesignTable.h"
+#include "ScaFile.h"
+#include "StoreReplica.h"
+
+struct Settings
+{
+    double threshold = 0;
+    std::string command;
+    std::string resultDir = "screen-results";
+    std::string module;
+    std::string response = "storeWaitingTime:mean";
+    double shortTime = 5000;
+    double fullTime = 200000;
+    double warmup = 1000;
+    int calibration = 10;
+    double margin = 1.5;
+    int jobs = 0;
+    uint64_t seed = 1;
+};
+
+enum { ANALYTIC, SHORT, FULL, NUM_STAGES };
+static const char *stageNames[NUM_STAGES] = {"analytic", "short", "full"};
+
+// Mean waiting time in queue; infinite if a cashier is overloaded
+static double approximateMeanWait(const ReplicaConfig& config)
+{
+    double meanItems = (config.minItems + config.maxItems) / 2.0;
+    double itemsSpan = config.maxItems - config.minItems + 1;
+    double varItems = (itemsSpan * itemsSpan - 1) / 12;
+    double meanItemTime = (config.minItemTime + config.maxItemTime) / 2;
+    double varItemTime = (config.maxItemTime - config.minItemTime) * (config.maxItemTime - config.minItemTime) / 12;
+    double meanService = config.speedFactor * meanItems * meanItemTime;
+    double varService = config.speedFactor * config.speedFactor * (meanItems * varItemTime + varItems * meanItemTime * meanItemTime);
+    double scv = varService / (meanService * meanService);
+
+    int c = config.numCashiers;
+    double offered = meanService / config.arrivalInterval;
+    double rho = offered / c;
+    if (rho >= 1)
+        return INFINITY;
+
+    switch (config.strategy) {
+        case 1: {  // one queue per cashier, joined by shortest queue: close to M/G/c
+            double erlangB = 1;
+            for (int k = 1; k <= c; k++)
+                erlangB = offered * erlangB / (k + offered * erlangB);
+            double erlangC = erlangB / (1 - rho * (1 - erlangB));
+            return erlangC * meanService / (c * (1 - rho)) * (1 + scv) / 2;
+        }
+        case 2:  // Poisson splitting: M/G/1 per cashier
+            return rho * meanService * (1 + scv) / (2 * (1 - rho));
+        default: {  // every c-th arrival: Erlang-c inter-arrival times, scv 1/c
+            double arrivalScv = 1.0 / c;
+            double correction = std::exp(-2 * (1 - rho) * (1 - arrivalScv) * (1 - arrivalScv) / (3 * rho * (arrivalScv + scv)));
+            return correction * rho / (1 - rho) * meanService * (arrivalScv + scv) / 2;
+        }
+    }
+}
+
+// Process CPU seconds, including finished child processes
+static double cpuSeconds()
+{
+    double seconds = 0;
+    for (int who : {RUSAGE_SELF, RUSAGE_CHILDREN}) {
+        rusage usage;
+        getrusage(who, &usage);
+        seconds += usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+    }
+    return seconds;
+}
+
+static double evaluate(const Settings& settings, const Table& table, size_t candidate, int stage)
+{
+    const std::vector<std::string>& row = table.rows[candidate];
+    if (stage == ANALYTIC)
+        return approximateMeanWait(replicaConfig(table.parameters, row));
+
+    if (!settings.command.empty()) {
+        std::string dir = settings.resultDir + "/" + stageNames[stage] + std::to_string(candidate);
+        std::string command = settings.command;
+        for (size_t k = 0; k < table.parameters.size(); k++)
+            command += " '--" + table.parameters[k].name + "=" + row[k] + "'";
+        if (stage == SHORT)
+            command += " --sim-time-limit=" + std::to_string(settings.shortTime) + "s";
+        command += " '--result-dir=" + dir + "' > '" + dir + ".log' 2>&1";
+        if (system(("mkdir -p '" + dir + "'").c_str()) != 0 || system(command.c_str()) != 0)
+            throw std::runtime_error("run failed, see " + dir + ".log");
+        for (const ScaRun& run : readScaDirectory(dir)) {
+            double response;
+            if (run.findScalar(settings.module, settings.response, response))
+                return response;
+        }
+        throw std::runtime_error("no scalar " + settings.response + " in " + dir);
+    }
+
+    double simTime = stage == SHORT ? settings.shortTime : settings.fullTime;
+    double warmup = std::min(settings.warmup, simTime / 10);
+    ReplicaConfig config = replicaConfig(table.parameters, row);
+    StoreReplica replica(config, settings.seed * 1000003 + candidate);
+    StoreReplica::Arrival arrival;
+    double sum = 0;
+    long count = 0;
+    while (replica.nextEventTime() < simTime) {
+        if (replica.step(&arrival) == StoreReplica::ARRIVAL && replica.getTime() >= warmup) {
+            sum += arrival.waitingTime;
+            count++;
+        }
+    }
+    return count > 0 ? sum / count : 0;
+}
+
+// Evaluates the given candidates at one stage in parallel; returns the CPU time
+static double evaluateAll(const Settings& settings, const Table& table, const std::vector<size_t>& candidates,
+                          int stage, std::vector<std::vector<double>>& estimates)
+{
+    double start = cpuSeconds();
+    std::atomic<size_t> next(0);
+    std::mutex errorMutex;
+    std::string error;
+    auto worker = [&]() {
+        for (size_t i; (i = next++) < candidates.size(); ) {
+            try {
+                estimates[candidates[i]][stage] = evaluate(settings, table, candidates[i], stage);
+            }
+            catch (std::exception& e) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                error = e.what();
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    int jobs = stage == ANALYTIC ? 1 : settings.jobs;
+    for (int j = 0; j < jobs; j++)
+        threads.emplace_back(worker);
+    for (std::thread& thread : threads)
+        thread.join();
+    if (!error.empty())
+        throw std::runtime_error(error);
+    return cpuSeconds() - start;
+}
+
+// Distance on a log scale; waits below a tenth of the threshold all count
+// as equal, so their (large but irrelevant) relative errors do not widen
+// the bands
+static double logDistance(double estimate, double reference, double threshold)
+{
+    if (std::isinf(estimate) || std::isinf(reference))
+        return estimate == reference ? 0 : INFINITY;
+    double floor = threshold / 10;
+    return std::fabs(std::log(std::max(estimate, floor) / std::max(reference, floor)));
+}
+
+static void usage()
+{
+    fprintf(stderr, "Usage: screen candidates.csv -t threshold [-x command] [-d dir] [-M module] [-r response]\n"
+                    "              [-S shortTime] [-T fullTime] [-w warmup] [-k calibration] [-m margin] [-j jobs] [-s seed]\n");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || argv[1][0] == '-') {
+        usage();
+        return 1;
+    }
+    Settings settings;
+    for (int i = 2; i < argc; i++) {
+        if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2) {
+            usage();
+            return 1;
+        }
+        std::string value = argv[++i];
+        switch (argv[i - 1][1]) {
+            case 't': settings.threshold = atof(value.c_str()); break;
+            case 'x': settings.command = value; break;
+            case 'd': settings.resultDir = value; break;
+            case 'M': settings.module = value; break;
+            case 'r': settings.response = value; break;
+            case 'S': settings.shortTime = atof(value.c_str()); break;
+            case 'T': settings.fullTime = atof(value.c_str()); break;
+            case 'w': settings.warmup = atof(value.c_str()); break;
+            case 'k': settings.calibration = atoi(value.c_str()); break;
+            case 'm': settings.margin = atof(value.c_str()); break;
+            case 'j': settings.jobs = atoi(value.c_str()); break;
+            case 's': settings.seed = strtoull(value.c_str(), nullptr, 10); break;
+            default: usage(); return 1;
+        }
+    }
+    if (settings.threshold <= 0 || settings.calibration < 2) {
+        usage();
+        return 1;
+    }
+    if (settings.jobs <= 0)
+        settings.jobs = std::max(1u, std::thread::hardware_concurrency());
+
+    try {
+        Table table;
+        table.read(argv[1]);
+        size_t n = table.rows.size();
+        size_t d = table.parameters.size();
+
+        bool haveApproximation = true;
+        try {
+            for (const auto& row : table.rows)
+                replicaConfig(table.parameters, row);
+        }
+        catch (std::exception&) {
+            haveApproximation = false;
+        }
+        if (settings.command.empty() && !haveApproximation)
+            throw std::runtime_error("the replica only knows arrivalInterval, numCashiers, strategy and speedFactor, use -x");
+
+        // Calibration sample: random candidates that run through all stages
+        ReplicaRng rng(settings.seed);
+        std::vector<size_t> order(n);
+        for (size_t i = 0; i < n; i++)
+            order[i] = i;
+        for (size_t i = n; i-- > 1; )
+            std::swap(order[i], order[rng.intuniform(0, (int)i)]);
+        std::vector<size_t> calibration(order.begin(), order.begin() + std::min(n, (size_t)settings.calibration));
+        std::vector<bool> inCalibration(n, false);
+        for (size_t i : calibration)
+            inCalibration[i] = true;
+
+        std::vector<std::vector<double>> estimates(n, std::vector<double>(NUM_STAGES, NAN));
+        std::vector<int> decidedAt(n, -1);
+        std::vector<double> cpu(NUM_STAGES, 0.0);
+        std::vector<size_t> evaluated(NUM_STAGES, 0);
+        std::vector<double> bands(NUM_STAGES, 0.0);
+
+        int firstStage = haveApproximation ? ANALYTIC : SHORT;
+        std::vector<size_t> all(order.begin(), order.end());
+        if (haveApproximation) {
+            cpu[ANALYTIC] += evaluateAll(settings, table, all, ANALYTIC, estimates);
+            evaluated[ANALYTIC] = n;
+        }
+        for (int stage = SHORT; stage <= FULL; stage++) {
+            cpu[stage] += evaluateAll(settings, table, calibration, stage, estimates);
+            evaluated[stage] += calibration.size();
+        }
+        for (int stage = firstStage; stage < FULL; stage++) {
+            double worst = 0;
+            for (size_t i : calibration)
+                worst = std::max(worst, logDistance(estimates[i][stage], estimates[i][FULL], settings.threshold));
+            bands[stage] = settings.margin * worst;
+        }
+        bands[FULL] = 0;
+        for (size_t i : calibration)
+            decidedAt[i] = FULL;
+
+        // Screening: decide what is clear, promote the rest
+        std::vector<size_t> pending;
+        for (size_t i : all)
+            if (!inCalibration[i])
+                pending.push_back(i);
+        for (int stage = firstStage; stage <= FULL; stage++) {
+            if (stage != ANALYTIC && !pending.empty()) {
+                cpu[stage] += evaluateAll(settings, table, pending, stage, estimates);
+                evaluated[stage] += pending.size();
+            }
+            std::vector<size_t> promoted;
+            for (size_t i : pending) {
+                if (stage == FULL || logDistance(estimates[i][stage], settings.threshold, settings.threshold) >= bands[stage])
+                    decidedAt[i] = stage;
+                else
+                    promoted.push_back(i);
+            }
+            pending = promoted;
+        }
+
+        // Candidates with estimates and decisions
+        for (const Parameter& p : table.parameters)
+            printf("#param %s\n", p.spec.c_str());
+        for (size_t k = 0; k < d; k++)
+            printf("%s,", table.columns[k].c_str());
+        printf("analytic,short,full,stage,meetsThreshold\n");
+        for (size_t i = 0; i < n; i++) {
+            for (size_t k = 0; k < d; k++)
+                printf("%s,", table.rows[i][k].c_str());
+            for (int stage = 0; stage < NUM_STAGES; stage++) {
+                if (!std::isnan(estimates[i][stage]))
+                    printf("%.6g", estimates[i][stage]);
+                printf(",");
+            }
+            double decisive = estimates[i][decidedAt[i]];
+            printf("%s,%d\n", stageNames[decidedAt[i]], decisive <= settings.threshold ? 1 : 0);
+        }
+
+        fprintf(stderr, "threshold %gs, %zu candidates, %zu for calibration\n", settings.threshold, n, calibration.size());
+        fprintf(stderr, "%-10s %10s %10s %10s %12s\n", "stage", "band", "evaluated", "decided", "cpuSeconds");
+        for (int stage = firstStage; stage < NUM_STAGES; stage++) {
+            size_t decided = std::count(decidedAt.begin(), decidedAt.end(), stage);
+            fprintf(stderr, "%-10s %10.3g %10zu %10zu %12.3f\n", stageNames[stage], bands[stage], evaluated[stage],
+                    decided, cpu[stage]);
+        }
+        double total = cpu[ANALYTIC] + cpu[SHORT] + cpu[FULL];
+        double allFull = evaluated[FULL] > 0 ? cpu[FULL] / evaluated[FULL] * n : 0;
+        fprintf(stderr, "total %.3f cpu seconds, all candidates at full length about %.3f (%.1fx)\n", total, allFull,
+                total > 0 ? allFull / total : 0);
+    }
+    catch (std::exception& e) {
+        fprintf(stderr, "screen: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,293 @@
+//
+// splitting - RESTART multilevel splitting estimate of the tail probability
+// P(waiting time > t) of one store, using the copyable replica in
+// StoreReplica.h
+//
+// The importance function is the total number of customers in the store.
+// Whenever a trajectory crosses threshold L_j upwards, it is cloned into R_j
+// trajectories (R_j - 1 retrials with fresh random streams). A retrial born
+// at level j is killed as soon as the store drops below L_j again. An
+// arrival that has to wait longer than t counts with weight 1 / (R_1 ... R_k),
+// where k is the level of the store when the customer arrives; the
+// denominator is the number of arrivals of the main trajectory. This keeps
+// the estimate unbiased. Independent replications give the relative error, and
+// a crude Monte Carlo run with the same CPU budget gives the efficiency gain.
+//
+// Without -r, the splitting factors come from a crude pilot run: R_j is the
+// inverse of P(Q >= L_{j+1} | Q >= L_j), which keeps the number of
+// trajectories per level about constant.
+//
+// Usage: splitting [-a arrivalInterval] [-c cashiers] [-b strategy] [-f speedFactor]
+//                  [-t waitThreshold] [-l L1,L2,...] [-r R | -r R1,R2,...]
+//                  [-n mainArrivals] [-k replications] [-p pilotArrivals] [-s seed]
+//
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "StoreReplica.h"
+
+struct SplittingSetup
+{
+    double waitThreshold;
+    std::vector<int> thresholds;   // importance thresholds L_1 < L_2 < ...
+    std::vector<int> splits;       // R_1, R_2, ...
+    std::vector<double> weights;   // 1 / (R_1 ... R_k) for level k = 0..m
+    double endTime;
+};
+
+struct SplittingResult
+{
+    double weightedEvents = 0;
+    long mainArrivals = 0;
+    long trajectories = 0;
+    long events = 0;  // simulated events over all trajectories
+};
+
+static int levelOf(const SplittingSetup& setup, int customersInSystem)
+{
+    int level = 0;
+    while (level < (int)setup.thresholds.size() && customersInSystem >= setup.thresholds[level])
+        level++;
+    return level;
+}
+
+// Runs one trajectory until the end time or until it falls below its birth
+// level; retrials are run depth first
+static void runTrajectory(StoreReplica replica, int birthLevel, const SplittingSetup& setup,
+                          ReplicaRng& seeder, SplittingResult& result)
+{
+    result.trajectories++;
+    int level = levelOf(setup, replica.getCustomersInSystem());
+    while (replica.nextEventTime() < setup.endTime) {
+        StoreReplica::Arrival arrival;
+        StoreReplica::EventKind kind = replica.step(&arrival);
+        result.events++;
+        if (kind == StoreReplica::ARRIVAL) {
+            if (birthLevel == 0)
+                result.mainArrivals++;
+            if (arrival.waitingTime > setup.waitThreshold)
+                result.weightedEvents += setup.weights[level];  // level before the arrival
+        }
+
+        int newLevel = levelOf(setup, replica.getCustomersInSystem());
+        if (newLevel < birthLevel)
+            return;  // retrial leaves its region: killed
+        if (newLevel > level) {
+            for (int i = 1; i < setup.splits[newLevel - 1]; i++) {
+                StoreReplica retrial = replica;
+                retrial.getRng().seed(seeder.next());
+                runTrajectory(retrial, newLevel, setup, seeder, result);
+            }
+        }
+        level = newLevel;
+    }
+}
+
+// Pilot: crude run that records the queue length seen by arrivals. The
+// factor at L_j is the inverse of the conditional probability of the next
+// level, P(Q >= L_{j+1}) / P(Q >= L_j) (Villen-Altamirano's guideline). Levels
+// beyond the observed range use the geometric decay of the observed tail.
+static std::vector<int> pilotSplits(const ReplicaConfig& config, const SplittingSetup& setup,
+                                    long arrivals, ReplicaRng& seeder)
+{
+    const double minCount = 100;
+    std::vector<double> seen;  // seen[n] = arrivals that found n customers
+    StoreReplica replica(config, seeder.next());
+    for (long i = 0; i < arrivals; ) {
+        int customers = replica.getCustomersInSystem();
+        if (replica.step() == StoreReplica::ARRIVAL) {
+            if (customers >= (int)seen.size())
+                seen.resize(customers + 1, 0);
+            seen[customers]++;
+            i++;
+        }
+    }
+
+    // tail[n] = arrivals that found at least n customers
+    std::vector<double> tail(seen.size() + 1, 0);
+    for (int n = (int)seen.size() - 1; n >= 0; n--)
+        tail[n] = tail[n + 1] + seen[n];
+    int reliable = 0;
+    while (reliable + 1 < (int)tail.size() && tail[reliable + 1] >= minCount)
+        reliable++;
+    double decay = reliable > 1 ? std::log(tail[reliable / 2] / tail[reliable]) / (reliable - reliable / 2) : std::log(2.0);
+
+    auto logTail = [&](int n) {
+        return n <= reliable ? std::log(tail[n]) : std::log(tail[reliable]) - decay * (n - reliable);
+    };
+
+    std::vector<int> splits;
+    size_t m = setup.thresholds.size();
+    for (size_t j = 0; j < m; j++) {
+        int gap = j + 1 < m ? setup.thresholds[j + 1] - setup.thresholds[j]
+                            : (j > 0 ? setup.thresholds[j] - setup.thresholds[j - 1] : setup.thresholds[j]);
+        double ratio = std::exp(logTail(setup.thresholds[j] + gap) - logTail(setup.thresholds[j]));
+        splits.push_back(std::max(1, (int)std::lround(1 / ratio)));
+    }
+    return splits;
+}
+
+static std::vector<int> parseList(const char *text)
+{
+    std::vector<int> values;
+    std::stringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ','))
+        values.push_back(atoi(item.c_str()));
+    return values;
+}
+
+static void summarize(const std::vector<double>& estimates, double& mean, double& relativeError)
+{
+    size_t k = estimates.size();
+    mean = 0;
+    for (double p : estimates)
+        mean += p / k;
+    double variance = 0;
+    for (double p : estimates)
+        variance += (p - mean) * (p - mean) / (k - 1);
+    relativeError = mean > 0 ? std::sqrt(variance / k) / mean : NAN;
+}
+
+static void usage()
+{
+    fprintf(stderr, "Usage: splitting [-a arrivalInterval] [-c cashiers] [-b strategy] [-f speedFactor]\n"
+                    "                 [-t waitThreshold] [-l L1,L2,...] [-r R | -r R1,R2,...]\n"
+                    "                 [-n mainArrivals] [-k replications] [-p pilotArrivals] [-s seed]\n");
+}
+
+int main(int argc, char **argv)
+{
+    ReplicaConfig config;
+    config.arrivalInterval = 4.6;  // load 0.88 with 4 cashiers
+    config.strategy = 1;
+    SplittingSetup setup;
+    setup.waitThreshold = 600;
+    std::vector<int> splits;
+    long mainArrivals = 100000;
+    int replications = 10;
+    long pilotArrivals = 1000000;
+    uint64_t seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2) {
+            usage();
+            return 1;
+        }
+        const char *value = argv[++i];
+        switch (argv[i - 1][1]) {
+            case 'a': config.arrivalInterval = atof(value); break;
+            case 'c': config.numCashiers = atoi(value); break;
+            case 'b': config.strategy = atoi(value); break;
+            case 'f': config.speedFactor = atof(value); break;
+            case 't': setup.waitThreshold = atof(value); break;
+            case 'l': setup.thresholds = parseList(value); break;
+            case 'r': splits = parseList(value); break;
+            case 'n': mainArrivals = atol(value); break;
+            case 'k': replications = atoi(value); break;
+            case 'p': pilotArrivals = atol(value); break;
+            case 's': seed = strtoull(value, nullptr, 10); break;
+            default: usage(); return 1;
+        }
+    }
+    if (config.numCashiers < 1 || config.arrivalInterval <= 0 || replications < 2 || mainArrivals < 1) {
+        usage();
+        return 1;
+    }
+
+    // Default levels: one per cashier's worth of customers, from three per
+    // cashier up to the queue length at which a customer waits about t
+    if (setup.thresholds.empty()) {
+        int c = config.numCashiers;
+        int top = (int)(c * setup.waitThreshold / config.meanServiceTime());
+        for (int level = 3 * c; level <= top; level += c)
+            setup.thresholds.push_back(level);
+    }
+    for (size_t j = 1; j < setup.thresholds.size(); j++) {
+        if (setup.thresholds[j] <= setup.thresholds[j - 1]) {
+            fprintf(stderr, "splitting: thresholds must be increasing\n");
+            return 1;
+        }
+    }
+    setup.endTime = mainArrivals * config.arrivalInterval;
+
+    ReplicaRng seeder(seed);
+    if (splits.empty())
+        splits = setup.thresholds.empty() ? std::vector<int>{1} : pilotSplits(config, setup, pilotArrivals, seeder);
+    for (size_t j = 0; j < setup.thresholds.size(); j++) {
+        int r = j < splits.size() ? splits[j] : splits.back();
+        setup.splits.push_back(std::max(1, r));
+    }
+    setup.weights.push_back(1.0);
+    for (int r : setup.splits)
+        setup.weights.push_back(setup.weights.back() / r);
+
+    printf("P(wait > %gs), %d cashiers, arrival interval %gs, strategy %d, load %.3f\n",
+           setup.waitThreshold, config.numCashiers, config.arrivalInterval, config.strategy,
+           config.meanServiceTime() / (config.numCashiers * config.arrivalInterval));
+    printf("levels:");
+    for (size_t j = 0; j < setup.thresholds.size(); j++)
+        printf(" %d(x%d)", setup.thresholds[j], setup.splits[j]);
+    printf("\n");
+
+    // RESTART
+    std::vector<double> estimates;
+    long totalEvents = 0, totalTrajectories = 0;
+    clock_t start = clock();
+    for (int k = 0; k < replications; k++) {
+        SplittingResult result;
+        runTrajectory(StoreReplica(config, seeder.next()), 0, setup, seeder, result);
+        estimates.push_back(result.mainArrivals > 0 ? result.weightedEvents / result.mainArrivals : 0);
+        totalEvents += result.events;
+        totalTrajectories += result.trajectories;
+    }
+    double splittingTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+    double splittingMean, splittingError;
+    summarize(estimates, splittingMean, splittingError);
+
+    // Crude Monte Carlo with the same CPU budget
+    std::vector<double> crudeEstimates;
+    long crudeArrivals = 0, crudeHits = 0;
+    start = clock();
+    double crudeTime = 0;
+    while (crudeEstimates.size() < 2 || crudeTime < splittingTime) {
+        StoreReplica replica(config, seeder.next());
+        long arrivals = 0, hits = 0;
+        StoreReplica::Arrival arrival;
+        while (arrivals < mainArrivals) {
+            if (replica.step(&arrival) == StoreReplica::ARRIVAL) {
+                arrivals++;
+                if (arrival.waitingTime > setup.waitThreshold)
+                    hits++;
+            }
+        }
+        crudeEstimates.push_back((double)hits / arrivals);
+        crudeArrivals += arrivals;
+        crudeHits += hits;
+        crudeTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+    }
+    double crudeMean, crudeError;
+    summarize(crudeEstimates, crudeMean, crudeError);
+
+    printf("%-10s %14s %10s %12s %10s %14s\n", "method", "estimate", "relError", "cpuSeconds", "runs", "events");
+    printf("%-10s %14.6g %10.4g %12.3f %10d %14ld\n", "RESTART", splittingMean, splittingError, splittingTime,
+           replications, totalEvents);
+    printf("%-10s %14.6g %10.4g %12.3f %10d %14ld\n", "crude", crudeMean, crudeError, crudeTime,
+           (int)crudeEstimates.size(), crudeArrivals);
+    printf("retrials: %ld\n", totalTrajectories - replications);
+
+    // Work-normalized efficiency gain; without crude hits, the binomial
+    // relative error of the crude estimator at the RESTART estimate stands in
+    bool binomial = crudeHits == 0 || !(crudeError > 0);
+    double crudeRelativeVariance = binomial ? (1 - splittingMean) / (splittingMean * crudeArrivals)
+                                            : crudeError * crudeError;
+    double gain = crudeRelativeVariance * crudeTime / (splittingError * splittingError * splittingTime);
+    printf("efficiency gain: %.3g%s\n", gain, binomial ? " (crude saw no events, binomial estimate)" : "");
+    return 0;
+}
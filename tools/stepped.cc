@@ -0,0 +1,197 @@
+//
+// stepped - error and speedup of the time-stepped store (SteppedEngine.h)
+// against the exact event-driven store replica (StoreReplica.h), as the
+// step grows
+//
+// Both run -r replications of -T seconds. Per step size, it prints the mean
+// waiting time, the cashier utilization and the time-averaged customers
+// waiting per lane, each with its relative error to the exact run (and the
+// standard error of that difference), the CPU time and the speedup, then a
+// chart of speedup and largest error over the step. The exact lane length
+// comes from Little's law (arrival rate per lane times the mean wait).
+//
+// Usage: stepped [-d step,step,...] [-r replications] [-T simTime]
+//                [-a arrivalInterval] [-c cashiers] [-b strategy] [-f speedFactor] [-s seed]
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../SteppedEngine.h"
+#include "StoreReplica.h"
+
+struct Estimates
+{
+    std::vector<double> meanWait, utilization, waiting;  // per replication
+    double cpuSeconds = 0;
+};
+
+static double cpuNow()
+{
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+static Estimates runExact(const ReplicaConfig& config, double simTime, int replications, uint64_t seed)
+{
+    Estimates estimates;
+    double start = cpuNow();
+    for (int r = 0; r < replications; r++) {
+        StoreReplica replica(config, seed * 1000003 + r);
+        StoreReplica::Arrival arrival;
+        long arrivals = 0;
+        double waitSum = 0, serviceSum = 0;
+        while (replica.nextEventTime() < simTime) {
+            if (replica.step(&arrival) == StoreReplica::ARRIVAL) {
+                arrivals++;
+                waitSum += arrival.waitingTime;
+                serviceSum += arrival.serviceTime;
+            }
+        }
+        double meanWait = arrivals > 0 ? waitSum / arrivals : 0;
+        estimates.meanWait.push_back(meanWait);
+        estimates.utilization.push_back(serviceSum / (simTime * config.numCashiers));
+        estimates.waiting.push_back(arrivals / simTime * meanWait / config.numCashiers);
+    }
+    estimates.cpuSeconds = cpuNow() - start;
+    return estimates;
+}
+
+static Estimates runStepped(const SteppedConfig& config, double simTime, int replications, uint64_t seed)
+{
+    Estimates estimates;
+    double start = cpuNow();
+    for (int r = 0; r < replications; r++) {
+        ReplicaRng rng(seed * 1000003 + r + 500000);
+        SteppedEngine<ReplicaRng> engine(config, rng);
+        while (engine.getTime() + config.timeStep <= simTime + 1e-9)
+            engine.step([](int, double, double) {});
+        const auto& statistics = engine.getStatistics();
+        double time = engine.getTime();
+        estimates.meanWait.push_back(statistics.arrivals > 0 ? statistics.waitSum / statistics.arrivals : 0);
+        estimates.utilization.push_back(statistics.serviceSum / (time * config.numCashiers));
+        estimates.waiting.push_back(statistics.waitingCustomerTime / (time * config.numCashiers));
+    }
+    estimates.cpuSeconds = cpuNow() - start;
+    return estimates;
+}
+
+static void meanAndVariance(const std::vector<double>& values, double& mean, double& varianceOfMean)
+{
+    mean = 0;
+    for (double v : values)
+        mean += v;
+    mean /= values.size();
+    double squares = 0;
+    for (double v : values)
+        squares += (v - mean) * (v - mean);
+    varianceOfMean = values.size() > 1 ? squares / (values.size() - 1) / values.size() : 0;
+}
+
+// Relative error of the stepped mean to the exact mean, in percent, and its standard error
+static void relativeError(const std::vector<double>& stepped, const std::vector<double>& exact, double& error, double& standardError)
+{
+    double mean, variance, exactMean, exactVariance;
+    meanAndVariance(stepped, mean, variance);
+    meanAndVariance(exact, exactMean, exactVariance);
+    error = exactMean != 0 ? 100 * (mean - exactMean) / exactMean : 0;
+    standardError = exactMean != 0 ? 100 * std::sqrt(variance + exactVariance) / std::fabs(exactMean) : 0;
+}
+
+static void usage()
+{
+    fprintf(stderr, "Usage: stepped [-d step,step,...] [-r replications] [-T simTime]\n"
+                    "               [-a arrivalInterval] [-c cashiers] [-b strategy] [-f speedFactor] [-s seed]\n");
+}
+
+int main(int argc, char **argv)
+{
+    ReplicaConfig replica;
+    replica.arrivalInterval = 5;  // load 0.81 with 4 cashiers
+    std::vector<double> steps = {0.25, 0.5, 1, 2, 5, 10, 20, 60};
+    int replications = 10;
+    double simTime = 200000;
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2) {
+            usage();
+            return 1;
+        }
+        const char *value = argv[++i];
+        switch (argv[i - 1][1]) {
+            case 'd': {
+                steps.clear();
+                std::stringstream in(value);
+                std::string item;
+                while (std::getline(in, item, ','))
+                    steps.push_back(atof(item.c_str()));
+                break;
+            }
+            case 'r': replications = atoi(value); break;
+            case 'T': simTime = atof(value); break;
+            case 'a': replica.arrivalInterval = atof(value); break;
+            case 'c': replica.numCashiers = atoi(value); break;
+            case 'b': replica.strategy = atoi(value); break;
+            case 'f': replica.speedFactor = atof(value); break;
+            case 's': seed = strtoull(value, nullptr, 10); break;
+            default: usage(); return 1;
+        }
+    }
+    if (steps.empty() || replications < 2 || simTime <= 0 || replica.numCashiers < 1 ||
+        std::any_of(steps.begin(), steps.end(), [](double step) { return !(step > 0); })) {
+        usage();
+        return 1;
+    }
+
+    Estimates exact = runExact(replica, simTime, replications, seed);
+    double exactWait, exactUtilization, exactWaiting, variance;
+    meanAndVariance(exact.meanWait, exactWait, variance);
+    meanAndVariance(exact.utilization, exactUtilization, variance);
+    meanAndVariance(exact.waiting, exactWaiting, variance);
+    printf("store: %d cashiers, arrival interval %gs, strategy %d, speed factor %g; %d replications of %gs\n",
+           replica.numCashiers, replica.arrivalInterval, replica.strategy, replica.speedFactor, replications, simTime);
+    printf("exact: mean wait %.3fs, utilization %.4f, waiting per lane %.4f, %.3f CPU s\n\n", exactWait,
+           exactUtilization, exactWaiting, exact.cpuSeconds);
+    printf("%8s %10s %8s %6s %8s %6s %8s %6s %9s %8s\n", "step", "meanWait", "err%", "+-", "util err%", "+-",
+           "Lq err%", "+-", "CPU s", "speedup");
+
+    std::vector<double> speedups, worstErrors;
+    for (double step : steps) {
+        SteppedConfig config;
+        config.numCashiers = replica.numCashiers;
+        config.arrivalInterval = replica.arrivalInterval;
+        config.strategy = replica.strategy;
+        config.speedFactor = replica.speedFactor;
+        config.timeStep = step;
+        Estimates stepped = runStepped(config, simTime, replications, seed);
+
+        double meanWait, waitError, waitSe, utilizationError, utilizationSe, waitingError, waitingSe;
+        meanAndVariance(stepped.meanWait, meanWait, variance);
+        relativeError(stepped.meanWait, exact.meanWait, waitError, waitSe);
+        relativeError(stepped.utilization, exact.utilization, utilizationError, utilizationSe);
+        relativeError(stepped.waiting, exact.waiting, waitingError, waitingSe);
+        double speedup = exact.cpuSeconds / std::max(stepped.cpuSeconds, 1e-6);
+        speedups.push_back(speedup);
+        worstErrors.push_back(std::max({std::fabs(waitError), std::fabs(utilizationError), std::fabs(waitingError)}));
+        printf("%8g %10.3f %8.2f %6.2f %8.2f %6.2f %8.2f %6.2f %9.3f %8.2f\n", step, meanWait, waitError, waitSe,
+               utilizationError, utilizationSe, waitingError, waitingSe, stepped.cpuSeconds, speedup);
+    }
+
+    // Bars scaled to the largest value of each column
+    const int width = 30;
+    double maxSpeedup = *std::max_element(speedups.begin(), speedups.end());
+    double maxError = std::max(1e-9, *std::max_element(worstErrors.begin(), worstErrors.end()));
+    printf("\n%8s  %-*s %8s  %-*s %s\n", "step", width, "speedup", "", width, "largest |error|", "%");
+    for (size_t k = 0; k < steps.size(); k++) {
+        int speedBar = (int)std::lround(width * speedups[k] / maxSpeedup);
+        int errorBar = (int)std::lround(width * worstErrors[k] / maxError);
+        printf("%8g  %-*s %7.1fx  %-*s %.2f\n", steps[k], width, std::string(speedBar, '#').c_str(), speedups[k], width,
+               std::string(errorBar, '*').c_str(), worstErrors[k]);
+    }
+    return 0;
+}
@@ -0,0 +1,585 @@
+//
+// summarize - fast summary of a sweep's result directory (.sca and .vec) as CSV
+//
+// Finds all .sca and .vec files under the given directories (or takes the
+// given files) and parses them in parallel threads, each file memory-mapped
+// and scanned in place. Runs are grouped by config name and iteration
+// variables (the repetitions of one design point form a group). Per group and
+// selected result it writes one CSV row:
+//
+//   - scalars (and the count/mean/stddev/min/max fields of statistics): mean,
+//     standard deviation and confidence interval across the runs, and
+//     quantiles of the per-run values;
+//   - vectors: mean, standard deviation and confidence interval of the
+//     per-run means, and quantiles of all recorded values pooled over the
+//     runs (log-linear histogram, 2 significant digits; values from 0 to
+//     86400).
+//
+// Per-cashier results also get an aggregate row per group: module indices
+// become [*] (cashier[*].utilizationRate) and cashier numbers in names become
+// * (cashier*_assignments). Within each run, the aggregate is the mean over
+// the cashiers, and the histograms of the cashiers' vectors are pooled.
+//
+// -s selects results by case-insensitive substrings of their names (default
+// utilizationRate,waitingTime,_assignments; -s '' selects all), -m by a
+// substring of the module path.
+//
+// Usage: summarize [-s name,name,...] [-m moduleSubstring] [-c confidence] [-j jobs] [-o out.csv] dirs-or-files...
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "../BatchMeans.h"
+#include "../LogHistogram.h"
+#include "ScaFile.h"
+
+enum ResultKind { SCALAR, VECTOR };
+
+struct MetricKey
+{
+    std::string group;  // config name, unit separator, iteration variables
+    int kind;
+    std::string module;
+    std::string name;
+
+    bool operator<(const MetricKey& other) const {
+        if (group != other.group)
+            return group < other.group;
+        if (kind != other.kind)
+            return kind < other.kind;
+        if (module != other.module)
+            return module < other.module;
+        return name < other.name;
+    }
+};
+
+struct Metric
+{
+    std::vector<double> perRun;  // scalar value or vector mean of each run
+    LogHistogram pooled;         // vectors: all values of all runs
+};
+
+typedef std::map<MetricKey, Metric> Metrics;
+
+struct Selection
+{
+    std::vector<std::string> names;  // lower case
+    std::string module;
+
+    bool selects(const std::string& module, const std::string& name) const {
+        if (!this->module.empty() && module.find(this->module) == std::string::npos)
+            return false;
+        if (names.empty())
+            return true;
+        std::string lower = name;
+        std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+        for (const std::string& item : names)
+            if (lower.find(item) != std::string::npos)
+                return true;
+        return false;
+    }
+};
+
+// Aggregate name over cashiers: [k] -> [*] in the module, cashier<k> -> cashier* in the name;
+// false if the result is not per cashier
+static bool aggregateKey(const std::string& module, const std::string& name, std::string& aggregateModule,
+                         std::string& aggregateName)
+{
+    aggregateModule.clear();
+    for (size_t i = 0; i < module.size(); i++) {
+        if (module[i] == '[' && i + 1 < module.size() && std::isdigit((unsigned char)module[i + 1])) {
+            size_t j = i + 1;
+            while (j < module.size() && std::isdigit((unsigned char)module[j]))
+                j++;
+            if (j < module.size() && module[j] == ']') {
+                aggregateModule += "[*]";
+                i = j;
+                continue;
+            }
+        }
+        aggregateModule += module[i];
+    }
+    aggregateName.clear();
+    size_t at = name.find("cashier");
+    if (at != std::string::npos && at + 7 < name.size() && std::isdigit((unsigned char)name[at + 7])) {
+        size_t j = at + 7;
+        while (j < name.size() && std::isdigit((unsigned char)name[j]))
+            j++;
+        aggregateName = name.substr(0, at + 7) + "*" + name.substr(j);
+    } else {
+        aggregateName = name;
+    }
+    return aggregateModule != module || aggregateName != name;
+}
+
+//==============================================================================
+// PARSING
+//==============================================================================
+class MappedFile
+{
+  private:
+    const char *data = nullptr;
+    size_t size = 0;
+
+  public:
+    explicit MappedFile(const std::string& fileName) {
+        int fd = open(fileName.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("cannot open " + fileName);
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            close(fd);
+            throw std::runtime_error("cannot stat " + fileName);
+        }
+        size = (size_t)info.st_size;
+        if (size > 0) {
+            void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("cannot map " + fileName);
+            }
+            madvise(mapping, size, MADV_SEQUENTIAL);
+            data = static_cast<const char*>(mapping);
+        }
+        close(fd);
+    }
+    ~MappedFile() {
+        if (data)
+            munmap(const_cast<char*>(data), size);
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char *begin() const { return data; }
+    const char *end() const { return data + size; }
+    size_t getSize() const { return size; }
+};
+
+// One run of a file while it is being read
+class RunParser
+{
+  private:
+    struct Vector {
+        std::string module;
+        std::string name;
+        long count = 0;
+        double sum = 0;
+        LogHistogram histogram;
+    };
+
+    const Selection& selection;
+    Metrics& metrics;
+    bool active = false;
+    bool inRunHeader = false;
+    std::string configName;
+    std::map<std::string, std::string> iterationVariables;
+    std::vector<std::pair<std::string, std::string>> scalarNames;  // (module, name)
+    std::vector<double> scalarValues;
+    std::vector<std::unique_ptr<Vector>> vectors;  // by vector id, null if not selected
+    std::string statisticModule, statisticName;    // current statistic block
+
+  public:
+    long runs = 0;
+
+    RunParser(const Selection& selection, Metrics& metrics) : selection(selection), metrics(metrics) {}
+
+    void parse(const char *begin, const char *end) {
+        for (const char *p = begin; p < end;) {
+            const char *eol = static_cast<const char*>(memchr(p, '\n', end - p));
+            if (!eol)
+                eol = end;
+            const char *lineEnd = eol;
+            if (lineEnd > p && lineEnd[-1] == '\r')
+                lineEnd--;
+            if (p < lineEnd)
+                line(p, lineEnd);
+            p = eol + 1;
+        }
+        finishRun();
+    }
+
+  private:
+    void line(const char *p, const char *end) {
+        if (std::isdigit((unsigned char)*p)) {
+            vectorData(p, end);
+            return;
+        }
+        std::vector<std::string> fields = splitScaLine(std::string(p, end));
+        if (fields.empty())
+            return;
+        const std::string& kind = fields[0];
+        if (kind == "run") {
+            finishRun();
+            active = true;
+            inRunHeader = true;
+            return;
+        }
+        if (!active)
+            return;
+        if (kind == "attr" && fields.size() >= 3) {
+            if (inRunHeader && fields[1] == "configname")
+                configName = fields[2];
+        }
+        else if (kind == "itervar" && fields.size() >= 3) {
+            iterationVariables[fields[1]] = fields[2];
+        }
+        else if (kind == "scalar" && fields.size() >= 4) {
+            inRunHeader = false;
+            statisticName.clear();
+            if (selection.selects(fields[1], fields[2]))
+                addScalar(fields[1], fields[2], strtod(fields[3].c_str(), nullptr));
+        }
+        else if (kind == "statistic" && fields.size() >= 3) {
+            inRunHeader = false;
+            statisticModule = fields[1];
+            statisticName = fields[2];
+        }
+        else if (kind == "field" && fields.size() >= 3 && !statisticName.empty()) {
+            const std::string& field = fields[1];
+            if ((field == "count" || field == "mean" || field == "stddev" || field == "min" || field == "max") &&
+                selection.selects(statisticModule, statisticName))
+                addScalar(statisticModule, statisticName + ":" + field, strtod(fields[2].c_str(), nullptr));
+        }
+        else if (kind == "vector" && fields.size() >= 4) {
+            inRunHeader = false;
+            statisticName.clear();
+            long id = atol(fields[1].c_str());
+            if (id >= 0 && selection.selects(fields[2], fields[3])) {
+                if ((size_t)id >= vectors.size())
+                    vectors.resize(id + 1);
+                vectors[id].reset(new Vector);
+                vectors[id]->module = fields[2];
+                vectors[id]->name = fields[3];
+            }
+        }
+        else if (kind == "par" || kind == "histogram") {
+            inRunHeader = false;
+            statisticName.clear();
+        }
+    }
+
+    // "<id> [event] [time] <value>": the value is the last column
+    void vectorData(const char *p, const char *end) {
+        long id = 0;
+        auto parsed = std::from_chars(p, end, id);
+        if (parsed.ec != std::errc() || id < 0 || (size_t)id >= vectors.size() || !vectors[id])
+            return;
+        const char *last = end;
+        while (last > parsed.ptr && last[-1] != ' ' && last[-1] != '\t')
+            last--;
+        double value;
+        if (last == parsed.ptr || std::from_chars(last, end, value).ec != std::errc())
+            return;
+        Vector& vector = *vectors[id];
+        vector.count++;
+        vector.sum += value;
+        vector.histogram.record(value);
+    }
+
+    void addScalar(const std::string& module, const std::string& name, double value) {
+        scalarNames.push_back({module, name});
+        scalarValues.push_back(value);
+    }
+
+    std::string groupName() const {
+        std::string variables;
+        for (const auto& variable : iterationVariables)
+            variables += (variables.empty() ? "" : " ") + variable.first + "=" + variable.second;
+        return configName + '\x1f' + variables;
+    }
+
+    void finishRun() {
+        if (!active)
+            return;
+        std::string group = groupName();
+        // Per-cashier aggregates of this run: sum and number of cashiers
+        std::map<MetricKey, std::pair<double, int>> aggregates;
+        std::map<MetricKey, LogHistogram> aggregateHistograms;
+        std::string aggregateModule, aggregateName;
+
+        for (size_t i = 0; i < scalarNames.size(); i++) {
+            const std::string& module = scalarNames[i].first;
+            const std::string& name = scalarNames[i].second;
+            double value = scalarValues[i];
+            metrics[{group, SCALAR, module, name}].perRun.push_back(value);
+            if (aggregateKey(module, name, aggregateModule, aggregateName)) {
+                auto& aggregate = aggregates[{group, SCALAR, aggregateModule, aggregateName}];
+                aggregate.first += value;
+                aggregate.second++;
+            }
+        }
+        for (const auto& vector : vectors) {
+            if (!vector || vector->count == 0)
+                continue;
+            double mean = vector->sum / vector->count;
+            Metric& metric = metrics[{group, VECTOR, vector->module, vector->name}];
+            metric.perRun.push_back(mean);
+            metric.pooled.merge(vector->histogram);
+            if (aggregateKey(vector->module, vector->name, aggregateModule, aggregateName)) {
+                MetricKey key = {group, VECTOR, aggregateModule, aggregateName};
+                auto& aggregate = aggregates[key];
+                aggregate.first += mean;
+                aggregate.second++;
+                aggregateHistograms[key].merge(vector->histogram);
+            }
+        }
+        for (const auto& aggregate : aggregates) {
+            Metric& metric = metrics[aggregate.first];
+            metric.perRun.push_back(aggregate.second.first / aggregate.second.second);
+            auto histogram = aggregateHistograms.find(aggregate.first);
+            if (histogram != aggregateHistograms.end())
+                metric.pooled.merge(histogram->second);
+        }
+
+        runs++;
+        active = false;
+        configName.clear();
+        iterationVariables.clear();
+        scalarNames.clear();
+        scalarValues.clear();
+        vectors.clear();
+        statisticName.clear();
+    }
+};
+
+static bool hasSuffix(const std::string& text, const char *suffix)
+{
+    size_t length = strlen(suffix);
+    return text.size() > length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+static void findResultFiles(const std::string& path, std::vector<std::string>& files)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+        throw std::runtime_error("cannot open " + path);
+    if (!S_ISDIR(info.st_mode)) {
+        files.push_back(path);
+        return;
+    }
+    DIR *dir = opendir(path.c_str());
+    if (!dir)
+        throw std::runtime_error("cannot open directory " + path);
+    while (dirent *entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..")
+            continue;
+        std::string child = path + "/" + name;
+        if (hasSuffix(name, ".sca") || hasSuffix(name, ".vec"))
+            files.push_back(child);
+        else if (entry->d_type == DT_DIR || (entry->d_type == DT_UNKNOWN && stat(child.c_str(), &info) == 0 && S_ISDIR(info.st_mode)))
+            findResultFiles(child, files);
+    }
+    closedir(dir);
+}
+
+//==============================================================================
+// OUTPUT
+//==============================================================================
+// Linear interpolation between order statistics of sorted values
+static double quantile(const std::vector<double>& sorted, double q)
+{
+    double position = q * (sorted.size() - 1);
+    size_t below = (size_t)position;
+    if (below + 1 >= sorted.size())
+        return sorted.back();
+    return sorted[below] + (position - below) * (sorted[below + 1] - sorted[below]);
+}
+
+static std::string csvField(const std::string& text)
+{
+    if (text.find_first_of(",\"\n") == std::string::npos)
+        return text;
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"')
+            out += '"';
+        out += c;
+    }
+    return out + "\"";
+}
+
+static std::string csvNumber(double value)
+{
+    if (!std::isfinite(value))
+        return "";
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.10g", value);
+    return buffer;
+}
+
+static void writeCsv(FILE *out, const Metrics& metrics, double confidence)
+{
+    fprintf(out, "config,itervars,kind,module,name,runs,mean,stddev,ci_halfwidth,ci_low,ci_high,min,p5,p50,p95,max,values\n");
+    for (const auto& entry : metrics) {
+        const MetricKey& key = entry.first;
+        std::vector<double> values = entry.second.perRun;
+        if (values.empty())
+            continue;
+        std::sort(values.begin(), values.end());  // also makes the sums independent of the thread count
+        size_t n = values.size();
+        double mean = 0;
+        for (double v : values)
+            mean += v;
+        mean /= n;
+        double squares = 0;
+        for (double v : values)
+            squares += (v - mean) * (v - mean);
+        double stddev = n > 1 ? std::sqrt(squares / (n - 1)) : NAN;
+        double halfWidth = BatchMeans::confidenceHalfWidth(values, confidence);
+
+        size_t separator = key.group.find('\x1f');
+        std::string config = key.group.substr(0, separator);
+        std::string iterationVariables = key.group.substr(separator + 1);
+        std::string row = csvField(config) + "," + csvField(iterationVariables) + "," +
+                          (key.kind == SCALAR ? "scalar" : "vector") + "," + csvField(key.module) + "," +
+                          csvField(key.name) + "," + std::to_string(n) + "," + csvNumber(mean) + "," +
+                          csvNumber(stddev) + "," + csvNumber(halfWidth) + "," + csvNumber(mean - halfWidth) + "," +
+                          csvNumber(mean + halfWidth) + ",";
+        if (key.kind == SCALAR) {
+            row += csvNumber(values.front()) + "," + csvNumber(quantile(values, 0.05)) + "," +
+                   csvNumber(quantile(values, 0.5)) + "," + csvNumber(quantile(values, 0.95)) + "," +
+                   csvNumber(values.back()) + "," + std::to_string(n);
+        } else {
+            const LogHistogram& pooled = entry.second.pooled;
+            row += csvNumber(pooled.getMin()) + "," + csvNumber(pooled.quantile(0.05)) + "," +
+                   csvNumber(pooled.quantile(0.5)) + "," + csvNumber(pooled.quantile(0.95)) + "," +
+                   csvNumber(pooled.getMax()) + "," + std::to_string(pooled.getCount());
+        }
+        fprintf(out, "%s\n", row.c_str());
+    }
+}
+
+static void usage()
+{
+    fprintf(stderr, "Usage: summarize [-s name,name,...] [-m moduleSubstring] [-c confidence] [-j jobs] [-o out.csv] dirs-or-files...\n");
+}
+
+int main(int argc, char **argv)
+{
+    Selection selection;
+    std::string names = "utilizationRate,waitingTime,_assignments";
+    double confidence = 0.95;
+    int jobs = std::max(1u, std::thread::hardware_concurrency());
+    std::string outputFile;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            names = argv[++i];
+        else if (!strcmp(argv[i], "-m") && i + 1 < argc)
+            selection.module = argv[++i];
+        else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+            confidence = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+            jobs = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            outputFile = argv[++i];
+        else if (argv[i][0] == '-') {
+            usage();
+            return 1;
+        }
+        else
+            inputs.push_back(argv[i]);
+    }
+    if (inputs.empty() || confidence <= 0 || confidence >= 1) {
+        usage();
+        return 1;
+    }
+    std::stringstream list(names);
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        std::transform(item.begin(), item.end(), item.begin(), [](unsigned char c) { return std::tolower(c); });
+        if (!item.empty())
+            selection.names.push_back(item);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::string> files;
+    try {
+        for (const std::string& input : inputs)
+            findResultFiles(input, files);
+    }
+    catch (std::exception& e) {
+        fprintf(stderr, "summarize: %s\n", e.what());
+        return 1;
+    }
+
+    // Largest files first, so that no thread is left with a big one at the end
+    std::vector<std::pair<off_t, std::string>> bySize;
+    for (const std::string& file : files) {
+        struct stat info;
+        bySize.push_back({stat(file.c_str(), &info) == 0 ? info.st_size : 0, file});
+    }
+    std::sort(bySize.begin(), bySize.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    std::vector<Metrics> threadMetrics(jobs);
+    std::vector<long> threadRuns(jobs, 0);
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> bytes(0);
+    std::atomic<int> failed(0);
+    auto worker = [&](int k) {
+        for (size_t i; (i = next++) < bySize.size(); ) {
+            try {
+                MappedFile file(bySize[i].second);
+                RunParser parser(selection, threadMetrics[k]);
+                parser.parse(file.begin(), file.end());
+                threadRuns[k] += parser.runs;
+                bytes += file.getSize();
+            }
+            catch (std::exception& e) {
+                fprintf(stderr, "summarize: %s\n", e.what());
+                failed++;
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int k = 0; k < jobs; k++)
+        threads.emplace_back(worker, k);
+    for (std::thread& thread : threads)
+        thread.join();
+
+    Metrics metrics;
+    long runs = 0;
+    for (int k = 0; k < jobs; k++) {
+        runs += threadRuns[k];
+        for (auto& entry : threadMetrics[k]) {
+            Metric& metric = metrics[entry.first];
+            metric.perRun.insert(metric.perRun.end(), entry.second.perRun.begin(), entry.second.perRun.end());
+            metric.pooled.merge(entry.second.pooled);
+        }
+        threadMetrics[k].clear();
+    }
+
+    FILE *out = outputFile.empty() ? stdout : fopen(outputFile.c_str(), "w");
+    if (!out) {
+        fprintf(stderr, "summarize: cannot write %s\n", outputFile.c_str());
+        return 1;
+    }
+    writeCsv(out, metrics, confidence);
+    if (out != stdout)
+        fclose(out);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "summarize: %zu files (%.1f MB), %ld runs, %zu rows in %.2fs on %d threads\n", files.size(),
+            bytes / 1e6, runs, metrics.size(), seconds, jobs);
+    return failed > 0 ? 1 : 0;
+}
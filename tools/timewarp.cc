@@ -0,0 +1,791 @@
+//
+// timewarp - optimistic (Time Warp) parallel execution of one store with
+// incremental state saving, rollback and GVT-based fossil collection
+//
+// The links between balancer and cashiers have zero delay: a customer is
+// at the cashier the moment it is routed, and a departure updates the
+// shortest-queue view at once. Conservative parallel execution finds no
+// lookahead there. Here the store is split into logical processes (LPs):
+// the front (shop and balancer) and -B banks of cashiers (cashier i in
+// bank i % B). They exchange time-stamped messages: ARRIVAL (front to
+// bank, a routed customer) and, for shortest queue, DEPARTURE (bank to
+// front). Each LP runs its events in timestamp order, speculatively, on
+// one of the threads.
+//
+// Before an event changes state, the LP logs the old value of each field
+// it touches: the record of one cashier lane (busy flag, queue indices,
+// statistics), the RNG state and the send counter. Rolling back an event
+// restores just these. A message earlier than the LP's last processed
+// event (a straggler) rolls the LP back, and the messages sent by the
+// undone events are cancelled by anti-messages. Every -g events per thread,
+// the threads stop, deliver all messages in transit and agree on the
+// global virtual time (GVT, the earliest pending timestamp). The logs of
+// events before GVT are freed. LPs do not run ahead of GVT by more than
+// the window -W.
+//
+// Every LP has its own random number stream, and events are ordered by
+// (time, kind, sender, sender's sequence number), where a zero-delay
+// message always has a later kind than the event sending it. So the
+// committed results do not depend on the thread count or the schedule.
+// They are compared bit for bit with a sequential run of the same LPs (the
+// same -B), and the wall-clock speedup over that run is printed per thread
+// count. -w adds synthetic work per event, standing in for the heavier
+// events of the full model.
+//
+// The LPs simulate the StoreReplica re-implementation of the default
+// model, not the OMNeT++ modules: "exact" means equal to the sequential
+// replica run, and says nothing about agreement with supermarket_sim's
+// scalars. As a sanity check of the replica itself, the sequential
+// utilization is printed next to the offered load, and with random routing
+// (every lane an M/G/1 queue) the mean wait next to Pollaczek-Khinchine.
+//
+// Usage: timewarp [-t threads,threads,...] [-T simTime] [-B banks] [-W window] [-g gvtInterval] [-w workNs]
+//                 [-a arrivalInterval] [-c cashiers] [-b strategy] [-f speedFactor] [-s seed]
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "StoreReplica.h"
+
+// In key order, zero-delay messages (ARRIVAL, DEPARTURE) come after the event that sends them
+enum EventKind { NEXT_ARRIVAL, ARRIVAL, SERVICE_END, DEPARTURE };
+
+struct Event
+{
+    double time;
+    int kind;
+    int source;    // sending LP
+    uint64_t seq;  // sender's sequence number; with source, identifies the message
+    int target;    // receiving LP
+    int cashier;
+    int items;
+    bool anti;     // cancels the message with the same identity
+};
+
+static bool before(const Event& a, const Event& b)
+{
+    if (a.time != b.time)
+        return a.time < b.time;
+    if (a.kind != b.kind)
+        return a.kind < b.kind;
+    if (a.source != b.source)
+        return a.source < b.source;
+    return a.seq < b.seq;
+}
+
+struct EventOrder
+{
+    bool operator()(const Event& a, const Event& b) const { return before(a, b); }
+};
+
+// Synthetic work per event, calibrated to nanoseconds at startup
+static volatile uint64_t workSink;
+static double iterationsPerNs = 1;
+
+static void work(long ns)
+{
+    uint64_t x = workSink;
+    long n = (long)(ns * iterationsPerNs);
+    for (long i = 0; i < n; i++)
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    workSink = x;
+}
+
+static void calibrateWork()
+{
+    const long iterations = 20000000;
+    iterationsPerNs = 1;
+    auto start = std::chrono::steady_clock::now();
+    work(iterations);
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    iterationsPerNs = iterations / std::max(ns, 1.0);
+}
+
+class Outbox
+{
+  public:
+    virtual ~Outbox() {}
+    virtual void deliver(const Event& event) = 0;
+};
+
+class LogicalProcess
+{
+  public:
+    struct Counters {
+        long processed = 0;   // including rolled back events
+        long rolledBack = 0;
+        long rollbacks = 0;
+        long antiMessages = 0;
+        size_t peakLog = 0;   // saved fields not yet fossil collected
+    };
+
+  protected:
+    struct Saved {
+        void *address;
+        size_t bytes;
+        alignas(8) unsigned char old[48];
+    };
+    struct Processed {
+        Event event;
+        uint32_t saved;  // entries in the log
+        uint32_t sent;   // messages sent
+    };
+
+    int id;
+    long workNs;
+    bool optimistic = false;
+    Outbox *outbox = nullptr;
+    std::set<Event, EventOrder> pending;
+    std::deque<Processed> processed;  // not yet committed, in order
+    std::deque<Saved> log;            // old values, per processed event
+    std::deque<Event> sent;           // messages sent, per processed event
+    uint32_t savedByEvent = 0;
+    uint32_t sentByEvent = 0;
+    uint64_t seq = 0;
+    Counters counters;
+
+    // Incremental state saving: called before the event changes the field
+    template <class T>
+    void save(T& field) {
+        static_assert(std::is_trivially_copyable<T>::value && sizeof(T) <= sizeof(Saved::old), "saved field");
+        if (!optimistic)
+            return;
+        Saved saved;
+        saved.address = &field;
+        saved.bytes = sizeof(T);
+        memcpy(saved.old, &field, sizeof(T));
+        log.push_back(saved);
+        savedByEvent++;
+    }
+
+    void send(Event event) {
+        save(seq);
+        event.source = id;
+        event.seq = seq++;
+        event.anti = false;
+        if (optimistic) {
+            sent.push_back(event);
+            sentByEvent++;
+        }
+        if (event.target == id)
+            pending.insert(event);
+        else
+            outbox->deliver(event);
+    }
+
+    virtual void handle(const Event& event) = 0;
+
+    // Frees memory that no uncommitted event can need again
+    virtual void compact() {}
+
+  public:
+    LogicalProcess(int id, long workNs) : id(id), workNs(workNs) {}
+    virtual ~LogicalProcess() {}
+
+    int getId() const { return id; }
+    const Counters& getCounters() const { return counters; }
+
+    void attach(Outbox *outbox, bool optimistic) {
+        this->outbox = outbox;
+        this->optimistic = optimistic;
+    }
+
+    bool hasPending() const { return !pending.empty(); }
+    const Event& nextEvent() const { return *pending.begin(); }
+    double nextTime() const { return pending.empty() ? INFINITY : pending.begin()->time; }
+
+    // Runs the earliest pending event if it is before limit
+    bool processNext(double limit) {
+        if (pending.empty() || !(pending.begin()->time < limit))
+            return false;
+        Event event = *pending.begin();
+        pending.erase(pending.begin());
+        savedByEvent = sentByEvent = 0;
+        work(workNs);
+        handle(event);
+        counters.processed++;
+        if (optimistic) {
+            processed.push_back({event, savedByEvent, sentByEvent});
+            counters.peakLog = std::max(counters.peakLog, log.size());
+        }
+        return true;
+    }
+
+    void receive(const Event& event) {
+        if (!event.anti) {
+            if (!processed.empty() && before(event, processed.back().event))
+                rollback(event);
+            pending.insert(event);
+            return;
+        }
+        auto it = pending.find(event);
+        if (it == pending.end()) {
+            // The message was processed already: undo it and everything after it
+            rollback(event);
+            it = pending.find(event);
+        }
+        pending.erase(it);
+    }
+
+    // Events before gvt can no longer be rolled back
+    void fossilCollect(double gvt) {
+        while (!processed.empty() && processed.front().event.time < gvt) {
+            const Processed& committed = processed.front();
+            log.erase(log.begin(), log.begin() + committed.saved);
+            sent.erase(sent.begin(), sent.begin() + committed.sent);
+            processed.pop_front();
+        }
+        compact();
+    }
+
+  private:
+    // Undoes all processed events from key on, latest first
+    void rollback(const Event& key) {
+        counters.rollbacks++;
+        while (!processed.empty() && !before(processed.back().event, key)) {
+            const Processed& undone = processed.back();
+            for (uint32_t i = 0; i < undone.saved; i++) {
+                const Saved& saved = log.back();
+                memcpy(saved.address, saved.old, saved.bytes);
+                log.pop_back();
+            }
+            for (uint32_t i = 0; i < undone.sent; i++) {
+                Event anti = sent.back();
+                sent.pop_back();
+                if (anti.target == id) {
+                    // A later event of this LP, so already rolled back and pending again
+                    pending.erase(anti);
+                } else {
+                    anti.anti = true;
+                    outbox->deliver(anti);
+                    counters.antiMessages++;
+                }
+            }
+            pending.insert(undone.event);
+            processed.pop_back();
+            counters.rolledBack++;
+        }
+    }
+};
+
+// Shop and balancer
+class Front : public LogicalProcess
+{
+  public:
+    struct State {
+        long arrivals = 0;
+        long roundRobinCounter = 0;
+    };
+
+  private:
+    ReplicaConfig config;
+    int banks;
+    ReplicaRng rng;
+    State state;
+    std::vector<int> atLane;  // customers routed to the lane and not departed (shortest queue view)
+
+  public:
+    Front(const ReplicaConfig& config, int banks, uint64_t seed, long workNs)
+        : LogicalProcess(0, workNs), config(config), banks(banks), rng(seed), atLane(config.numCashiers, 0) {
+        pending.insert({rng.exponential(config.arrivalInterval), NEXT_ARRIVAL, id, seq++, id, 0, 0, false});
+    }
+
+    long getArrivals() const { return state.arrivals; }
+
+  protected:
+    void handle(const Event& event) override {
+        if (event.kind == DEPARTURE) {
+            save(atLane[event.cashier]);
+            atLane[event.cashier]--;
+            return;
+        }
+        save(state);
+        save(rng);
+        state.arrivals++;
+        int items = rng.intuniform(config.minItems, config.maxItems);
+        int lane = selectLane();
+        save(atLane[lane]);
+        atLane[lane]++;
+        send({event.time, ARRIVAL, 0, 0, 1 + lane % banks, lane, items, false});
+        send({event.time + rng.exponential(config.arrivalInterval), NEXT_ARRIVAL, 0, 0, id, 0, 0, false});
+    }
+
+  private:
+    int selectLane() {
+        switch (config.strategy) {
+            case 1:
+                return (int)(std::min_element(atLane.begin(), atLane.end()) - atLane.begin());
+            case 2:
+                return rng.intuniform(0, config.numCashiers - 1);
+            default:
+                return (int)(state.roundRobinCounter++ % config.numCashiers);
+        }
+    }
+};
+
+// Cashiers i with i % banks == bank - 1
+class Bank : public LogicalProcess
+{
+  public:
+    struct Lane {
+        uint64_t head = 0;  // queue indices, absolute
+        uint64_t tail = 0;
+        int busy = 0;
+        long served = 0;
+        double waitSum = 0;
+        double busySum = 0;
+    };
+
+  private:
+    struct Slot {
+        double arrivalTime;
+        int items;
+    };
+
+    ReplicaConfig config;
+    int banks;
+    ReplicaRng rng;
+    std::vector<Lane> lanes;                // by local index cashier / banks
+    std::vector<std::vector<Slot>> slots;   // queued customers from index base on
+    std::vector<uint64_t> base;
+
+  public:
+    Bank(int id, const ReplicaConfig& config, int banks, uint64_t seed, long workNs)
+        : LogicalProcess(id, workNs), config(config), banks(banks), rng(seed) {
+        int count = (config.numCashiers - id + banks) / banks;
+        lanes.resize(count);
+        slots.resize(count);
+        base.resize(count, 0);
+    }
+
+    const Lane& getLane(int cashier) const { return lanes[cashier / banks]; }
+
+  protected:
+    void handle(const Event& event) override {
+        int local = event.cashier / banks;
+        Lane& lane = lanes[local];
+        save(lane);
+        if (event.kind == ARRIVAL) {
+            if (!lane.busy) {
+                startService(event.cashier, event.time, event.time, event.items);
+            } else {
+                size_t index = lane.tail - base[local];
+                if (index == slots[local].size())
+                    slots[local].push_back({event.time, event.items});
+                else
+                    slots[local][index] = {event.time, event.items};
+                lane.tail++;
+            }
+            return;
+        }
+        if (config.strategy == 1)
+            send({event.time, DEPARTURE, 0, 0, 0, event.cashier, 0, false});
+        if (lane.head < lane.tail) {
+            Slot next = slots[local][lane.head - base[local]];
+            lane.head++;
+            startService(event.cashier, event.time, next.arrivalTime, next.items);
+        } else {
+            lane.busy = 0;
+        }
+    }
+
+    // Drops queue slots before the oldest head a rollback could restore
+    void compact() override {
+        std::vector<uint64_t> low(lanes.size());
+        for (size_t i = 0; i < lanes.size(); i++)
+            low[i] = lanes[i].head;
+        for (const Saved& saved : log) {
+            const Lane *lane = static_cast<const Lane*>(saved.address);
+            if (saved.bytes == sizeof(Lane) && lane >= lanes.data() && lane < lanes.data() + lanes.size()) {
+                size_t i = lane - lanes.data();
+                low[i] = std::min(low[i], reinterpret_cast<const Lane*>(saved.old)->head);
+            }
+        }
+        for (size_t i = 0; i < lanes.size(); i++) {
+            if (low[i] - base[i] >= 4096) {
+                slots[i].erase(slots[i].begin(), slots[i].begin() + (low[i] - base[i]));
+                base[i] = low[i];
+            }
+        }
+    }
+
+  private:
+    void startService(int cashier, double now, double arrivalTime, int items) {
+        Lane& lane = lanes[cashier / banks];
+        save(rng);
+        double serviceTime = 0;
+        for (int i = 0; i < items; i++)
+            serviceTime += rng.uniform(config.minItemTime, config.maxItemTime);
+        serviceTime *= config.speedFactor;
+        lane.busy = 1;
+        lane.served++;
+        lane.waitSum += now - arrivalTime;
+        lane.busySum += serviceTime;
+        send({now + serviceTime, SERVICE_END, 0, 0, id, cashier, 0, false});
+    }
+};
+
+struct Store
+{
+    std::unique_ptr<Front> front;
+    std::vector<std::unique_ptr<Bank>> banks;
+    std::vector<LogicalProcess*> lps;  // by id
+
+    Store(const ReplicaConfig& config, int bankCount, uint64_t seed, long workNs) {
+        front.reset(new Front(config, bankCount, seed * 1000003, workNs));
+        lps.push_back(front.get());
+        for (int b = 1; b <= bankCount; b++) {
+            banks.emplace_back(new Bank(b, config, bankCount, seed * 1000003 + b, workNs));
+            lps.push_back(banks.back().get());
+        }
+    }
+};
+
+struct Result
+{
+    long arrivals = 0;
+    std::vector<Bank::Lane> lanes;  // by cashier
+    LogicalProcess::Counters counters;  // summed over LPs
+    long gvtRounds = 0;
+    double seconds = 0;
+
+    bool sameAs(const Result& other) const {
+        if (arrivals != other.arrivals || lanes.size() != other.lanes.size())
+            return false;
+        for (size_t i = 0; i < lanes.size(); i++) {
+            const Bank::Lane& a = lanes[i];
+            const Bank::Lane& b = other.lanes[i];
+            if (a.served != b.served || a.busy != b.busy || a.head != b.head || a.tail != b.tail ||
+                memcmp(&a.waitSum, &b.waitSum, sizeof(double)) != 0 || memcmp(&a.busySum, &b.busySum, sizeof(double)) != 0)
+                return false;
+        }
+        return true;
+    }
+};
+
+static Result collect(const Store& store, int numCashiers)
+{
+    Result result;
+    result.arrivals = store.front->getArrivals();
+    for (int i = 0; i < numCashiers; i++)
+        result.lanes.push_back(store.banks[i % store.banks.size()]->getLane(i));
+    for (LogicalProcess *lp : store.lps) {
+        const LogicalProcess::Counters& counters = lp->getCounters();
+        result.counters.processed += counters.processed;
+        result.counters.rolledBack += counters.rolledBack;
+        result.counters.rollbacks += counters.rollbacks;
+        result.counters.antiMessages += counters.antiMessages;
+        result.counters.peakLog += counters.peakLog;
+    }
+    return result;
+}
+
+// One thread, events of all LPs in key order
+class SequentialKernel : public Outbox
+{
+  private:
+    std::vector<LogicalProcess*> lps;
+
+  public:
+    explicit SequentialKernel(const std::vector<LogicalProcess*>& lps) : lps(lps) {
+        for (LogicalProcess *lp : lps)
+            lp->attach(this, false);
+    }
+
+    void deliver(const Event& event) override { lps[event.target]->receive(event); }
+
+    void run(double endTime) {
+        for (long n = 1;; n++) {
+            LogicalProcess *next = nullptr;
+            for (LogicalProcess *lp : lps)
+                if (lp->hasPending() && (!next || before(lp->nextEvent(), next->nextEvent())))
+                    next = lp;
+            if (!next || !next->processNext(endTime))
+                break;
+            if (n % 65536 == 0)
+                for (LogicalProcess *lp : lps)
+                    lp->fossilCollect(INFINITY);  // nothing to roll back, only compacts the queues
+        }
+    }
+};
+
+class Barrier
+{
+  private:
+    std::mutex mutex;
+    std::condition_variable condition;
+    int parties;
+    int waiting = 0;
+    uint64_t generation = 0;
+
+  public:
+    explicit Barrier(int parties) : parties(parties) {}
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        uint64_t arrived = generation;
+        if (++waiting == parties) {
+            waiting = 0;
+            generation++;
+            condition.notify_all();
+        } else {
+            condition.wait(lock, [&] { return generation != arrived; });
+        }
+    }
+};
+
+// LPs spread over threads (id % threads), running optimistically
+class TimeWarpKernel : public Outbox
+{
+  private:
+    struct Inbox {
+        std::mutex mutex;
+        std::vector<Event> events;
+        std::atomic<size_t> count{0};
+    };
+
+    std::vector<LogicalProcess*> lps;
+    std::vector<std::unique_ptr<Inbox>> inboxes;  // by LP
+    int threads;
+    double window;
+    long gvtInterval;
+    std::atomic<uint64_t> messages{0};  // delivered so far
+    Barrier barrier;
+    std::vector<double> localMinimum;   // by thread, for the GVT reduction
+    std::atomic<long> gvtRounds{0};
+
+  public:
+    TimeWarpKernel(const std::vector<LogicalProcess*>& lps, int threads, double window, long gvtInterval)
+        : lps(lps), threads(threads), window(window), gvtInterval(gvtInterval), barrier(threads), localMinimum(threads) {
+        for (LogicalProcess *lp : lps) {
+            lp->attach(this, true);
+            inboxes.emplace_back(new Inbox);
+        }
+    }
+
+    long getGvtRounds() const { return gvtRounds; }
+
+    void deliver(const Event& event) override {
+        Inbox& inbox = *inboxes[event.target];
+        std::lock_guard<std::mutex> lock(inbox.mutex);
+        inbox.events.push_back(event);
+        inbox.count.store(inbox.events.size(), std::memory_order_release);
+        messages.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void run(double endTime) {
+        std::vector<std::thread> workers;
+        for (int k = 0; k < threads; k++)
+            workers.emplace_back([this, k, endTime] { worker(k, endTime); });
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+  private:
+    // Messages from one sender arrive in the order sent, so an anti-message never overtakes its message
+    void drain(LogicalProcess *lp, std::vector<Event>& events) {
+        Inbox& inbox = *inboxes[lp->getId()];
+        if (inbox.count.load(std::memory_order_acquire) == 0)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(inbox.mutex);
+            events.swap(inbox.events);
+            inbox.count.store(0, std::memory_order_release);
+        }
+        for (const Event& event : events)
+            lp->receive(event);
+        events.clear();
+    }
+
+    void worker(int k, double endTime) {
+        std::vector<LogicalProcess*> mine;
+        for (LogicalProcess *lp : lps)
+            if (lp->getId() % threads == k)
+                mine.push_back(lp);
+        std::vector<Event> events;
+        double gvt = 0;
+        while (true) {
+            double limit = std::min(endTime, gvt + window);
+            for (long n = 0; n < gvtInterval; n++) {
+                for (LogicalProcess *lp : mine)
+                    drain(lp, events);
+                LogicalProcess *next = nullptr;
+                for (LogicalProcess *lp : mine)
+                    if (lp->hasPending() && (!next || before(lp->nextEvent(), next->nextEvent())))
+                        next = lp;
+                if (!next || !next->processNext(limit))
+                    break;
+            }
+
+            // GVT: stop, deliver until no message is in transit, then the earliest pending event
+            barrier.wait();
+            uint64_t previous = messages.load();
+            barrier.wait();
+            while (true) {
+                for (LogicalProcess *lp : mine)
+                    drain(lp, events);
+                barrier.wait();
+                uint64_t delivered = messages.load();
+                barrier.wait();
+                if (delivered == previous)
+                    break;
+                previous = delivered;
+            }
+            double minimum = INFINITY;
+            for (LogicalProcess *lp : mine)
+                minimum = std::min(minimum, lp->nextTime());
+            localMinimum[k] = minimum;
+            barrier.wait();
+            gvt = *std::min_element(localMinimum.begin(), localMinimum.end());
+            for (LogicalProcess *lp : mine)
+                lp->fossilCollect(gvt);
+            if (k == 0)
+                gvtRounds++;
+            if (gvt >= endTime)
+                break;
+        }
+    }
+};
+
+static Result runSequential(const ReplicaConfig& config, int banks, double simTime, uint64_t seed, long workNs)
+{
+    Store store(config, banks, seed, workNs);
+    SequentialKernel kernel(store.lps);
+    auto start = std::chrono::steady_clock::now();
+    kernel.run(simTime);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    Result result = collect(store, config.numCashiers);
+    result.seconds = seconds;
+    return result;
+}
+
+static Result runTimeWarp(const ReplicaConfig& config, int banks, double simTime, uint64_t seed, long workNs,
+                          int threads, double window, long gvtInterval)
+{
+    Store store(config, banks, seed, workNs);
+    TimeWarpKernel kernel(store.lps, threads, window, gvtInterval);
+    auto start = std::chrono::steady_clock::now();
+    kernel.run(simTime);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    Result result = collect(store, config.numCashiers);
+    result.seconds = seconds;
+    result.gvtRounds = kernel.getGvtRounds();
+    return result;
+}
+
+static void usage()
+{
+    fprintf(stderr, "Usage: timewarp [-t threads,threads,...] [-T simTime] [-B banks] [-W window] [-g gvtInterval] [-w workNs]\n"
+                    "                [-a arrivalInterval] [-c cashiers] [-b strategy] [-f speedFactor] [-s seed]\n");
+}
+
+int main(int argc, char **argv)
+{
+    ReplicaConfig replica;
+    replica.numCashiers = 16;
+    replica.arrivalInterval = 1.2;  // load 0.85 with 16 cashiers
+    replica.strategy = 1;
+    int hardware = std::max(1, (int)std::thread::hardware_concurrency());
+    std::vector<int> threadCounts = {1, 2, 4};
+    if (hardware > 4)
+        threadCounts.push_back(hardware);
+    int banks = 4;
+    double simTime = 20000;
+    double window = 5;
+    long gvtInterval = 2000;
+    long workNs = 2000;
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2) {
+            usage();
+            return 1;
+        }
+        const char *value = argv[++i];
+        switch (argv[i - 1][1]) {
+            case 't': {
+                threadCounts.clear();
+                std::stringstream in(value);
+                std::string item;
+                while (std::getline(in, item, ','))
+                    threadCounts.push_back(atoi(item.c_str()));
+                break;
+            }
+            case 'T': simTime = atof(value); break;
+            case 'B': banks = atoi(value); break;
+            case 'W': window = atof(value); break;
+            case 'g': gvtInterval = atol(value); break;
+            case 'w': workNs = atol(value); break;
+            case 'a': replica.arrivalInterval = atof(value); break;
+            case 'c': replica.numCashiers = atoi(value); break;
+            case 'b': replica.strategy = atoi(value); break;
+            case 'f': replica.speedFactor = atof(value); break;
+            case 's': seed = strtoull(value, nullptr, 10); break;
+            default: usage(); return 1;
+        }
+    }
+    if (threadCounts.empty() || simTime <= 0 || banks < 1 || banks > replica.numCashiers || !(window > 0) ||
+        gvtInterval < 1 || workNs < 0 ||
+        std::any_of(threadCounts.begin(), threadCounts.end(), [](int threads) { return threads < 1; })) {
+        usage();
+        return 1;
+    }
+    calibrateWork();
+
+    Result sequential = runSequential(replica, banks, simTime, seed, workNs);
+    long served = 0;
+    double waitSum = 0, busySum = 0;
+    for (const Bank::Lane& lane : sequential.lanes) {
+        served += lane.served;
+        waitSum += lane.waitSum;
+        busySum += lane.busySum;
+    }
+    printf("store: %d cashiers in %d banks, arrival interval %gs, strategy %d, speed factor %g; %gs, %ldns work per event\n",
+           replica.numCashiers, banks, replica.arrivalInterval, replica.strategy, replica.speedFactor, simTime, workNs);
+    printf("sequential: %ld arrivals, %ld served, mean wait %.4fs, utilization %.4f; %ld events in %.3fs\n",
+           sequential.arrivals, served, served > 0 ? waitSum / served : 0, busySum / (simTime * replica.numCashiers),
+           sequential.counters.processed, sequential.seconds);
+    // The replica's service model: 1..25 items of 0.5..2s, scaled by the speed factor
+    double meanService = 16.25 * replica.speedFactor;
+    double serviceSecondMoment = 347.75 * replica.speedFactor * replica.speedFactor;
+    double load = meanService / (replica.arrivalInterval * replica.numCashiers);
+    printf("expected:   utilization %.4f", load);
+    if (replica.strategy == 2 && load < 1)  // random routing: every lane is M/G/1 (Pollaczek-Khinchine)
+        printf(", mean wait %.4fs", serviceSecondMoment / (replica.arrivalInterval * replica.numCashiers) / (2 * (1 - load)));
+    printf("\n%d hardware threads\n\n", hardware);
+    printf("%7s %9s %8s %10s %10s %9s %9s %10s %7s %9s %6s\n", "threads", "wall s", "speedup", "processed", "rolledBack",
+           "rollbacks", "anti msgs", "efficiency", "GVTs", "peak log", "exact");
+
+    bool allExact = true;
+    for (int threads : threadCounts) {
+        Result optimistic = runTimeWarp(replica, banks, simTime, seed, workNs, threads, window, gvtInterval);
+        const LogicalProcess::Counters& counters = optimistic.counters;
+        bool exact = optimistic.sameAs(sequential) &&
+                     counters.processed - counters.rolledBack == sequential.counters.processed;
+        allExact = allExact && exact;
+        printf("%7d %9.3f %8.2f %10ld %10ld %9ld %9ld %10.3f %7ld %9zu %6s\n", threads, optimistic.seconds,
+               sequential.seconds / std::max(optimistic.seconds, 1e-9), counters.processed, counters.rolledBack,
+               counters.rollbacks, counters.antiMessages,
+               counters.processed > 0 ? (double)(counters.processed - counters.rolledBack) / counters.processed : 0,
+               optimistic.gvtRounds, counters.peakLog, exact ? "yes" : "NO");
+    }
+    if (!allExact) {
+        fprintf(stderr, "timewarp: results differ from the sequential run\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,205 @@
+//
+// twin - fast forecast bands from a live store snapshot (digital twin)
+//
+// Starts many replications of the store replica (StoreReplica.h) from the
+// state in a JSON snapshot (see StoreSnapshot.h): customers in service
+// with their remaining service times, the queued customers with the time
+// they have already waited, the round robin position and the time to the
+// next arrival. The replications run in parallel, much faster than real
+// time. Per lane and forecast interval, it prints quantile bands across
+// the replications of the mean waiting time (customers by arrival
+// interval, snapshot customers in the first one) and of the number of
+// customers at the lane at the end of the interval.
+//
+// Usage: twin snapshot.json [-H horizon] [-i interval] [-n replications] [-q low,high]
+//             [-a arrivalInterval] [-c cashiers] [-b strategy] [-f speedFactor] [-j jobs] [-s seed]
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../StoreSnapshot.h"
+#include "StoreReplica.h"
+
+struct Forecast
+{
+    // [lane][interval], NaN if no customer of the lane arrived in the interval
+    std::vector<std::vector<double>> meanWait;
+    std::vector<std::vector<double>> customersAtEnd;
+    std::vector<double> horizonMeanWait;  // [lane]
+};
+
+static Forecast forecast(const ReplicaConfig& config, const StoreSnapshot& snapshot, double horizon,
+                         int intervals, uint64_t seed)
+{
+    int lanes = config.numCashiers;
+    double interval = horizon / intervals;
+    std::vector<std::vector<double>> waitSum(lanes, std::vector<double>(intervals, 0.0));
+    std::vector<std::vector<int>> waitCount(lanes, std::vector<int>(intervals, 0));
+
+    StoreReplica replica(config, seed);
+    for (int i = 0; i < (int)snapshot.lanes.size(); i++) {
+        const StoreSnapshot::Lane& lane = snapshot.lanes[i];
+        if (lane.busy)
+            replica.startInService(i, lane.remainingService);
+        for (const StoreSnapshot::Customer& waiting : lane.queue) {
+            waitSum[i][0] += waiting.waited + replica.addWaiting(i, waiting.items);
+            waitCount[i][0]++;
+        }
+    }
+    replica.setRoundRobinCounter(snapshot.roundRobinCounter);
+    if (snapshot.nextArrivalIn >= 0)
+        replica.setNextArrival(snapshot.nextArrivalIn);
+
+    Forecast result;
+    result.customersAtEnd.assign(lanes, std::vector<double>(intervals, 0.0));
+    StoreReplica::Arrival arrival;
+    for (int k = 0; k < intervals; k++) {
+        double end = (k + 1) * interval;
+        while (replica.nextEventTime() < end) {
+            if (replica.step(&arrival) == StoreReplica::ARRIVAL) {
+                waitSum[arrival.cashier][k] += arrival.waitingTime;
+                waitCount[arrival.cashier][k]++;
+            }
+        }
+        for (int i = 0; i < lanes; i++)
+            result.customersAtEnd[i][k] = replica.getQueueLength(i);
+    }
+
+    result.meanWait.assign(lanes, std::vector<double>(intervals, NAN));
+    result.horizonMeanWait.assign(lanes, NAN);
+    for (int i = 0; i < lanes; i++) {
+        double sum = 0;
+        int count = 0;
+        for (int k = 0; k < intervals; k++) {
+            if (waitCount[i][k] > 0)
+                result.meanWait[i][k] = waitSum[i][k] / waitCount[i][k];
+            sum += waitSum[i][k];
+            count += waitCount[i][k];
+        }
+        if (count > 0)
+            result.horizonMeanWait[i] = sum / count;
+    }
+    return result;
+}
+
+// Empirical quantile of the non-NaN values
+static double quantile(std::vector<double> values, double q)
+{
+    values.erase(std::remove_if(values.begin(), values.end(), [](double v) { return std::isnan(v); }), values.end());
+    if (values.empty())
+        return NAN;
+    std::sort(values.begin(), values.end());
+    double position = q * (values.size() - 1);
+    size_t below = (size_t)position;
+    size_t above = std::min(below + 1, values.size() - 1);
+    return values[below] + (position - below) * (values[above] - values[below]);
+}
+
+static void usage()
+{
+    fprintf(stderr, "Usage: twin snapshot.json [-H horizon] [-i interval] [-n replications] [-q low,high]\n"
+                    "            [-a arrivalInterval] [-c cashiers] [-b strategy] [-f speedFactor] [-j jobs] [-s seed]\n");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || argv[1][0] == '-') {
+        usage();
+        return 1;
+    }
+    ReplicaConfig config;
+    double horizon = 3600, interval = 300;
+    int replications = 1000;
+    double low = 0.05, high = 0.95;
+    int jobs = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t seed = 1;
+    bool cashiersGiven = false;
+
+    for (int i = 2; i < argc; i++) {
+        if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2) {
+            usage();
+            return 1;
+        }
+        const char *value = argv[++i];
+        switch (argv[i - 1][1]) {
+            case 'H': horizon = atof(value); break;
+            case 'i': interval = atof(value); break;
+            case 'n': replications = atoi(value); break;
+            case 'q': if (sscanf(value, "%lf,%lf", &low, &high) != 2) { usage(); return 1; } break;
+            case 'a': config.arrivalInterval = atof(value); break;
+            case 'c': config.numCashiers = atoi(value); cashiersGiven = true; break;
+            case 'b': config.strategy = atoi(value); break;
+            case 'f': config.speedFactor = atof(value); break;
+            case 'j': jobs = std::max(1, atoi(value)); break;
+            case 's': seed = strtoull(value, nullptr, 10); break;
+            default: usage(); return 1;
+        }
+    }
+    if (horizon <= 0 || interval <= 0 || replications < 2 || !(low < high)) {
+        usage();
+        return 1;
+    }
+
+    StoreSnapshot snapshot;
+    try {
+        snapshot = StoreSnapshot::read(argv[1]);
+    }
+    catch (std::exception& e) {
+        fprintf(stderr, "twin: %s\n", e.what());
+        return 1;
+    }
+    if (!cashiersGiven)
+        config.numCashiers = std::max(config.numCashiers, (int)snapshot.lanes.size());
+    if ((int)snapshot.lanes.size() > config.numCashiers) {
+        fprintf(stderr, "twin: snapshot has %d lanes, but only %d cashiers\n", (int)snapshot.lanes.size(), config.numCashiers);
+        return 1;
+    }
+    int intervals = std::max(1, (int)std::ceil(horizon / interval - 1e-9));
+    horizon = intervals * interval;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Forecast> forecasts(replications);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < jobs; t++) {
+        threads.emplace_back([&, t]() {
+            for (int r = t; r < replications; r += jobs)
+                forecasts[r] = forecast(config, snapshot, horizon, intervals, seed * 1000003 + r);
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("forecast over %gs from %s: %d replications in %.3fs (%.0fx faster than real time overall)\n", horizon, argv[1],
+           replications, seconds, horizon * replications / std::max(seconds, 1e-9));
+    printf("bands: %g%% / 50%% / %g%% quantiles across replications\n\n", 100 * low, 100 * high);
+    printf("%-5s %-13s %10s %10s %10s   %8s %8s %8s\n", "lane", "interval", "waitLow", "waitMedian", "waitHigh",
+           "custLow", "custMed", "custHigh");
+    for (int i = 0; i < config.numCashiers; i++) {
+        for (int k = 0; k < intervals; k++) {
+            std::vector<double> waits, customers;
+            for (const Forecast& f : forecasts) {
+                waits.push_back(f.meanWait[i][k]);
+                customers.push_back(f.customersAtEnd[i][k]);
+            }
+            char range[32];
+            snprintf(range, sizeof(range), "%g-%g", k * interval, (k + 1) * interval);
+            printf("%-5d %-13s %10.2f %10.2f %10.2f   %8.0f %8.0f %8.0f\n", i, range, quantile(waits, low),
+                   quantile(waits, 0.5), quantile(waits, high), quantile(customers, low), quantile(customers, 0.5),
+                   quantile(customers, high));
+        }
+        std::vector<double> waits;
+        for (const Forecast& f : forecasts)
+            waits.push_back(f.horizonMeanWait[i]);
+        printf("%-5d %-13s %10.2f %10.2f %10.2f\n\n", i, "all", quantile(waits, low), quantile(waits, 0.5),
+               quantile(waits, high));
+    }
+    return 0;
+}
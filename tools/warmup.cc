@@ -0,0 +1,346 @@
+//
+// warmup - learns a steady-state start distribution and measures how much
+// warm-up a steady-state start saves compared with an empty store
+//
+// pilot: one long run of the store replica (StoreReplica.h). After a
+// discarded tenth, it measures the time-weighted distribution of the
+// customers at each lane (under round robin, at each position ahead of the
+// next arrival) and writes it as JSON for initialState = "pilot" (see
+// SteadyState.h).
+//
+// compare: many replications from an empty store, from the analytic
+// steady state and, with -p, from the pilot distribution (like in the
+// model, the waits of the sampled initial customers are not counted). Per
+// start, it averages the waiting time by arrival window across the
+// replications and applies MSER (White's marginal standard error rule) to
+// the window means: the truncation point is the warm-up that run length
+// would have to discard. The bias test compares the untruncated mean wait
+// of the replications with a reference from long runs (a tenth
+// discarded): |t| > 1.96 marks a start whose short runs are biased. Every
+// start runs on streams of its own, so the tests are independent of each
+// other and of the reference.
+//
+// Usage: warmup pilot [-T simTime] [common options] > steadystate.json
+//        warmup compare [-n replications] [-H horizon] [-W windows] [-p steadystate.json]
+//                       [-L longRuns] [-T longRunTime] [common options]
+//        common options: [-a arrivalInterval] [-c cashiers] [-b strategy] [-f speedFactor] [-j jobs] [-s seed]
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../SteadyState.h"
+#include "StoreReplica.h"
+
+struct Settings
+{
+    ReplicaConfig replica;
+    int replications = 400;
+    double horizon = 20000;   // s per compared replication
+    int windows = 100;        // arrival windows per replication
+    std::string pilotFile;
+    int longRuns = 32;
+    double simTime = 0;       // s; pilot run, or each long run (default 50 horizons)
+    int jobs = 0;
+    uint64_t seed = 1;
+};
+
+// Runs jobs [0, count) on the worker threads
+template <class Job>
+static void parallelFor(int count, int jobs, Job job)
+{
+    std::vector<std::thread> threads;
+    for (int t = 0; t < jobs; t++) {
+        threads.emplace_back([&, t]() {
+            for (int i = t; i < count; i += jobs)
+                job(i);
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+//
+// pilot
+//
+static SteadyState learnSteadyState(const Settings& settings, double simTime)
+{
+    const ReplicaConfig& config = settings.replica;
+    StoreReplica replica(config, settings.seed);
+    double warmup = simTime / 10;
+    bool byRoundRobinOffset = config.strategy == 0;
+    std::vector<std::vector<double>> timeAt(config.numCashiers, std::vector<double>(1, 0.0));
+    double last = warmup;
+    while (replica.nextEventTime() < simTime) {
+        double t = replica.nextEventTime();
+        if (t > warmup) {
+            long next = replica.getRoundRobinCounter() % config.numCashiers;
+            for (int i = 0; i < config.numCashiers; i++) {
+                size_t n = replica.getQueueLength(i);
+                // Round robin: indexed by how many arrivals ahead the lane is
+                std::vector<double>& distribution = timeAt[byRoundRobinOffset ? (i - next + config.numCashiers) % config.numCashiers : i];
+                if (n >= distribution.size())
+                    distribution.resize(n + 1, 0.0);
+                distribution[n] += t - last;
+            }
+            last = t;
+        }
+        replica.step();
+    }
+
+    SteadyState steadyState;
+    steadyState.laneArrivalInterval = config.arrivalInterval * config.numCashiers;
+    steadyState.speedFactor = config.speedFactor;
+    steadyState.byRoundRobinOffset = byRoundRobinOffset;
+    for (std::vector<double>& distribution : timeAt) {
+        for (double& p : distribution)
+            p /= last - warmup;
+        steadyState.customers.push_back(distribution);
+    }
+    return steadyState;
+}
+
+//
+// compare
+//
+struct Replication
+{
+    std::vector<double> waitSum;  // per arrival window
+    std::vector<long> waitCount;
+    double meanWait = 0;
+};
+
+enum Start { EMPTY, ANALYTIC, PILOT };
+
+static Replication replicate(const Settings& settings, const SteadyState *steadyState, uint64_t seed)
+{
+    const ReplicaConfig& config = settings.replica;
+    Replication result;
+    result.waitSum.assign(settings.windows, 0.0);
+    result.waitCount.assign(settings.windows, 0);
+
+    // The start is sampled from a stream of its own
+    StoreReplica replica(config, seed);
+    if (steadyState) {
+        ReplicaRng startRng(seed ^ 0x5ca1ab1e5eedULL);
+        StoreSnapshot snapshot = steadyState->sample([&startRng]() { return startRng.uniform01(); });
+        for (int i = 0; i < config.numCashiers; i++) {
+            const StoreSnapshot::Lane& lane = snapshot.lanes[i];
+            if (lane.busy)
+                replica.startInService(i, lane.remainingService);
+            for (const StoreSnapshot::Customer& waiting : lane.queue)
+                replica.addWaiting(i, waiting.items);
+        }
+        replica.setRoundRobinCounter(snapshot.roundRobinCounter);
+    }
+
+    double window = settings.horizon / settings.windows;
+    StoreReplica::Arrival arrival;
+    while (replica.nextEventTime() < settings.horizon) {
+        double t = replica.nextEventTime();
+        if (replica.step(&arrival) == StoreReplica::ARRIVAL) {
+            int k = std::min(settings.windows - 1, (int)(t / window));
+            result.waitSum[k] += arrival.waitingTime;
+            result.waitCount[k]++;
+        }
+    }
+    double sum = 0;
+    long count = 0;
+    for (int k = 0; k < settings.windows; k++) {
+        sum += result.waitSum[k];
+        count += result.waitCount[k];
+    }
+    result.meanWait = count > 0 ? sum / count : 0;
+    return result;
+}
+
+// Mean wait of one long run after discarding its first tenth
+static double longRunMeanWait(const ReplicaConfig& config, double simTime, uint64_t seed)
+{
+    StoreReplica replica(config, seed);
+    double sum = 0;
+    long count = 0;
+    StoreReplica::Arrival arrival;
+    while (replica.nextEventTime() < simTime) {
+        double t = replica.nextEventTime();
+        if (replica.step(&arrival) == StoreReplica::ARRIVAL && t >= simTime / 10) {
+            sum += arrival.waitingTime;
+            count++;
+        }
+    }
+    return count > 0 ? sum / count : 0;
+}
+
+// MSER: the truncation d (at most half the series) minimizing the
+// variance of the mean of the remaining values, sum (y_i - mean_d)^2 / (m - d)^2
+static int mserTruncation(const std::vector<double>& series)
+{
+    int m = (int)series.size();
+    int best = 0;
+    double bestStatistic = INFINITY;
+    for (int d = 0; d <= m / 2; d++) {
+        double mean = 0;
+        for (int i = d; i < m; i++)
+            mean += series[i];
+        mean /= m - d;
+        double squares = 0;
+        for (int i = d; i < m; i++)
+            squares += (series[i] - mean) * (series[i] - mean);
+        double statistic = squares / ((double)(m - d) * (m - d));
+        if (statistic < bestStatistic) {
+            bestStatistic = statistic;
+            best = d;
+        }
+    }
+    return best;
+}
+
+static void meanAndError(const std::vector<double>& values, double& mean, double& standardError)
+{
+    mean = 0;
+    for (double v : values)
+        mean += v;
+    mean /= values.size();
+    double squares = 0;
+    for (double v : values)
+        squares += (v - mean) * (v - mean);
+    standardError = values.size() > 1 ? std::sqrt(squares / (values.size() - 1) / values.size()) : 0;
+}
+
+static int compare(const Settings& settings)
+{
+    const ReplicaConfig& config = settings.replica;
+    std::vector<std::string> names = {"empty", "analytic"};
+    std::vector<SteadyState> steadyStates(1);
+    try {
+        steadyStates[0] = SteadyState::analytic(config.numCashiers, config.arrivalInterval, config.strategy, config.speedFactor);
+        if (!settings.pilotFile.empty()) {
+            steadyStates.push_back(SteadyState::read(settings.pilotFile));
+            names.push_back("pilot");
+        }
+    }
+    catch (std::exception& e) {
+        fprintf(stderr, "warmup: %s\n", e.what());
+        return 1;
+    }
+    for (const SteadyState& steadyState : steadyStates) {
+        if ((int)steadyState.customers.size() != config.numCashiers) {
+            fprintf(stderr, "warmup: steady state has %d lanes, but there are %d cashiers\n",
+                    (int)steadyState.customers.size(), config.numCashiers);
+            return 1;
+        }
+    }
+
+    double longRunTime = settings.simTime > 0 ? settings.simTime : 50 * settings.horizon;
+    std::vector<double> longRuns(settings.longRuns);
+    parallelFor(settings.longRuns, settings.jobs, [&](int r) {
+        longRuns[r] = longRunMeanWait(config, longRunTime, settings.seed * 7919 + 1000000 + r);
+    });
+    double reference, referenceError;
+    meanAndError(longRuns, reference, referenceError);
+
+    printf("store: %d cashiers, arrival interval %gs, strategy %d, speed factor %g, load %.3f\n", config.numCashiers,
+           config.arrivalInterval, config.strategy, config.speedFactor,
+           config.meanServiceTime() / (config.arrivalInterval * config.numCashiers));
+    printf("reference mean wait: %.3fs +- %.3f (%d long runs of %gs, first tenth discarded)\n", reference,
+           referenceError, settings.longRuns, longRunTime);
+    printf("%d replications of %gs per start, %d arrival windows of %gs\n\n", settings.replications, settings.horizon,
+           settings.windows, settings.horizon / settings.windows);
+    printf("%-9s %11s %11s %12s %9s %8s %7s   %s\n", "start", "firstWindow", "mserWarmup", "meanWait", "+-", "bias%",
+           "t", "verdict");
+
+    double window = settings.horizon / settings.windows;
+    double emptyWarmup = 0;
+    for (size_t mode = 0; mode < names.size(); mode++) {
+        const SteadyState *steadyState = mode == EMPTY ? nullptr : &steadyStates[mode - 1];
+        std::vector<Replication> replications(settings.replications);
+        parallelFor(settings.replications, settings.jobs, [&](int r) {
+            replications[r] = replicate(settings, steadyState, ((uint64_t)(mode + 1) << 40) + settings.seed * 1000003 + r);
+        });
+
+        std::vector<double> series(settings.windows), means;
+        for (int k = 0; k < settings.windows; k++) {
+            double sum = 0;
+            long count = 0;
+            for (const Replication& replication : replications) {
+                sum += replication.waitSum[k];
+                count += replication.waitCount[k];
+            }
+            series[k] = count > 0 ? sum / count : 0;
+        }
+        for (const Replication& replication : replications)
+            means.push_back(replication.meanWait);
+        double warmup = mserTruncation(series) * window;
+        if (mode == EMPTY)
+            emptyWarmup = warmup;
+
+        double mean, error;
+        meanAndError(means, mean, error);
+        double t = (mean - reference) / std::sqrt(error * error + referenceError * referenceError);
+        printf("%-9s %11.3f %10gs %12.3f %9.3f %8.2f %7.2f   %s\n", names[mode].c_str(), series[0], warmup, mean, error,
+               100 * (mean - reference) / reference, t, std::fabs(t) > 1.96 ? "biased" : "no bias detected");
+    }
+    printf("\nmserWarmup: initial transient MSER would discard; firstWindow: mean wait of the first window\n");
+    printf("an empty start discards %gs (%.1f%% of each run)\n", emptyWarmup, 100 * emptyWarmup / settings.horizon);
+    return 0;
+}
+
+static void usage()
+{
+    fprintf(stderr, "Usage: warmup pilot [-T simTime] [common options] > steadystate.json\n"
+                    "       warmup compare [-n replications] [-H horizon] [-W windows] [-p steadystate.json]\n"
+                    "                      [-L longRuns] [-T longRunTime] [common options]\n"
+                    "       common options: [-a arrivalInterval] [-c cashiers] [-b strategy] [-f speedFactor] [-j jobs] [-s seed]\n");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || (strcmp(argv[1], "pilot") != 0 && strcmp(argv[1], "compare") != 0)) {
+        usage();
+        return 1;
+    }
+    std::string command = argv[1];
+    Settings settings;
+    settings.replica.arrivalInterval = 5;  // load 0.81 with 4 cashiers
+    for (int i = 2; i < argc; i++) {
+        if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2) {
+            usage();
+            return 1;
+        }
+        const char *value = argv[++i];
+        switch (argv[i - 1][1]) {
+            case 'n': settings.replications = atoi(value); break;
+            case 'H': settings.horizon = atof(value); break;
+            case 'W': settings.windows = atoi(value); break;
+            case 'p': settings.pilotFile = value; break;
+            case 'L': settings.longRuns = atoi(value); break;
+            case 'T': settings.simTime = atof(value); break;
+            case 'a': settings.replica.arrivalInterval = atof(value); break;
+            case 'c': settings.replica.numCashiers = atoi(value); break;
+            case 'b': settings.replica.strategy = atoi(value); break;
+            case 'f': settings.replica.speedFactor = atof(value); break;
+            case 'j': settings.jobs = atoi(value); break;
+            case 's': settings.seed = strtoull(value, nullptr, 10); break;
+            default: usage(); return 1;
+        }
+    }
+    if (settings.replications < 2 || settings.horizon <= 0 || settings.windows < 2 || settings.longRuns < 2 ||
+        settings.replica.numCashiers < 1) {
+        usage();
+        return 1;
+    }
+    if (settings.jobs <= 0)
+        settings.jobs = std::max(1u, std::thread::hardware_concurrency());
+
+    if (command == "pilot") {
+        SteadyState steadyState = learnSteadyState(settings, settings.simTime > 0 ? settings.simTime : 1e7);
+        fputs(steadyState.toJson().c_str(), stdout);
+        return 0;
+    }
+    return compare(settings);
+}
@@ -0,0 +1,591 @@
+//
+// whatifd - local what-if service for the supermarket model
+//
+// Embeds the simulation kernel: the NED files are loaded once, then a pool
+// of pre-forked workers (each warmed up with one short run) accepts queries
+// on a UNIX domain socket, so a query pays neither process startup nor NED
+// loading. A query is one line of space-separated key=value tokens:
+//
+//     numCashiers=5 shop.arrivalInterval=10s strategy=1 sim-time-limit=20000s seed-set=3
+//
+// Keys are parameter names, optionally with trailing path components
+// (shop.arrivalInterval) and a leading "*." or "**."; they override the NED
+// defaults. Reserved keys: network (default supermarket_sim),
+// sim-time-limit (default -T), seed-set (default 0) and select
+// (comma-separated substrings of the scalars to return). The answer is one
+// line of JSON with the scalars recorded in finish() and the worker-side
+// elapsed time:
+//
+//     {"ok":true,"elapsedMs":12.3,"events":45678,"scalars":{"supermarket_sim.cashier[0].customersServed":1087,...}}
+//
+// Workers are restarted when they die and recycled after -m queries. The
+// same binary is the client: -q sends one query and prints the answer, -b
+// runs a benchmark with concurrent clients and reports throughput and
+// latency quantiles. Everything stays on the local machine. -t is a smoke
+// test without a daemon: one forked worker answers one override set over a
+// socketpair, and the expected scalar keys must be in the answer.
+//
+// Usage: whatifd [-S socket] [-n ned-path] [-w workers] [-T simTimeLimit] [-m maxQueries]
+//        whatifd -q [-S socket] key=value ...
+//        whatifd -b queries [-c clients] [-S socket] key=value ...
+//        whatifd -t [-n ned-path] [-T simTimeLimit]
+//
+// Built from the model sources against the OMNeT++ libraries, with its own
+// main instead of the Cmdenv one (see README).
+//
+
+#include <omnetpp.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace omnetpp;
+
+typedef std::map<std::string, std::string> Query;
+
+//==============================================================================
+// EMBEDDED SIMULATION
+//==============================================================================
+// No ini file: everything not overridden by the query takes its NED default
+class DefaultsConfig : public cConfiguration
+{
+  protected:
+    class NullKeyValue : public KeyValue
+    {
+      public:
+        virtual const char *getKey() const override { return nullptr; }
+        virtual const char *getValue() const override { return nullptr; }
+        virtual const char *getBaseDirectory() const override { return nullptr; }
+    };
+    NullKeyValue nullKeyValue;
+
+    virtual const char *substituteVariables(const char *value) const override { return value; }
+
+  public:
+    virtual const char *getConfigValue(const char *key) const override { return nullptr; }
+    virtual const KeyValue& getConfigEntry(const char *key) const override { return nullKeyValue; }
+    virtual const char *getPerObjectConfigValue(const char *objectFullPath, const char *keySuffix) const override { return nullptr; }
+    virtual const KeyValue& getPerObjectConfigEntry(const char *objectFullPath, const char *keySuffix) const override { return nullKeyValue; }
+};
+
+// Environment of one query: parameter overrides in, scalars out
+class QueryEnvir : public cNullEnvir
+{
+  private:
+    static const int NUM_RNGS = 8;
+    const Query& overrides;
+    std::vector<cRNG *> rngs;
+
+  public:
+    std::vector<std::pair<std::string, double>> scalars;
+
+    QueryEnvir(const Query& overrides, int seedSet)
+        : cNullEnvir(0, nullptr, new DefaultsConfig()), overrides(overrides)
+    {
+        for (int k = 0; k < NUM_RNGS; k++) {
+            cRNG *rng = new cMersenneTwister();
+            rng->initialize(seedSet, k, NUM_RNGS, 0, 1, getConfig());
+            rngs.push_back(rng);
+        }
+    }
+
+    virtual ~QueryEnvir()
+    {
+        for (cRNG *rng : rngs)
+            delete rng;
+    }
+
+    virtual int getNumRNGs() const override { return NUM_RNGS; }
+    virtual cRNG *getRNG(int k) override { return rngs[k % NUM_RNGS]; }
+
+    virtual void readParameter(cPar *par) override
+    {
+        std::string path = par->getFullPath();
+        for (const auto& entry : overrides) {
+            std::string key = entry.first;
+            if (key.compare(0, 3, "**.") == 0)
+                key = key.substr(3);
+            else if (key.compare(0, 2, "*.") == 0)
+                key = key.substr(2);
+            if (path == key || (path.size() > key.size() && path.compare(path.size() - key.size() - 1, std::string::npos, "." + key) == 0)) {
+                par->parse(entry.second.c_str());
+                return;
+            }
+        }
+        if (!par->containsValue())
+            throw cRuntimeError("No value for parameter %s", path.c_str());
+        par->acceptDefault();
+    }
+
+    virtual void recordScalar(cComponent *component, const char *name, double value, opp_string_map *attributes = nullptr) override
+    {
+        scalars.push_back({component->getFullPath() + "." + name, value});
+    }
+};
+
+static const char *reservedKeys[] = {"network", "sim-time-limit", "seed-set", "select"};
+
+static std::string jsonString(const std::string& text)
+{
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        if ((unsigned char)c >= 0x20)
+            out += c;
+    }
+    return out + "\"";
+}
+
+static std::string jsonNumber(double value)
+{
+    if (!std::isfinite(value))
+        return "null";
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.10g", value);
+    return buffer;
+}
+
+static Query parseQuery(const std::string& line)
+{
+    Query query;
+    std::stringstream in(line);
+    std::string token;
+    while (in >> token) {
+        size_t eq = token.find('=');
+        if (eq == std::string::npos || eq == 0)
+            throw std::runtime_error("expected key=value, got '" + token + "'");
+        query[token.substr(0, eq)] = token.substr(eq + 1);
+    }
+    return query;
+}
+
+// Runs one simulation and returns the JSON answer
+static std::string simulate(const Query& request, double defaultTimeLimit)
+{
+    auto start = std::chrono::steady_clock::now();
+    Query overrides = request;
+    std::string networkName = "supermarket_sim";
+    std::string timeLimit;
+    int seedSet = 0;
+    std::vector<std::string> selection;
+    for (const char *key : reservedKeys) {
+        auto it = overrides.find(key);
+        if (it == overrides.end())
+            continue;
+        if (!strcmp(key, "network"))
+            networkName = it->second;
+        else if (!strcmp(key, "sim-time-limit"))
+            timeLimit = it->second;
+        else if (!strcmp(key, "seed-set"))
+            seedSet = atoi(it->second.c_str());
+        else {
+            std::stringstream in(it->second);
+            std::string item;
+            while (std::getline(in, item, ','))
+                selection.push_back(item);
+        }
+        overrides.erase(it);
+    }
+
+    cModuleType *networkType = cModuleType::find(networkName.c_str());
+    if (!networkType)
+        throw std::runtime_error("no such network: " + networkName);
+
+    QueryEnvir *envir = new QueryEnvir(overrides, seedSet);
+    cSimulation *simulation = new cSimulation("simulation", envir);
+    cSimulation::setActiveSimulation(simulation);
+    long events = 0;
+    std::string error;
+    try {
+        simulation->setupNetwork(networkType);
+        simulation->setSimulationTimeLimit(timeLimit.empty() ? SimTime(defaultTimeLimit) : SimTime::parse(timeLimit.c_str()));
+        simulation->callInitialize();
+        try {
+            while (cEvent *event = simulation->takeNextEvent()) {
+                simulation->executeEvent(event);
+                events++;
+            }
+        }
+        catch (cTerminationException& e) {
+            // sim-time-limit reached or endSimulation() called
+        }
+        simulation->callFinish();
+    }
+    catch (std::exception& e) {
+        error = e.what();
+    }
+    std::vector<std::pair<std::string, double>> scalars = envir->scalars;
+    simulation->deleteNetwork();
+    cSimulation::setActiveSimulation(nullptr);
+    delete simulation;  // deletes the envir as well
+
+    double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (!error.empty())
+        return "{\"ok\":false,\"elapsedMs\":" + jsonNumber(elapsed) + ",\"error\":" + jsonString(error) + "}";
+
+    std::string answer = "{\"ok\":true,\"elapsedMs\":" + jsonNumber(elapsed) + ",\"events\":" + std::to_string(events) + ",\"scalars\":{";
+    bool first = true;
+    for (const auto& scalar : scalars) {
+        bool selected = selection.empty();
+        for (const std::string& item : selection)
+            selected = selected || scalar.first.find(item) != std::string::npos;
+        if (!selected)
+            continue;
+        answer += (first ? "" : ",") + jsonString(scalar.first) + ":" + jsonNumber(scalar.second);
+        first = false;
+    }
+    return answer + "}}";
+}
+
+//==============================================================================
+// SOCKET HELPERS
+//==============================================================================
+static sockaddr_un socketAddress(const std::string& path)
+{
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+        throw std::runtime_error("socket path too long: " + path);
+    strcpy(address.sun_path, path.c_str());
+    return address;
+}
+
+static bool readLine(int fd, std::string& line)
+{
+    line.clear();
+    char c;
+    ssize_t n;
+    while ((n = read(fd, &c, 1)) == 1 && c != '\n')
+        line += c;
+    return n == 1 || !line.empty();
+}
+
+// A peer that hung up yields EPIPE instead of killing the process with SIGPIPE
+static bool writeAll(int fd, const std::string& text)
+{
+    size_t written = 0;
+    while (written < text.size()) {
+        ssize_t n = send(fd, text.data() + written, text.size() - written, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        written += n;
+    }
+    return true;
+}
+
+//==============================================================================
+// DAEMON
+//==============================================================================
+static volatile sig_atomic_t stopping = 0;
+
+static void onStopSignal(int)
+{
+    stopping = 1;
+}
+
+// Answers queries on one connection until it closes or the worker has served maxQueries
+static void serveConnection(int connection, double defaultTimeLimit, int& served, int maxQueries)
+{
+    std::string line;
+    while (served < maxQueries && readLine(connection, line)) {
+        std::string answer;
+        try {
+            answer = simulate(parseQuery(line), defaultTimeLimit);
+        }
+        catch (std::exception& e) {
+            answer = "{\"ok\":false,\"error\":" + jsonString(e.what()) + "}";
+        }
+        served++;
+        if (!writeAll(connection, answer + "\n"))
+            break;
+    }
+}
+
+// Worker: accepts connections on the shared listening socket, one query per line
+static void workerLoop(int listener, double defaultTimeLimit, int maxQueries)
+{
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGINT, SIG_IGN);
+    signal(SIGPIPE, SIG_IGN);  // a client that disconnects early must not kill the worker
+
+    // Warm-up: page in the model code and the NED types
+    Query warmup;
+    warmup["sim-time-limit"] = "1s";
+    simulate(warmup, defaultTimeLimit);
+
+    for (int served = 0; served < maxQueries; ) {
+        int connection = accept(listener, nullptr, nullptr);
+        if (connection < 0)
+            continue;
+        serveConnection(connection, defaultTimeLimit, served, maxQueries);
+        close(connection);
+    }
+    _exit(0);  // recycled; the parent forks a fresh worker
+}
+
+static int runDaemon(const std::string& socketPath, const std::string& nedPath, int numWorkers,
+                     double defaultTimeLimit, int maxQueries)
+{
+    cSimulation::loadNedSourceFolder(nedPath.c_str());
+    cSimulation::doneLoadingNedFiles();
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = socketAddress(socketPath);
+    unlink(socketPath.c_str());
+    if (listener < 0 || bind(listener, (sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 128) != 0) {
+        perror(("whatifd: " + socketPath).c_str());
+        return 1;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onStopSignal;  // no SA_RESTART: wait() returns on a signal
+    sigaction(SIGTERM, &action, nullptr);
+    sigaction(SIGINT, &action, nullptr);
+
+    std::vector<pid_t> workers;
+    auto startWorker = [&]() {
+        pid_t pid = fork();
+        if (pid == 0)
+            workerLoop(listener, defaultTimeLimit, maxQueries);
+        if (pid > 0)
+            workers.push_back(pid);
+    };
+    for (int i = 0; i < numWorkers; i++)
+        startWorker();
+    fprintf(stderr, "whatifd: %d workers listening on %s\n", numWorkers, socketPath.c_str());
+
+    while (!stopping) {
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0)
+            continue;  // interrupted by a signal
+        workers.erase(std::remove(workers.begin(), workers.end(), pid), workers.end());
+        if (!stopping) {
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                fprintf(stderr, "whatifd: worker %d died, restarting\n", (int)pid);
+            startWorker();
+        }
+    }
+
+    for (pid_t pid : workers)
+        kill(pid, SIGTERM);
+    while (wait(nullptr) > 0)
+        ;
+    close(listener);
+    unlink(socketPath.c_str());
+    return 0;
+}
+
+// Smoke test without a socket path: a forked worker serves one query over a
+// socketpair, and the answer must carry the scalars of the overridden store
+static int runSmokeTest(const std::string& nedPath, double defaultTimeLimit)
+{
+    cSimulation::loadNedSourceFolder(nedPath.c_str());
+    cSimulation::doneLoadingNedFiles();
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        perror("whatifd: socketpair");
+        return 1;
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("whatifd: fork");
+        return 1;
+    }
+    if (pid == 0) {
+        signal(SIGPIPE, SIG_IGN);
+        close(fds[0]);
+        int served = 0;
+        serveConnection(fds[1], defaultTimeLimit, served, 1);
+        _exit(0);
+    }
+    close(fds[1]);
+
+    std::string query = "numCashiers=2 sim-time-limit=1000s select=customersServed,customersGenerated";
+    std::string answer;
+    bool answered = writeAll(fds[0], query + "\n") && readLine(fds[0], answer);
+    close(fds[0]);
+    int status;
+    waitpid(pid, &status, 0);
+
+    std::vector<std::string> failures;
+    if (!answered)
+        failures.push_back("no answer");
+    else if (answer.compare(0, 10, "{\"ok\":true") != 0)
+        failures.push_back("not ok");
+    const char *expected[] = {"\"scalars\":{", "\"supermarket_sim.cashier[0].customersServed\":",
+                              "\"supermarket_sim.cashier[1].customersServed\":", "\"supermarket_sim.shop.customersGenerated\":"};
+    const char *unexpected[] = {"\"supermarket_sim.cashier[2].", "utilizationRate"};  // numCashiers and select applied
+    for (const char *key : expected)
+        if (answered && answer.find(key) == std::string::npos)
+            failures.push_back(std::string("missing ") + key);
+    for (const char *key : unexpected)
+        if (answered && answer.find(key) != std::string::npos)
+            failures.push_back(std::string("unexpected ") + key);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        failures.push_back("worker did not exit cleanly");
+
+    printf("query:  %s\nanswer: %s\n", query.c_str(), answer.c_str());
+    for (const std::string& failure : failures)
+        printf("FAIL: %s\n", failure.c_str());
+    printf("%s\n", failures.empty() ? "PASS" : "FAIL");
+    return failures.empty() ? 0 : 1;
+}
+
+//==============================================================================
+// CLIENT
+//==============================================================================
+static int connectTo(const std::string& socketPath)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = socketAddress(socketPath);
+    if (fd < 0 || connect(fd, (sockaddr *)&address, sizeof(address)) != 0)
+        throw std::runtime_error("cannot connect to " + socketPath + ": " + strerror(errno));
+    return fd;
+}
+
+static std::string ask(int fd, const std::string& query)
+{
+    std::string answer;
+    if (!writeAll(fd, query + "\n") || !readLine(fd, answer))
+        throw std::runtime_error("connection closed by the daemon");
+    return answer;
+}
+
+static int runQuery(const std::string& socketPath, const std::string& query)
+{
+    int fd = connectTo(socketPath);
+    printf("%s\n", ask(fd, query).c_str());
+    close(fd);
+    return 0;
+}
+
+// Concurrent clients, one connection per query (like independent planners)
+static int runBenchmark(const std::string& socketPath, const std::string& query, int numQueries, int numClients)
+{
+    std::vector<double> latencies(numQueries);
+    std::atomic<int> next(0), failed(0);
+    auto start = std::chrono::steady_clock::now();
+    auto client = [&]() {
+        for (int i; (i = next++) < numQueries; ) {
+            auto queryStart = std::chrono::steady_clock::now();
+            try {
+                int fd = connectTo(socketPath);
+                if (ask(fd, query).compare(0, 10, "{\"ok\":true") != 0)
+                    failed++;
+                close(fd);
+            }
+            catch (std::exception&) {
+                failed++;
+            }
+            latencies[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - queryStart).count();
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 0; i < numClients; i++)
+        threads.emplace_back(client);
+    for (std::thread& thread : threads)
+        thread.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::sort(latencies.begin(), latencies.end());
+    auto quantile = [&](double q) { return latencies[std::min((size_t)(q * numQueries), latencies.size() - 1)]; };
+    printf("queries %d, clients %d, failed %d\n", numQueries, numClients, (int)failed);
+    printf("throughput %.2f queries/s\n", numQueries / seconds);
+    printf("latency ms: p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n", quantile(0.5), quantile(0.9), quantile(0.99),
+           latencies.back());
+    return failed > 0 ? 1 : 0;
+}
+
+static void usage()
+{
+    fprintf(stderr, "Usage: whatifd [-S socket] [-n ned-path] [-w workers] [-T simTimeLimit] [-m maxQueries]\n"
+                    "       whatifd -q [-S socket] key=value ...\n"
+                    "       whatifd -b queries [-c clients] [-S socket] key=value ...\n"
+                    "       whatifd -t [-n ned-path] [-T simTimeLimit]\n");
+}
+
+int main(int argc, char **argv)
+{
+    cStaticFlag dummy;  // must be first in main()
+
+    std::string socketPath = "/tmp/whatifd.sock";
+    std::string nedPath = ".";
+    int numWorkers = std::max(1u, std::thread::hardware_concurrency());
+    double defaultTimeLimit = 10000;
+    int maxQueries = 1000;
+    bool queryMode = false, smokeTest = false;
+    int benchmarkQueries = 0, clients = 4;
+    std::string query;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-q")
+            queryMode = true;
+        else if (arg == "-t")
+            smokeTest = true;
+        else if (arg == "-S" && hasValue)
+            socketPath = argv[++i];
+        else if (arg == "-n" && hasValue)
+            nedPath = argv[++i];
+        else if (arg == "-w" && hasValue)
+            numWorkers = std::max(1, atoi(argv[++i]));
+        else if (arg == "-T" && hasValue)
+            defaultTimeLimit = atof(argv[++i]);
+        else if (arg == "-m" && hasValue)
+            maxQueries = std::max(1, atoi(argv[++i]));
+        else if (arg == "-b" && hasValue)
+            benchmarkQueries = atoi(argv[++i]);
+        else if (arg == "-c" && hasValue)
+            clients = std::max(1, atoi(argv[++i]));
+        else if (arg.find('=') != std::string::npos && arg[0] != '-')
+            query += (query.empty() ? "" : " ") + arg;
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    try {
+        if (queryMode)
+            return runQuery(socketPath, query);
+        if (benchmarkQueries > 0)
+            return runBenchmark(socketPath, query, benchmarkQueries, clients);
+        if (!query.empty()) {
+            usage();
+            return 1;
+        }
+
+        CodeFragments::executeAll(CodeFragments::STARTUP);
+        SimTime::setScaleExp(-12);
+        int result = smokeTest ? runSmokeTest(nedPath, defaultTimeLimit)
+                               : runDaemon(socketPath, nedPath, numWorkers, defaultTimeLimit, maxQueries);
+        CodeFragments::executeAll(CodeFragments::SHUTDOWN);
+        return result;
+    }
+    catch (std::exception& e) {
+        fprintf(stderr, "whatifd: %s\n", e.what());
+        return 1;
+    }
+}
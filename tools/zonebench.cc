@@ -0,0 +1,229 @@
+//
+// zonebench - decision cost and waiting-time quality of hierarchical zone
+// balancing against flat shortest queue on a very large cashier bank, as
+// in the LargeShortestQueue and LargeHierarchical configs
+//
+// One store with -c cashiers, exponential arrivals every -a seconds and the
+// default service model (1..25 items, 0.5..2s per item), run for -T
+// seconds from empty. Service times are drawn on arrival, departures are
+// kept in a heap. The routing mirrors the Balancer with exact queue views:
+// flat shortest queue scans all cashiers; hierarchical picks the least
+// loaded zone of -z cashiers from the zone summaries (assignments counted
+// at once, departures reported in batches) and then the shortest queue in
+// that zone. Every strategy sees the same arrivals and service times.
+//
+// Per strategy: queue entries inspected and wall-clock nanoseconds per
+// routing decision (as meanDecisionCost / meanDecisionTime in the model),
+// mean, p99 and max waiting time of all customers.
+//
+// Usage: zonebench [-c cashiers] [-a arrivalInterval] [-T simTime] [-z zoneSize] [-b batch,batch,...] [-s seed]
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "StoreReplica.h"
+
+struct Settings
+{
+    int numCashiers = 10000;
+    double arrivalInterval = 0.0018;  // s, ~90% utilization with 10000 cashiers
+    double simTime = 2000;            // s
+    int zoneSize = 100;
+    std::vector<int> batches = {1, 8, 64};
+    uint64_t seed = 1;
+};
+
+struct Result
+{
+    long decisions = 0;
+    double entriesInspected = 0;
+    double decisionNanoseconds = 0;
+    std::vector<double> waits;
+};
+
+// Flat shortest queue, or hierarchical when zoneSummaryBatch > 0
+class Router
+{
+  private:
+    int numCashiers;
+    int zoneSize;
+    int numZones;
+    int zoneSummaryBatch;
+    std::vector<int> queueLengths;
+    std::vector<long> zoneLoad;
+    std::vector<int> zonePendingDepartures;
+
+  public:
+    long entriesInspected = 0;
+
+    Router(int numCashiers, int zoneSize, int zoneSummaryBatch)
+        : numCashiers(numCashiers), zoneSize(zoneSize), numZones((numCashiers + zoneSize - 1) / zoneSize),
+          zoneSummaryBatch(zoneSummaryBatch), queueLengths(numCashiers, 0), zoneLoad(numZones, 0),
+          zonePendingDepartures(numZones, 0) {}
+
+    int select() {
+        if (zoneSummaryBatch <= 0) {
+            int best = 0;
+            for (int i = 1; i < numCashiers; i++)
+                if (queueLengths[i] < queueLengths[best])
+                    best = i;
+            entriesInspected += numCashiers;
+            return best;
+        }
+        int bestZone = 0;
+        double bestLoad = 0;
+        for (int z = 0; z < numZones; z++) {
+            double load = (double)zoneLoad[z] / std::min(zoneSize, numCashiers - z * zoneSize);
+            if (z == 0 || load < bestLoad) {
+                bestZone = z;
+                bestLoad = load;
+            }
+        }
+        int first = bestZone * zoneSize;
+        int last = std::min(first + zoneSize, numCashiers);
+        int best = first;
+        for (int i = first + 1; i < last; i++)
+            if (queueLengths[i] < queueLengths[best])
+                best = i;
+        entriesInspected += numZones + last - first;
+        return best;
+    }
+
+    void assigned(int cashier) {
+        queueLengths[cashier]++;
+        zoneLoad[cashier / zoneSize]++;
+    }
+
+    void departed(int cashier) {
+        queueLengths[cashier]--;
+        int zone = cashier / zoneSize;
+        if (++zonePendingDepartures[zone] >= zoneSummaryBatch) {
+            zoneLoad[zone] = std::max(0L, zoneLoad[zone] - zonePendingDepartures[zone]);
+            zonePendingDepartures[zone] = 0;
+        }
+    }
+};
+
+static Result run(const Settings& settings, int zoneSummaryBatch)
+{
+    typedef std::pair<double, int> Departure;  // time, cashier
+    std::priority_queue<Departure, std::vector<Departure>, std::greater<Departure>> departures;
+    std::vector<double> freeAt(settings.numCashiers, 0.0);
+    Router router(settings.numCashiers, settings.zoneSize, zoneSummaryBatch);
+    ReplicaRng rng(settings.seed);
+    Result result;
+
+    double nextArrival = rng.exponential(settings.arrivalInterval);
+    while (true) {
+        if (!departures.empty() && departures.top().first <= nextArrival) {
+            if (departures.top().first >= settings.simTime)
+                break;
+            router.departed(departures.top().second);
+            departures.pop();
+            continue;
+        }
+        double now = nextArrival;
+        if (now >= settings.simTime)
+            break;
+
+        int items = rng.intuniform(1, 25);
+        double serviceTime = 0;
+        for (int i = 0; i < items; i++)
+            serviceTime += rng.uniform(0.5, 2.0);
+
+        auto start = std::chrono::steady_clock::now();
+        int cashier = router.select();
+        result.decisionNanoseconds += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        result.decisions++;
+        router.assigned(cashier);
+
+        double serviceStart = std::max(now, freeAt[cashier]);
+        freeAt[cashier] = serviceStart + serviceTime;
+        departures.push(Departure(freeAt[cashier], cashier));
+        result.waits.push_back(serviceStart - now);
+        nextArrival = now + rng.exponential(settings.arrivalInterval);
+    }
+    result.entriesInspected = router.entriesInspected;
+    return result;
+}
+
+static void print(const char *name, Result& result)
+{
+    double sum = 0;
+    for (double w : result.waits)
+        sum += w;
+    std::vector<double>& waits = result.waits;
+    size_t p99 = waits.size() * 99 / 100;
+    std::nth_element(waits.begin(), waits.begin() + p99, waits.end());
+    double p99Wait = waits.empty() ? 0 : waits[p99];
+    double maxWait = waits.empty() ? 0 : *std::max_element(waits.begin() + p99, waits.end());
+    printf("%-16s %10ld %12.1f %12.1f %10.3f %10.3f %10.3f\n", name, result.decisions,
+           result.entriesInspected / result.decisions, result.decisionNanoseconds / result.decisions,
+           sum / waits.size(), p99Wait, maxWait);
+}
+
+static void usage()
+{
+    fprintf(stderr, "Usage: zonebench [-c cashiers] [-a arrivalInterval] [-T simTime] [-z zoneSize] [-b batch,batch,...] [-s seed]\n");
+}
+
+int main(int argc, char **argv)
+{
+    Settings settings;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2) {
+            usage();
+            return 1;
+        }
+        const char *value = argv[++i];
+        switch (argv[i - 1][1]) {
+            case 'c': settings.numCashiers = atoi(value); break;
+            case 'a': settings.arrivalInterval = atof(value); break;
+            case 'T': settings.simTime = atof(value); break;
+            case 'z': settings.zoneSize = atoi(value); break;
+            case 'b': {
+                settings.batches.clear();
+                std::stringstream list(value);
+                std::string item;
+                while (std::getline(list, item, ','))
+                    settings.batches.push_back(atoi(item.c_str()));
+                break;
+            }
+            case 's': settings.seed = strtoull(value, nullptr, 10); break;
+            default: usage(); return 1;
+        }
+    }
+    if (settings.numCashiers < 1 || settings.arrivalInterval <= 0 || settings.simTime <= 0 || settings.zoneSize < 1) {
+        usage();
+        return 1;
+    }
+    for (int batch : settings.batches) {
+        if (batch < 1) {
+            usage();
+            return 1;
+        }
+    }
+
+    printf("%d cashiers, arrival interval %gs, load %.3f, %gs from empty, zones of %d\n\n", settings.numCashiers,
+           settings.arrivalInterval, 16.25 / (settings.arrivalInterval * settings.numCashiers), settings.simTime,
+           settings.zoneSize);
+    printf("%-16s %10s %12s %12s %10s %10s %10s\n", "strategy", "decisions", "entries/dec", "ns/decision", "meanWait",
+           "p99Wait", "maxWait");
+    Result flat = run(settings, 0);
+    print("shortest queue", flat);
+    for (int batch : settings.batches) {
+        Result hierarchical = run(settings, batch);
+        char name[32];
+        snprintf(name, sizeof(name), "zones, batch %d", batch);
+        print(name, hierarchical);
+    }
+    return 0;
+}